@@ -0,0 +1,340 @@
+#include "AssetStore.hpp"
+#include "Resample.hpp"
+#include "Trace.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+static const char *refsHeader = "soundpad refs 1";
+
+// FNV-1a with a final avalanche; not cryptographic, so the size is part of the key and hits are compared
+static bool hashFile(const std::filesystem::path &file, Uint64 &hash, Uint64 &size) {
+    std::ifstream in(file, std::ios::binary);
+    if (!in.is_open()) {
+        return false;
+    }
+    Uint64 h = 0xcbf29ce484222325ULL;
+    size = 0;
+    std::vector<char> buf(1 << 20);
+    while (in) {
+        in.read(buf.data(), buf.size());
+        auto got = in.gcount();
+        for (std::streamsize i = 0; i < got; ++i) {
+            h ^= (Uint8) buf[i];
+            h *= 0x100000001b3ULL;
+        }
+        size += got;
+    }
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    hash = h;
+    return true;
+}
+
+static bool sameContents(const std::filesystem::path &a, const std::filesystem::path &b) {
+    std::ifstream ia(a, std::ios::binary);
+    std::ifstream ib(b, std::ios::binary);
+    std::vector<char> ba(1 << 16), bb(1 << 16);
+    while (ia && ib) {
+        ia.read(ba.data(), ba.size());
+        ib.read(bb.data(), bb.size());
+        if (ia.gcount() != ib.gcount() || !std::equal(ba.begin(), ba.begin() + ia.gcount(), bb.begin())) {
+            return false;
+        }
+    }
+    return !ia && !ib;
+}
+
+void AssetStore::open(const std::filesystem::path &root, const std::filesystem::path &profilesDir) {
+    std::lock_guard<std::mutex> guard(lock);
+    this->root = root;
+    std::error_code ec;
+    std::filesystem::create_directories(root, ec);
+    for (auto &p : std::filesystem::recursive_directory_iterator(root, ec)) {
+        if (!p.is_regular_file(ec) || p.path().parent_path() == root) {
+            continue;
+        }
+        if (p.path().extension() == ".tmp") {
+            std::filesystem::remove(p.path(), ec); // interrupted put
+            continue;
+        }
+        sizes[p.path().filename().u8string()] = p.file_size(ec);
+    }
+
+    std::ifstream in(root / "refs.tsv");
+    std::string line;
+    if (in.is_open() && std::getline(in, line) && line == refsHeader) {
+        while (std::getline(in, line)) {
+            std::stringstream ls(line);
+            std::string profile, key;
+            if (!std::getline(ls, profile, '\t') || profile.empty()) {
+                continue;
+            }
+            auto &keys = refs[profile];
+            while (std::getline(ls, key, '\t')) {
+                keys.push_back(key);
+            }
+        }
+    } else if (!sizes.empty()) {
+        SDL_Log("Asset references are lost, collecting them from profiles");
+        for (auto &p : std::filesystem::directory_iterator(profilesDir, ec)) {
+            if (p.path().extension() != ".cfg") {
+                continue;
+            }
+            std::ifstream cfg(p.path());
+            std::stringstream text;
+            text << cfg.rdbuf();
+            refs[p.path().filename().u8string()] = keysIn(text.str());
+        }
+        saveRefs();
+    }
+    for (auto &r : refs) {
+        addRefs(r.second);
+    }
+
+    // whatever was put but never saved in a profile
+    unsigned swept = 0;
+    for (auto it = sizes.begin(); it != sizes.end();) {
+        if (counts.count(it->first) == 0) {
+            std::filesystem::remove(path(it->first), ec);
+            it = sizes.erase(it);
+            ++swept;
+        } else {
+            ++it;
+        }
+    }
+    SDL_Log("Asset store has %zu blobs, removed %u unreferenced", sizes.size(), swept);
+}
+
+std::string AssetStore::put(const std::filesystem::path &file) {
+    Uint64 hash, size;
+    if (!hashFile(file, hash, size)) {
+        SDL_Log("Failed to read %s", file.u8string().c_str());
+        return std::string();
+    }
+    char base[48];
+    SDL_snprintf(base, sizeof(base), "%016llx-%llx", (unsigned long long) hash, (unsigned long long) size);
+    auto ext = lowercase(file.extension().u8string()); // some decoders go by extension
+    for (unsigned attempt = 0; attempt < 16; ++attempt) {
+        auto key = std::string(base) + (attempt ? "~" + std::to_string(attempt) : std::string()) + ext;
+        auto target = path(key);
+        std::error_code ec;
+        if (std::filesystem::exists(target, ec)) {
+            if (sameContents(file, target)) {
+                return key;
+            }
+            continue; // same hash, different sound
+        }
+        std::filesystem::create_directories(target.parent_path(), ec);
+        auto tmp = target;
+        tmp += ".tmp";
+        std::filesystem::copy_file(file, tmp, std::filesystem::copy_options::overwrite_existing, ec);
+        if (!ec) {
+            std::filesystem::rename(tmp, target, ec);
+        }
+        if (ec) {
+            SDL_Log("Failed to store %s: %s", file.u8string().c_str(), ec.message().c_str());
+            std::filesystem::remove(tmp, ec);
+            return std::string();
+        }
+        std::lock_guard<std::mutex> guard(lock);
+        sizes[key] = size;
+        return key;
+    }
+    SDL_Log("Too many hash collisions for %s", file.u8string().c_str());
+    return std::string();
+}
+
+std::filesystem::path AssetStore::path(const std::string &key) const {
+    return root / key.substr(0, 2) / std::filesystem::u8path(key);
+}
+
+Uint64 AssetStore::size(const std::string &key) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = sizes.find(key);
+    return it == sizes.end() ? 0 : it->second;
+}
+
+Uint64 AssetStore::bytes() {
+    std::lock_guard<std::mutex> guard(lock);
+    Uint64 res = 0;
+    for (auto &s : sizes) {
+        res += s.second;
+    }
+    return res;
+}
+
+void AssetStore::addRefs(const std::vector<std::string> &keys) {
+    for (auto &k : keys) {
+        ++counts[k];
+    }
+}
+
+void AssetStore::removeRefs(const std::vector<std::string> &keys) {
+    std::error_code ec;
+    for (auto &k : keys) {
+        auto it = counts.find(k);
+        if (it == counts.end() || --it->second > 0) {
+            continue;
+        }
+        counts.erase(it);
+        if (decoded.count(k)) {
+            continue; // still playing somewhere, swept on the next start if nobody saves it again
+        }
+        std::filesystem::remove(path(k), ec);
+        sizes.erase(k);
+    }
+}
+
+void AssetStore::setRefs(const std::string &profile, const std::vector<std::string> &keys) {
+    auto unique = keys;
+    std::sort(unique.begin(), unique.end());
+    unique.erase(std::unique(unique.begin(), unique.end()), unique.end());
+    unique.erase(std::remove(unique.begin(), unique.end(), std::string()), unique.end());
+    std::lock_guard<std::mutex> guard(lock);
+    auto &old = refs[profile];
+    if (old == unique) {
+        return; // most saves change settings only
+    }
+    addRefs(unique); // before removing, so shared keys never hit zero
+    removeRefs(old);
+    old = std::move(unique);
+    saveRefs();
+}
+
+void AssetStore::dropRefs(const std::string &profile) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = refs.find(profile);
+    if (it == refs.end()) {
+        return;
+    }
+    removeRefs(it->second);
+    refs.erase(it);
+    saveRefs();
+}
+
+bool AssetStore::saveRefs() {
+    std::string out = refsHeader;
+    out += "\n";
+    for (auto &r : refs) {
+        if (r.second.empty()) {
+            continue;
+        }
+        out += r.first;
+        for (auto &k : r.second) {
+            out += "\t" + k;
+        }
+        out += "\n";
+    }
+    if (!writeFileAtomic(root / "refs.tsv", out)) {
+        SDL_Log("Failed to save asset references");
+        return false;
+    }
+    return true;
+}
+
+// Entries of decoded sounds, by key and storage
+static std::string decodedKey(const std::string &key, SampleStorage storage) {
+    switch (storage) {
+    case STORAGE_COMPACT:
+        return key + "/s16";
+    case STORAGE_ENCODED:
+        return key + "/encoded";
+    default:
+        return key;
+    }
+}
+
+MIX_Audio *AssetStore::acquireAudio(const std::string &key, MIX_Mixer *mixer, SampleStorage storage) {
+    // fixed now, the default may change while it decodes
+    storage = resolveStorage(storage);
+    auto entry = decodedKey(key, storage);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto it = decoded.find(entry);
+        if (it != decoded.end()) {
+            ++it->second.users;
+            ++sharedLoads;
+            return it->second.audio;
+        }
+    }
+    // decoding takes a while, others may go on meanwhile
+    auto start = SDL_GetTicksNS();
+    auto audio = loadForMixer(mixer, path(key).u8string().c_str(), storage);
+    tracer.span("io", "decode stored", start, SDL_GetTicksNS());
+    if (!audio) {
+        SDL_Log("Failed to load stored sound %s: %s", key.c_str(), SDL_GetError());
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> guard(lock);
+    ++decodes;
+    auto it = decoded.find(entry);
+    if (it != decoded.end()) {
+        MIX_DestroyAudio(audio); // somebody was faster
+        ++it->second.users;
+        ++sharedLoads;
+        return it->second.audio;
+    }
+    decoded.emplace(entry, Shared{audio, 1, SDL_GetTicksNS() - start});
+    return audio;
+}
+
+std::unordered_map<std::string, AssetStore::Shared>::iterator AssetStore::findDecoded(const std::string &key,
+                                                                                    MIX_Audio *audio) {
+    for (auto storage : {STORAGE_FLOAT, STORAGE_COMPACT, STORAGE_ENCODED}) {
+        auto it = decoded.find(decodedKey(key, storage));
+        if (it != decoded.end() && it->second.audio == audio) {
+            return it;
+        }
+    }
+    return decoded.end();
+}
+
+void AssetStore::releaseAudio(const std::string &key, MIX_Audio *audio) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = findDecoded(key, audio);
+    if (it == decoded.end()) {
+        return;
+    }
+    if (--it->second.users == 0) {
+        MIX_DestroyAudio(it->second.audio);
+        decoded.erase(it);
+    }
+}
+
+Uint64 AssetStore::decodeTime(const std::string &key, MIX_Audio *audio) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = findDecoded(key, audio);
+    return it == decoded.end() ? 0 : it->second.decodeNS;
+}
+
+void AssetStore::logStats() {
+    auto total = bytes();
+    std::lock_guard<std::mutex> guard(lock);
+    size_t references = 0;
+    for (auto &c : counts) {
+        references += c.second;
+    }
+    SDL_Log("Asset store: %zu blobs, %.1f MiB, %zu references from %zu profiles; %llu sounds decoded, %llu loads shared them",
+        sizes.size(), total / (1024.0 * 1024.0), references, refs.size(),
+        (unsigned long long) decodes, (unsigned long long) sharedLoads);
+}
+
+std::vector<std::string> AssetStore::keysIn(const std::string &text) {
+    std::vector<std::string> keys;
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+        auto tab = line.rfind('\t');
+        if (tab != std::string::npos && tab + 1 < line.size()) {
+            keys.push_back(line.substr(tab + 1));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
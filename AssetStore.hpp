@@ -0,0 +1,83 @@
+#ifndef ASSET_STORE_HPP
+#define ASSET_STORE_HPP
+
+#include "preface.hpp"
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Resample.hpp"
+
+/**
+ * Content-addressed assets shared by all .cfg profiles:
+ *   store/<2 hex>/<key>   blobs; key is a 64-bit content hash, the size and the extension
+ *   store/refs.tsv        profile file name followed by the keys it references
+ * A blob goes away once no profile references it. Decoded sounds are shared
+ * as well: pads with the same blob, in any loaded profile, use one MIX_Audio.
+ * Thread-safe.
+ */
+class AssetStore {
+public:
+    // Reads references (rebuilding them from the profiles if lost) and drops unreferenced blobs
+    void open(const std::filesystem::path &root, const std::filesystem::path &profilesDir);
+
+    // Copies the file in unless the same content is stored already; empty on failure
+    std::string put(const std::filesystem::path &file);
+
+    std::filesystem::path path(const std::string &key) const;
+
+    Uint64 size(const std::string &key);
+
+    // Of all blobs
+    Uint64 bytes();
+
+    // The profile references exactly these keys now
+    void setRefs(const std::string &profile, const std::vector<std::string> &keys);
+
+    // The profile was deleted
+    void dropRefs(const std::string &profile);
+
+    // Shared decoded sound, every successful acquire needs a release; a blob
+    // is loaded once per storage, as pads keep it as floats, 16-bit or encoded
+    MIX_Audio *acquireAudio(const std::string &key, MIX_Mixer *mixer, SampleStorage storage = STORAGE_DEFAULT);
+
+    void releaseAudio(const std::string &key, MIX_Audio *audio);
+
+    // How long the shared sound took to decode, 0 if it isn't loaded
+    Uint64 decodeTime(const std::string &key, MIX_Audio *audio);
+
+    void logStats();
+
+    // Keys referenced by profile text: asset lines end with a tab and the key
+    static std::vector<std::string> keysIn(const std::string &text);
+private:
+    struct Shared {
+        MIX_Audio *audio;
+        unsigned users;
+        Uint64 decodeNS;
+    };
+
+    std::filesystem::path root;
+    std::mutex lock;
+    std::unordered_map<std::string, std::vector<std::string> > refs; // by profile
+    std::unordered_map<std::string, unsigned> counts;
+    std::unordered_map<std::string, Uint64> sizes;
+    std::unordered_map<std::string, Shared> decoded;
+    Uint64 sharedLoads = 0;
+    Uint64 decodes = 0;
+
+    void addRefs(const std::vector<std::string> &keys);
+
+    // Caller holds the lock; removes blobs which lost their last reference
+    void removeRefs(const std::vector<std::string> &keys);
+
+    bool saveRefs();
+
+    // Caller holds the lock; the decoded entry holding the sound
+    std::unordered_map<std::string, Shared>::iterator findDecoded(const std::string &key, MIX_Audio *audio);
+};
+
+inline AssetStore assetStore;
+
+#endif // ASSET_STORE_HPP
@@ -0,0 +1,149 @@
+#include "Autosave.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+
+Autosaver::Autosaver(Uint64 quietMS)
+    : quietMS(quietMS)
+{
+}
+
+Autosaver::~Autosaver() {
+    stop();
+}
+
+void Autosaver::start() {
+    std::lock_guard<std::mutex> guard(lock);
+    if (running) {
+        return;
+    }
+    running = true;
+    worker = std::thread(&Autosaver::run, this);
+}
+
+void Autosaver::stop() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    changed.notify_all();
+    worker.join(); // pending job is written before the thread exits
+}
+
+void Autosaver::attach(SoundPad *newPad, const std::filesystem::path &newPath) {
+    std::unique_lock<std::mutex> guard(lock);
+    waitIdle(guard);
+    pad = newPad;
+    path = newPath;
+    layout.clear();
+    sections.clear();
+    dirtyPads.clear();
+    dirtyAll = false;
+}
+
+void Autosaver::markDirty(const Pad *p) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (!p) {
+        dirtyAll = true;
+    } else if (std::find(dirtyPads.begin(), dirtyPads.end(), p) == dirtyPads.end()) {
+        dirtyPads.push_back(p);
+    }
+    lastChange = SDL_GetTicks();
+}
+
+void Autosaver::update() {
+    std::lock_guard<std::mutex> guard(lock);
+    if ((dirtyAll || !dirtyPads.empty()) && SDL_GetTicks() - lastChange >= quietMS) {
+        prepare(false);
+    }
+}
+
+bool Autosaver::flush(bool force, std::mutex *padLock) {
+    std::unique_lock<std::mutex> padGuard;
+    if (padLock) {
+        padGuard = std::unique_lock<std::mutex>(*padLock); // taken before ours, as update() callers do
+    }
+    std::unique_lock<std::mutex> guard(lock);
+    bool prepared = prepare(force);
+    if (padGuard) {
+        padGuard.unlock(); // the engine goes on while the file is written
+    }
+    if (!prepared) {
+        return lastResult;
+    }
+    if (!running) {
+        hasJob = false;
+        lastResult = writeProfile(job.path, job.text, job.assets);
+        return lastResult;
+    }
+    waitIdle(guard);
+    return lastResult;
+}
+
+bool Autosaver::prepare(bool force) {
+    if (!pad) {
+        return false;
+    }
+    if (!force && !dirtyAll && dirtyPads.empty()) {
+        return false;
+    }
+    // the sections are only kept once everything was serialized
+    bool all = force || dirtyAll || sections.empty();
+    if (all) {
+        layout = serializeLayout(pad);
+        sections.clear();
+    }
+    size_t i = 0;
+    for (auto &row : *pad) {
+        for (auto &p : row) {
+            if (all) {
+                sections.push_back(serializePad(p));
+            } else if (std::find(dirtyPads.begin(), dirtyPads.end(), &p) != dirtyPads.end()) {
+                sections[i] = serializePad(p);
+            }
+            ++i;
+        }
+    }
+    dirtyPads.clear();
+    dirtyAll = false;
+
+    // a job not taken yet is simply replaced, it is older anyway
+    job.path = path;
+    job.text = layout;
+    for (auto &s : sections) {
+        job.text += s;
+    }
+    job.assets = profileAssets(pad);
+    hasJob = true;
+    changed.notify_all();
+    return true;
+}
+
+void Autosaver::waitIdle(std::unique_lock<std::mutex> &guard) {
+    changed.wait(guard, [this] { return !running || (!hasJob && !writing); });
+}
+
+void Autosaver::run() {
+    tracer.nameThread("autosave");
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        changed.wait(guard, [this] { return hasJob || !running; });
+        if (!hasJob) {
+            break;
+        }
+        Job current = std::move(job);
+        hasJob = false;
+        writing = true;
+        guard.unlock();
+        auto start = SDL_GetTicksNS();
+        bool ok = writeProfile(current.path, current.text, current.assets);
+        SDL_Log("%s %s in %.1f ms", ok ? "Saved" : "Failed to save", current.path.filename().u8string().c_str(),
+            (SDL_GetTicksNS() - start) / 1000000.0);
+        guard.lock();
+        writing = false;
+        lastResult = ok;
+        changed.notify_all();
+    }
+}
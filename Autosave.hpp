@@ -0,0 +1,75 @@
+#ifndef AUTOSAVE_HPP
+#define AUTOSAVE_HPP
+
+#include "preface.hpp"
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Config.hpp"
+
+/**
+ * Coalesces profile changes and writes them from a background thread.
+ * Edits only mark the touched pad (or the layout) dirty; once nothing has changed
+ * for the quiet period, the UI thread re-serializes just the dirty sections and
+ * hands the text to the writer, which replaces the file atomically.
+ */
+class Autosaver {
+public:
+    explicit Autosaver(Uint64 quietMS = 500);
+    ~Autosaver();
+
+    void start();
+
+    void stop();
+
+    // Waits for a write in progress, then follows another profile (nullptr for none)
+    void attach(SoundPad *pad, const std::filesystem::path &path);
+
+    // Any thread; nullptr marks everything
+    void markDirty(const Pad *pad = nullptr);
+
+    // UI thread, every frame: hands settled changes to the writer
+    void update();
+
+    // UI thread: writes pending changes (everything if forced) and waits until they are on disk;
+    // padLock, if given, is held only while the pads are serialized
+    bool flush(bool force = false, std::mutex *padLock = nullptr);
+private:
+    struct Job {
+        std::filesystem::path path;
+        std::string text;
+        ProfileAssets assets;
+    };
+
+    Uint64 quietMS;
+    std::thread worker;
+    bool running = false;
+
+    // UI thread only
+    SoundPad *pad = nullptr;
+    std::filesystem::path path;
+    std::string layout;
+    std::vector<std::string> sections;
+
+    std::mutex lock;
+    std::condition_variable changed;
+    std::vector<const Pad *> dirtyPads;
+    bool dirtyAll = false;
+    Uint64 lastChange = 0;
+    bool hasJob = false;
+    bool writing = false;
+    bool lastResult = true;
+    Job job;
+
+    void run();
+
+    // Builds a job from dirty sections, caller holds the lock
+    bool prepare(bool force);
+
+    void waitIdle(std::unique_lock<std::mutex> &guard);
+};
+
+#endif // AUTOSAVE_HPP
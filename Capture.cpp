@@ -0,0 +1,165 @@
+#include "Capture.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <vector>
+
+// RIFF sizes are 32 bits
+static const Uint64 wavLimit = 0xFFFFFFFFull - 64;
+
+// Header for dataBytes of samples; written with 0 first and again once the size is known
+static bool writeWavHeader(SDL_IOStream *io, const SDL_AudioSpec &spec, bool floats, Uint64 dataBytes) {
+    Uint16 bits = floats ? 32 : 16;
+    Uint16 block = (Uint16) (spec.channels * bits / 8);
+    return SDL_SeekIO(io, 0, SDL_IO_SEEK_SET) >= 0
+        && SDL_WriteIO(io, "RIFF", 4) == 4 && SDL_WriteU32LE(io, (Uint32) (36 + dataBytes))
+        && SDL_WriteIO(io, "WAVEfmt ", 8) == 8 && SDL_WriteU32LE(io, 16)
+        && SDL_WriteU16LE(io, floats ? 3 : 1) && SDL_WriteU16LE(io, (Uint16) spec.channels)
+        && SDL_WriteU32LE(io, (Uint32) spec.freq) && SDL_WriteU32LE(io, (Uint32) spec.freq * block)
+        && SDL_WriteU16LE(io, block) && SDL_WriteU16LE(io, bits)
+        && SDL_WriteIO(io, "data", 4) == 4 && SDL_WriteU32LE(io, (Uint32) dataBytes);
+}
+
+static void finishFile(SDL_IOStream *io, const SDL_AudioSpec &spec, bool floats, Uint64 dataBytes) {
+    if (!writeWavHeader(io, spec, floats, dataBytes)) {
+        SDL_Log("Failed to finish the recording: %s", SDL_GetError());
+    }
+    SDL_CloseIO(io);
+}
+
+Capture::~Capture() {
+    stop();
+}
+
+bool Capture::start(MIX_Mixer *mixer, const CaptureSettings &settings) {
+    stop(); // one that failed to write still has its thread
+    if (!MIX_GetMixerFormat(mixer, &spec)) {
+        SDL_Log("Failed to get the mix format: %s", SDL_GetError());
+        return false;
+    }
+    this->mixer = mixer;
+    this->settings = settings;
+    // a few seconds of slack for the disk, allocated here instead of on the mixer thread
+    ring.reset(new RingBuffer<float>((size_t) spec.freq * spec.channels * 4));
+    dropped = 0;
+    written = 0;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        file.clear();
+        files = 0;
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(settings.dir, ec);
+    running = true;
+    worker = std::thread(&Capture::run, this);
+    active.store(true, std::memory_order_release);
+    return true;
+}
+
+void Capture::stop() {
+    if (!running) {
+        return;
+    }
+    MIX_LockMixer(mixer); // no block is being copied once this is off
+    active = false;
+    MIX_UnlockMixer(mixer);
+    running = false;
+    worker.join();
+    ring.reset();
+    unsigned count;
+    currentFile(&count);
+    SDL_Log("Recorded %.1f s into %u files, %llu blocks dropped", (double) written / std::max(spec.freq, 1), count,
+        (unsigned long long) dropped);
+}
+
+std::filesystem::path Capture::currentFile(unsigned *files) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (files) {
+        *files = this->files;
+    }
+    return file;
+}
+
+SDL_IOStream *Capture::openFile() {
+    SDL_Time now = 0;
+    SDL_DateTime dt = {};
+    SDL_GetCurrentTime(&now);
+    SDL_TimeToDateTime(now, &dt, true);
+    char name[64];
+    SDL_snprintf(name, sizeof(name), "show-%04d%02d%02d-%02d%02d%02d-%03d.wav", dt.year, dt.month, dt.day,
+        dt.hour, dt.minute, dt.second, dt.nanosecond / 1000000);
+    auto path = settings.dir / name;
+    auto io = SDL_IOFromFile(path.u8string().c_str(), "wb");
+    if (!io || !writeWavHeader(io, spec, settings.floats, 0)) {
+        SDL_Log("Failed to record into %s: %s", path.u8string().c_str(), SDL_GetError());
+        if (io) {
+            SDL_CloseIO(io);
+        }
+        return nullptr;
+    }
+    SDL_Log("Recording into %s", path.u8string().c_str());
+    std::lock_guard<std::mutex> guard(lock);
+    file = path;
+    ++files;
+    return io;
+}
+
+void Capture::run() {
+    tracer.nameThread("capture");
+    auto channels = (size_t) std::max(spec.channels, 1);
+    auto frameBytes = channels * (settings.floats ? sizeof(float) : sizeof(Sint16));
+    auto limit = settings.splitBytes > 0 ? std::min(settings.splitBytes, wavLimit) : wavLimit;
+    std::vector<float> chunk((size_t) spec.freq / 10 * channels); // 100 ms
+    std::vector<Sint16> shorts(settings.floats ? 0 : chunk.size());
+    SDL_IOStream *io = nullptr;
+    Uint64 bytes = 0;
+    Uint64 frames = 0;
+    bool failed = false;
+    while (true) {
+        bool last = !running; // read first, so blocks queued before the stop are still written
+        size_t n;
+        while ((n = ring->read(chunk.data(), chunk.size())) > 0) {
+            if (failed) {
+                continue; // drained so the ring doesn't count drops
+            }
+            TraceSpan span("io", "capture write");
+            auto size = n / channels * frameBytes;
+            if (io && (bytes + size > limit || (settings.splitSeconds > 0 && frames >= settings.splitSeconds * spec.freq))) {
+                finishFile(io, spec, settings.floats, bytes);
+                io = nullptr;
+            }
+            if (!io) {
+                io = openFile();
+                bytes = 0;
+                frames = 0;
+                if (!io) {
+                    failed = true;
+                    active = false; // nothing to keep then
+                    continue;
+                }
+            }
+            const void *data = chunk.data();
+            if (!settings.floats) {
+                for (size_t i = 0; i < n; ++i) {
+                    shorts[i] = (Sint16) (SDL_clamp(chunk[i], -1.f, 1.f) * 32767.f);
+                }
+                data = shorts.data();
+            }
+            if (SDL_WriteIO(io, data, size) != size) {
+                SDL_Log("Failed to write the recording: %s", SDL_GetError());
+                failed = true;
+                active = false;
+                continue;
+            }
+            bytes += size;
+            frames += n / channels;
+            written.fetch_add(n / channels, std::memory_order_relaxed);
+        }
+        if (last) {
+            break;
+        }
+        SDL_Delay(20); // polled: waking this from the mixer thread would take a lock there
+    }
+    if (io) {
+        finishFile(io, spec, settings.floats, bytes);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef CAPTURE_HPP
+#define CAPTURE_HPP
+
+#include "preface.hpp"
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include "Queue.hpp"
+
+struct CaptureSettings {
+    std::filesystem::path dir;
+    bool floats = false;     // 32-bit float samples instead of 16-bit
+    Uint64 splitBytes = 0;   // a new file past this size, 0 for WAV's own limit only
+    Uint64 splitSeconds = 0; // or past this length, 0 for none
+};
+
+/**
+ * Records the final mix into WAV files. The mixer thread only copies each
+ * block into a ring allocated up front, or counts it as dropped when the ring
+ * is full; a thread of its own converts and writes, so a stalled disk loses
+ * blocks instead of making the output underrun. Files are split by size or
+ * length and named by the time they start.
+ */
+class Capture {
+public:
+    ~Capture();
+
+    // UI thread, a new set of files every time
+    bool start(MIX_Mixer *mixer, const CaptureSettings &settings);
+
+    // UI thread: writes what is queued and finishes the file
+    void stop();
+
+    bool recording() const {
+        return active.load(std::memory_order_relaxed);
+    }
+
+    // Mixer thread, from the postmix callback
+    void mixed(const float *pcm, int samples) {
+        if (active.load(std::memory_order_acquire) && !ring->write(pcm, samples)) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    // Blocks lost since the start because the writer fell behind
+    Uint64 droppedBlocks() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+
+    Uint64 writtenFrames() const {
+        return written.load(std::memory_order_relaxed);
+    }
+
+    int rate() const {
+        return spec.freq;
+    }
+
+    // The file being written, and how many there were
+    std::filesystem::path currentFile(unsigned *files = nullptr);
+private:
+    MIX_Mixer *mixer = nullptr;
+    SDL_AudioSpec spec = {};
+    CaptureSettings settings;
+    std::unique_ptr<RingBuffer<float>> ring;
+    std::atomic<bool> active = false;
+    std::atomic<Uint64> dropped = 0;
+    std::atomic<Uint64> written = 0;
+
+    std::thread worker;
+    std::atomic<bool> running = false;
+    std::mutex lock;
+    std::filesystem::path file;
+    unsigned files = 0;
+
+    void run();
+
+    SDL_IOStream *openFile();
+};
+
+inline Capture capture;
+
+#endif // CAPTURE_HPP
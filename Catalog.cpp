@@ -0,0 +1,352 @@
+#include "Catalog.hpp"
+#include "AssetStore.hpp"
+#include "Jobs.hpp"
+#include "Pack.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+
+static const char *catalogHeader = "soundpad catalog 1";
+// Touches and tag edits in a row are written once
+static const Uint64 settleNS = 2000000000;
+
+static long long stampOf(const std::filesystem::path &path) {
+    std::error_code ec;
+    auto t = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : (long long) t.time_since_epoch().count();
+}
+
+// Layout is the first block of the profile text, one pad per non-space char
+static unsigned countPads(std::istream &in) {
+    unsigned pads = 0;
+    std::string line;
+    while (std::getline(in, line)) {
+        unsigned row = 0;
+        for (auto c : line) {
+            if (!isspace((unsigned char) c)) ++row;
+        }
+        if (row == 0) break;
+        pads += row;
+    }
+    return pads;
+}
+
+void Catalog::load(const std::filesystem::path &indexPath, const std::filesystem::path &dir) {
+    this->indexPath = indexPath;
+    this->dir = dir;
+    read();
+    scan();
+    reindex();
+    if (dirty) {
+        save();
+    }
+}
+
+bool Catalog::read() {
+    std::ifstream in(indexPath);
+    if (!in.is_open()) {
+        return false;
+    }
+    std::string line;
+    if (!std::getline(in, line) || line != catalogHeader || !std::getline(in, line)) {
+        SDL_Log("Ignoring catalog %s of unknown format", indexPath.u8string().c_str());
+        return false;
+    }
+    dirStamp = std::strtoll(line.c_str(), nullptr, 10);
+    while (std::getline(in, line)) {
+        // name, mtime, size, pads, asset bytes, last used, tags
+        std::vector<std::string> fields;
+        std::stringstream ls(line);
+        std::string field;
+        while (std::getline(ls, field, '\t')) {
+            fields.push_back(field);
+        }
+        if (fields.size() < 6 || fields[0].empty()) {
+            continue;
+        }
+        CatalogEntry e;
+        e.name = fields[0];
+        e.path = dir / std::filesystem::u8path(e.name);
+        e.mtime = std::strtoll(fields[1].c_str(), nullptr, 10);
+        e.size = std::strtoull(fields[2].c_str(), nullptr, 10);
+        e.pads = std::strtoul(fields[3].c_str(), nullptr, 10);
+        e.assetBytes = std::strtoull(fields[4].c_str(), nullptr, 10);
+        e.lastUsed = std::strtoll(fields[5].c_str(), nullptr, 10);
+        if (fields.size() > 6) {
+            e.tags = fields[6];
+        }
+        describe(e);
+        list.push_back(std::move(e));
+    }
+    return true;
+}
+
+void Catalog::scan() {
+    std::error_code ec;
+    if (!std::filesystem::exists(dir, ec)) {
+        if (!std::filesystem::create_directories(dir, ec)) {
+            SDL_Log("Failed to create profiles dir %s", dir.u8string().c_str());
+        }
+    } else if (!std::filesystem::is_directory(dir, ec)) {
+        SDL_Log("Profiles path %s exists but is not a directory", dir.u8string().c_str());
+        list.clear();
+        return;
+    }
+    auto stamp = stampOf(dir);
+    if (stamp != 0 && stamp == dirStamp) {
+        SDL_Log("Got %zu profiles from the catalog", list.size());
+        return;
+    }
+    std::unordered_map<std::string, CatalogEntry> known;
+    for (auto &e : list) {
+        auto name = e.name;
+        known.emplace(std::move(name), std::move(e));
+    }
+    list.clear();
+    unsigned examined = 0;
+    for (auto &p : std::filesystem::directory_iterator(dir, ec)) {
+        if (!p.is_regular_file(ec) || p.path().extension() == ".tmp") { // .tmp is an unfinished save
+            continue;
+        }
+        CatalogEntry e;
+        auto name = p.path().filename().u8string();
+        auto it = known.find(name);
+        if (it != known.end()) {
+            e = std::move(it->second);
+        } else {
+            e.name = name;
+        }
+        e.path = p.path();
+        auto size = p.file_size(ec);
+        auto mtime = (long long) p.last_write_time(ec).time_since_epoch().count();
+        if (it == known.end() || size != e.size || mtime != e.mtime) {
+            if (!examine(e)) continue;
+            ++examined;
+        }
+        list.push_back(std::move(e));
+    }
+    dirStamp = stamp;
+    dirty = true;
+    SDL_Log("Got %zu profiles, %u of them new or changed", list.size(), examined);
+}
+
+bool Catalog::examine(CatalogEntry &entry) {
+    std::error_code ec;
+    if (!std::filesystem::is_regular_file(entry.path, ec)) {
+        return false;
+    }
+    entry.size = std::filesystem::file_size(entry.path, ec);
+    entry.mtime = stampOf(entry.path);
+    entry.pads = 0;
+    entry.assetBytes = 0;
+    if (entry.path.extension() == ".spack") {
+        auto pack = Pack::open(entry.path);
+        if (pack) {
+            std::istringstream in{std::string(pack->config())};
+            entry.pads = countPads(in);
+            delete pack;
+        }
+        entry.assetBytes = entry.size;
+    } else {
+        std::ifstream in(entry.path);
+        std::stringstream text;
+        text << in.rdbuf();
+        entry.pads = countPads(text);
+        for (auto &k : AssetStore::keysIn(text.str())) {
+            entry.assetBytes += assetStore.size(k);
+        }
+        auto base = entry.path.parent_path() / entry.path.stem();
+        for (auto &a : std::filesystem::directory_iterator(base, ec)) {
+            if (a.is_regular_file(ec)) {
+                entry.assetBytes += a.file_size(ec);
+            }
+        }
+    }
+    describe(entry);
+    return true;
+}
+
+void Catalog::describe(CatalogEntry &entry) {
+    char buf[64];
+    SDL_snprintf(buf, sizeof(buf), "%u pads, %.1f MiB", entry.pads, entry.assetBytes / (1024.0 * 1024.0));
+    entry.info = buf;
+    if (!entry.tags.empty()) {
+        entry.info += "  [" + entry.tags + "]";
+    }
+    entry.key = lowercase(entry.name + " " + entry.tags);
+}
+
+void Catalog::reindex() {
+    byName.clear();
+    for (size_t i = 0; i < list.size(); ++i) {
+        byName[list[i].name] = i;
+    }
+    for (size_t i = 0; i < list.size(); ++i) {
+        byName.emplace(list[i].path.stem().u8string(), i); // file names win
+    }
+    ++version;
+}
+
+bool Catalog::save() {
+    dirty = false;
+    dirtySince = 0;
+    if (indexPath.empty()) {
+        return false;
+    }
+    return write(serialize(), ++saves);
+}
+
+std::string Catalog::serialize() const {
+    std::string out;
+    out.reserve(list.size() * 96);
+    out += catalogHeader;
+    out += "\n" + std::to_string(dirStamp) + "\n";
+    for (auto &e : list) {
+        out += e.name + "\t" + std::to_string(e.mtime) + "\t" + std::to_string(e.size)
+            + "\t" + std::to_string(e.pads) + "\t" + std::to_string(e.assetBytes)
+            + "\t" + std::to_string(e.lastUsed) + "\t" + e.tags + "\n";
+    }
+    return out;
+}
+
+bool Catalog::write(const std::string &text, Uint64 save) {
+    std::lock_guard<std::mutex> guard(writing);
+    if (save < written) {
+        return true; // a newer one is there already
+    }
+    written = save;
+    if (!writeFileAtomic(indexPath, text)) {
+        SDL_Log("Failed to save catalog %s", indexPath.u8string().c_str());
+        return false;
+    }
+    return true;
+}
+
+void Catalog::changed(const std::filesystem::path &path) {
+    std::lock_guard<std::mutex> guard(lock);
+    pending.push_back(path);
+    hasPending = true;
+}
+
+void Catalog::update() {
+    if (hasPending) {
+        std::vector<std::filesystem::path> paths;
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            paths.swap(pending);
+            hasPending = false;
+        }
+        for (auto &p : paths) {
+            auto it = byName.find(p.filename().u8string());
+            if (it != byName.end() && list[it->second].name == p.filename().u8string()) {
+                if (!examine(list[it->second])) {
+                    list.erase(list.begin() + it->second);
+                }
+            } else {
+                CatalogEntry e;
+                e.path = p;
+                e.name = p.filename().u8string();
+                if (examine(e)) {
+                    list.push_back(std::move(e));
+                }
+            }
+            reindex();
+        }
+        // the directory changed by our own hands only, so the next start may trust the index
+        dirStamp = stampOf(dir);
+        dirty = true;
+        dirtySince = SDL_GetTicksNS();
+    }
+    if (!dirty || indexPath.empty()) {
+        return;
+    }
+    auto now = SDL_GetTicksNS();
+    if (dirtySince == 0) {
+        dirtySince = now; // by the scan
+    }
+    if (now - dirtySince < settleNS) {
+        return;
+    }
+    dirty = false;
+    dirtySince = 0;
+    jobs.run(JOB_BACKGROUND, [this, text = serialize(), save = ++saves]() {
+        write(text, save);
+    });
+}
+
+void Catalog::flush() {
+    if (dirty) {
+        save();
+    }
+}
+
+void Catalog::touch(const std::filesystem::path &path) {
+    auto it = byName.find(path.filename().u8string());
+    if (it == byName.end()) {
+        return;
+    }
+    list[it->second].lastUsed = (long long) std::time(nullptr);
+    dirty = true;
+    dirtySince = SDL_GetTicksNS();
+    ++version;
+}
+
+void Catalog::setTags(size_t index, const std::string &tags) {
+    auto &e = list[index];
+    e.tags.clear();
+    for (auto c : tags) {
+        if (c != '\t' && c != '\n' && c != '\r') e.tags += c;
+    }
+    describe(e);
+    dirty = true;
+    dirtySince = SDL_GetTicksNS();
+    ++version;
+}
+
+const CatalogEntry *Catalog::find(const std::string &name) const {
+    auto it = byName.find(name);
+    return it == byName.end() ? nullptr : &list[it->second];
+}
+
+const std::vector<size_t> &Catalog::search(const std::string &query) {
+    if (version == lastVersion && query == lastQuery) {
+        return results;
+    }
+    // typing on only narrows what already matched
+    bool narrowing = version == lastVersion && !lastQuery.empty()
+        && query.size() > lastQuery.size() && query.compare(0, lastQuery.size(), lastQuery) == 0;
+    std::vector<size_t> candidates;
+    if (narrowing) {
+        candidates.swap(results);
+    } else {
+        candidates.resize(list.size());
+        std::iota(candidates.begin(), candidates.end(), 0);
+    }
+    auto q = lowercase(query);
+    std::vector<std::pair<int, size_t> > scored;
+    scored.reserve(candidates.size());
+    for (auto i : candidates) {
+        int score = q.empty() ? 0 : fuzzyScore(list[i].key, q);
+        if (score >= 0) {
+            scored.emplace_back(score, i);
+        }
+    }
+    std::sort(scored.begin(), scored.end(), [this](const std::pair<int, size_t> &a, const std::pair<int, size_t> &b) {
+        if (a.first != b.first) return a.first > b.first;
+        auto &ea = list[a.second];
+        auto &eb = list[b.second];
+        if (ea.lastUsed != eb.lastUsed) return ea.lastUsed > eb.lastUsed;
+        return ea.name < eb.name;
+    });
+    results.clear();
+    for (auto &s : scored) {
+        results.push_back(s.second);
+    }
+    lastQuery = query;
+    lastVersion = version;
+    return results;
+}
@@ -0,0 +1,107 @@
+#ifndef CATALOG_HPP
+#define CATALOG_HPP
+
+#include "preface.hpp"
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct CatalogEntry {
+    std::filesystem::path path;
+    std::string name;       // file name
+    std::string tags;       // comma separated, given by the user
+    std::string info;       // "12 pads, 3.4 MiB", ready to show
+    std::string key;        // lowercase name and tags, what search looks at
+    long long mtime = 0;    // of the profile file, to notice outside changes
+    Uint64 size = 0;
+    Uint64 assetBytes = 0;
+    unsigned pads = 0;
+    long long lastUsed = 0; // unix time, 0 if never
+};
+
+/**
+ * Index of the profiles dir, kept in a file next to config.ini so startup
+ * doesn't have to open every profile. Only files whose mtime or size changed
+ * are examined again, and the directory is not listed at all if its own mtime
+ * is the same as when the index was written.
+ * Besides loading, everything but changed() is for the UI thread.
+ */
+class Catalog {
+public:
+    // Reads the index and brings it up to date with the directory
+    void load(const std::filesystem::path &indexPath, const std::filesystem::path &dir);
+
+    // Writes the index on the calling thread
+    bool save();
+
+    // Any thread: the profile was created, saved, imported or deleted
+    void changed(const std::filesystem::path &path);
+
+    // Every frame: applies changes; once they settle, the index is written by a job
+    void update();
+
+    // Writes the index now if anything is new, waiting for a write in progress; before quitting
+    void flush();
+
+    // Profile was opened
+    void touch(const std::filesystem::path &path);
+
+    void setTags(size_t index, const std::string &tags);
+
+    // By file name or stem
+    const CatalogEntry *find(const std::string &name) const;
+
+    const std::vector<CatalogEntry> &entries() const {
+        return list;
+    }
+
+    const std::filesystem::path &directory() const {
+        return dir;
+    }
+
+    // Indices into entries(), best match first, or most recently used first for an
+    // empty query. The result is cached until the query or the catalog changes.
+    const std::vector<size_t> &search(const std::string &query);
+private:
+    std::filesystem::path indexPath;
+    std::filesystem::path dir;
+    long long dirStamp = 0;
+    std::vector<CatalogEntry> list;
+    std::unordered_map<std::string, size_t> byName; // file names and stems
+    bool dirty = false;
+    Uint64 dirtySince = 0; // last change
+    Uint64 version = 0;
+    Uint64 saves = 0;
+
+    std::mutex writing; // one write at a time, a late older one is skipped
+    Uint64 written = 0; // save number on disk
+
+    std::mutex lock;
+    std::vector<std::filesystem::path> pending;
+    std::atomic<bool> hasPending = false;
+
+    std::string lastQuery;
+    Uint64 lastVersion = ~0ull;
+    std::vector<size_t> results;
+
+    bool read();
+
+    std::string serialize() const;
+
+    // Any thread
+    bool write(const std::string &text, Uint64 save);
+
+    void scan();
+
+    // Fills pads, asset size and stamps from the file, false if it is gone
+    static bool examine(CatalogEntry &entry);
+
+    static void describe(CatalogEntry &entry);
+
+    void reindex();
+};
+
+#endif // CATALOG_HPP
@@ -1,11 +1,19 @@
 #include "Config.hpp"
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
 #include <string>
 #include <sstream>
 #include <filesystem>
-#include <unordered_map>
+#include <functional>
 
+#include "AssetStore.hpp"
 #include "Font.hpp"
+#include "Pack.hpp"
+#include "Resample.hpp"
+#include "Startup.hpp"
+#include "Trace.hpp"
+#include "Utils.hpp"
 
 std::string_view trim(std::string_view s) {
     size_t start = 0;
@@ -28,6 +36,88 @@ ImFont *getFont(std::string &path, bool useVectorFallback) {
     return font;
 }
 
+// Of SampleStorage, in profiles and the config
+static const char *storageWords[] = {"default", "float", "compact", "encoded"};
+
+// Moves assets of .cfg profiles from their sibling directories into the store, once
+static void migrateProfiles(const std::filesystem::path &dir) {
+    unsigned migrated = 0;
+    Uint64 before = 0;
+    std::error_code ec;
+    for (auto &p : std::filesystem::directory_iterator(dir, ec)) {
+        if (p.path().extension() != ".cfg") {
+            continue;
+        }
+        auto base = p.path().parent_path() / p.path().stem();
+        std::vector<std::string> lines;
+        {
+            std::ifstream in(p.path());
+            std::string line;
+            while (std::getline(in, line)) {
+                lines.push_back(line);
+            }
+        }
+        // layout, then a section per pad: "L name", "+ variant"s, transitions, volume and dsp, "pic name", opacity
+        size_t i = 0;
+        while (i < lines.size() && lines[i].find_first_not_of(" \t\r") != std::string::npos) ++i;
+        bool sectionStart = true;
+        bool failed = false;
+        std::vector<std::filesystem::path> moved;
+        for (; i < lines.size(); ++i) {
+            auto &l = lines[i];
+            if (l.empty()) {
+                sectionStart = true;
+                continue;
+            }
+            size_t offset = 0;
+            if (sectionStart || l.compare(0, 2, "+ ") == 0) {
+                offset = 2;
+            } else if (l.compare(0, 4, "pic ") == 0) {
+                offset = 4;
+            }
+            sectionStart = false;
+            if (offset == 0 || l.size() <= offset || l.find('\t') != std::string::npos) {
+                continue;
+            }
+            auto file = base / std::filesystem::u8path(l.substr(offset));
+            if (!std::filesystem::is_regular_file(file, ec)) {
+                continue;
+            }
+            auto key = assetStore.put(file);
+            if (key.empty()) {
+                failed = true;
+                continue;
+            }
+            before += std::filesystem::file_size(file, ec);
+            moved.push_back(file);
+            l += "\t" + key;
+        }
+        if (moved.empty()) {
+            continue;
+        }
+        std::string text;
+        for (auto &l : lines) {
+            text += l + "\n";
+        }
+        if (!writeFileAtomic(p.path(), text)) {
+            SDL_Log("Failed to migrate %s", p.path().u8string().c_str());
+            continue;
+        }
+        assetStore.setRefs(p.path().filename().u8string(), AssetStore::keysIn(text));
+        if (!failed) {
+            for (auto &f : moved) {
+                std::filesystem::remove(f, ec);
+            }
+            std::filesystem::remove(base, ec); // only if nothing else is left there
+        }
+        ++migrated;
+    }
+    if (migrated > 0) {
+        SDL_Log("Moved assets of %u profiles to the store: %.1f MiB in profile dirs, %.1f MiB in the store",
+            migrated, before / (1024.0 * 1024.0), assetStore.bytes() / (1024.0 * 1024.0));
+    }
+}
+
 AppConfig *loadAppConfig() {
     auto res = new AppConfig();
     std::string prefsDir(SDL_GetPrefPath("faerytea", "soundpad"));
@@ -74,6 +164,46 @@ AppConfig *loadAppConfig() {
                 if (std::filesystem::exists(value) || value == "embedded") {
                     monoTTF = value;
                 }
+            } else if (key == "controlsocket") {
+                res->controlSocket = value;
+            } else if (key == "osc") {
+                res->osc = (value == "1" || value == "true" || value == "yes");
+            } else if (key == "oschost") {
+                res->oscHost = value;
+            } else if (key == "oscport") {
+                res->oscPort = std::atoi(std::string(value).c_str());
+            } else if (key == "fontcache.regular") {
+                res->fontCache.first = value;
+            } else if (key == "fontcache.mono") {
+                res->fontCache.second = value;
+            } else if (key == "fontcache.stamp") {
+                res->fontCacheStamp = value;
+            } else if (key == "assetstore") {
+                res->storeMigrated = (value == "1");
+            } else if (key == "jobthreads") {
+                res->jobThreads = std::strtoul(std::string(value).c_str(), nullptr, 10);
+            } else if (key == "trace") {
+                res->trace = (value == "1" || value == "true" || value == "yes");
+            } else if (key == "recordfloats") {
+                res->recordFloats = (value == "1" || value == "true" || value == "yes");
+            } else if (key == "recordsplitmb") {
+                res->recordSplitMB = std::strtoul(std::string(value).c_str(), nullptr, 10);
+            } else if (key == "recordsplitmin") {
+                res->recordSplitMinutes = std::strtoul(std::string(value).c_str(), nullptr, 10);
+            } else if (key == "outputdevice") {
+                res->outputDevice = value;
+            } else if (key == "samplestorage") {
+                for (int i = STORAGE_FLOAT; i <= STORAGE_ENCODED; ++i) {
+                    if (value == storageWords[i]) {
+                        res->sampleStorage = static_cast<SampleStorage>(i);
+                    }
+                }
+            } else if (key == "resampleonload") {
+                res->resampleOnLoad = (value == "1" || value == "true" || value == "yes");
+            } else if (key == "memorybudget") {
+                res->memoryBudgetMB = std::strtoul(std::string(value).c_str(), nullptr, 10);
+            } else if (key == "warmcache") {
+                res->warmCacheMB = std::strtoul(std::string(value).c_str(), nullptr, 10);
             } else if (key == "font") {
                 if (std::filesystem::exists(value) || value == "embedded") {
                     regularTTF = value;
@@ -84,11 +214,33 @@ AppConfig *loadAppConfig() {
         }
         cfg.close();
     }
+    resampleOnLoad = res->resampleOnLoad;
+    storageOnLoad = res->sampleStorage;
+    // sized by the config, so workers start once it is read
+    jobs.start(res->jobThreads);
+    // independent of fonts, so it runs meanwhile
+    auto profileScan = std::make_shared<JobGroup>();
+    jobs.run(JOB_NOW, [res]() {
+        StartupPhase phase("profile scan");
+        assetStore.open(res->appdir / "store", res->appdir / "profiles");
+        if (!res->storeMigrated) {
+            migrateProfiles(res->appdir / "profiles");
+            res->storeMigrated = true;
+        }
+        res->catalog.load(res->appdir / "catalog.tsv", res->appdir / "profiles");
+    }, profileScan);
     if (monoTTF.empty() && regularTTF.empty()) {
-        auto defaultTTFs = getDefaultFontFiles();
-        if (regularTTF.empty()) regularTTF = defaultTTFs.first;
-        if (monoTTF.empty()) monoTTF = defaultTTFs.second;
+        StartupPhase phase("font discovery");
+        if (res->fontCache.first.empty() || fontDiscoveryStamp(res->fontCache) != res->fontCacheStamp) {
+            res->fontCache = getDefaultFontFiles();
+            res->fontCacheStamp = fontDiscoveryStamp(res->fontCache);
+        } else {
+            SDL_Log("Using cached font paths");
+        }
+        if (regularTTF.empty()) regularTTF = res->fontCache.first;
+        if (monoTTF.empty()) monoTTF = res->fontCache.second;
     }
+    StartupPhase fontPhase("fonts");
     SDL_Log("Loading '%s' and '%s'", regularTTF.c_str(), monoTTF.c_str());
     auto &io = ImGui::GetIO();
     auto *regular = getFont(regularTTF);
@@ -104,24 +256,7 @@ AppConfig *loadAppConfig() {
     SDL_Log("Using '%s' as regular font", regular->GetDebugName());
     res->fontRegular = regular;
     res->fontMono = mono;
-    // load profiles
-    std::filesystem::path profiles(appDir / "profiles");
-    if (std::filesystem::exists(profiles)) {
-        if (std::filesystem::is_directory(profiles)) {
-            for (auto &p : std::filesystem::directory_iterator(profiles)) {
-                if (p.is_regular_file()) {
-                    res->profiles.push_back(p);
-                }
-            }
-        } else {
-            SDL_Log("Profiles path %s exists but is not a directory", profiles.u8string().c_str());
-        }
-    } else {
-        if (!std::filesystem::create_directories(profiles)) {
-            SDL_Log("Failed to create profiles dir %s", profiles.u8string().c_str());
-        }
-    }
-    SDL_Log("Got %ld profiles", res->profiles.size());
+    jobs.wait(profileScan);
     return res;
 }
 
@@ -152,19 +287,130 @@ SoundPad *createDefault(MIX_Mixer *mixer) {
     for (char c : std::string("ZXCVBNM")) {
         zxc.emplace_back(Pad(c, mixer));
     }
+    psp->buildIndex();
     return psp;
 }
 
 const int ctrl = 1, shift = 2, alt = 4, playing = 8;
 
-SoundPad *loadSoundPad(const std::filesystem::path &path, MIX_Mixer *mixer) {
-    SDL_Log("Loading soundpad config from %s", path.u8string().c_str());
-    std::ifstream cfg(path);
-    if (!cfg.is_open()) {
-        SDL_Log("Failed to open pad config %s", path.u8string().c_str());
-        return createDefault(mixer);
+static bool isPack(const std::filesystem::path &path) {
+    return path.extension() == ".spack";
+}
+
+// Asset lines are "name<tab>key" when the asset is in the store; leaves the name, returns the key
+static std::string splitKey(std::string &name) {
+    auto tab = name.find('\t');
+    if (tab == std::string::npos) {
+        return std::string();
+    }
+    auto key = name.substr(tab + 1);
+    name.resize(tab);
+    return key;
+}
+
+static const char *pickWords[] = {"roundrobin", "random", "norepeat"};
+
+// "pick=random" among the words after the volume, round-robin if there is none
+static VariantPick parsePick(const std::string &text) {
+    std::istringstream in(text);
+    std::string word;
+    while (in >> word) {
+        for (int i = PICK_ROUND_ROBIN; i <= PICK_NO_REPEAT; ++i) {
+            if (word == std::string("pick=") + pickWords[i]) {
+                return static_cast<VariantPick>(i);
+            }
+        }
     }
+    return PICK_ROUND_ROBIN;
+}
+
+// "storage=compact" among the words after the volume, the app's default if there is none
+static SampleStorage parseStorage(const std::string &text) {
+    std::istringstream in(text);
+    std::string word;
+    while (in >> word) {
+        for (int i = STORAGE_FLOAT; i <= STORAGE_ENCODED; ++i) {
+            if (word == std::string("storage=") + storageWords[i]) {
+                return static_cast<SampleStorage>(i);
+            }
+        }
+    }
+    return STORAGE_DEFAULT;
+}
+
+// "uses=TRIGGERS:LAST" among the words after the volume, the last trigger in seconds since the epoch
+static PadUsage parseUsage(const std::string &text) {
+    std::istringstream in(text);
+    std::string word;
+    PadUsage usage;
+    while (in >> word) {
+        if (word.compare(0, 5, "uses=") != 0) {
+            continue;
+        }
+        auto colon = word.find(':');
+        usage.triggers = (Uint32) std::strtoul(word.c_str() + 5, nullptr, 10);
+        usage.lastTriggered = colon == std::string::npos ? 0 : std::max(0ll, std::strtoll(word.c_str() + colon + 1, nullptr, 10));
+    }
+    return usage;
+}
+
+// "trim=START:END" and "cue=NAME:START:END" among the words after the volume, in frames
+static void parseSlices(const std::string &text, PadSlice &trim, std::vector<PadSlice> &cues) {
+    std::istringstream in(text);
+    std::string word;
+    while (in >> word) {
+        bool isTrim = word.compare(0, 5, "trim=") == 0;
+        if (!isTrim && word.compare(0, 4, "cue=") != 0) {
+            continue;
+        }
+        PadSlice slice;
+        auto endColon = word.rfind(':');
+        auto startColon = isTrim ? word.find('=') : word.rfind(':', endColon - 1);
+        if (endColon == std::string::npos || startColon == std::string::npos || startColon >= endColon) {
+            SDL_Log("Invalid slice %s", word.c_str());
+            continue;
+        }
+        slice.start = std::max(0ll, std::strtoll(word.c_str() + startColon + 1, nullptr, 10));
+        slice.end = std::max(0ll, std::strtoll(word.c_str() + endColon + 1, nullptr, 10));
+        if (isTrim) {
+            trim = slice;
+        } else {
+            slice.name = word.substr(4, startColon - 4);
+            cues.push_back(slice);
+        }
+    }
+}
+
+static std::string sliceText(const PadSlice &slice) {
+    return std::to_string(slice.start) + ":" + std::to_string(slice.end);
+}
+
+// Another take of the pad's sound, from the same places as the main one
+static bool loadVariant(Pad *pp, const std::string &name, const std::string &key, const Pack *pack,
+                        const std::filesystem::path &base) {
+    TraceSpan span("io", "decode", pp->letter);
+    if (!key.empty() && !pack) {
+        return pp->addVariant(assetStore.acquireAudio(key, pp->mixer, pp->storage), key, name);
+    }
+    if (pack) {
+        auto entry = pack->findSound(name);
+        if (!entry) {
+            return false;
+        }
+        if (entry->kind == PACK_PCM) {
+            return pp->addVariant(MIX_LoadRawAudioNoCopy(pp->mixer, pack->data(*entry), entry->size, &entry->spec, false),
+                std::string(), name, true);
+        }
+        return pp->addVariant(loadForMixer(pp->mixer, pack->stream(*entry), true, pp->storage), std::string(), name);
+    }
+    return pp->addVariant(loadForMixer(pp->mixer, (base / std::filesystem::u8path(name)).u8string().c_str(), pp->storage),
+        std::string(), name);
+}
 
+// Parses profile text, assets come from the pack when it is given, then from the store,
+// otherwise from the sibling directory (profiles from before the store)
+static SoundPad *parseSoundPad(std::istream &cfg, const std::filesystem::path &path, MIX_Mixer *mixer, const Pack *pack,
+                               JobPriority priority, const JobGroupPtr &group) {
     std::string line;
 
     // Load layout
@@ -190,7 +436,6 @@ SoundPad *loadSoundPad(const std::filesystem::path &path, MIX_Mixer *mixer) {
 
     // Init soundpad
     SoundPad *pad = new SoundPad();
-    std::unordered_map<char, Pad *> padMap;
     pad->reserve(rows.size());
     for (auto &row : rows) {
         pad->emplace_back(std::vector<Pad>());
@@ -199,147 +444,487 @@ SoundPad *loadSoundPad(const std::filesystem::path &path, MIX_Mixer *mixer) {
         for (auto c : row) {
             if (isspace(c)) continue;
             padRow.emplace_back(Pad(c, mixer));
-            padMap[c] = &padRow.back();
         }
     }
+    pad->buildIndex();
 
-    // Read keys
+    // Read keys; pads are independent, so their assets are decoded in parallel
     std::filesystem::path base = path.parent_path() / path.stem();
+    auto loads = std::make_shared<JobGroup>();
+    std::vector<std::pair<Pad *, std::function<void()> > > sounds; // queued once every pad's usage is known
     while (std::getline(cfg, line)) {
         if (line.empty()) continue;
         char c = toupper(line[0]);
-        auto pp = padMap[c];
+        auto pp = pad->find(c);
         if (!pp) {
             SDL_Log("No pad for key %c in config %s, while its config exists", c, path.u8string().c_str());
             while (std::getline(cfg, line) && !line.empty()); // skip to next
             continue;
         }
-        auto songPath = line.substr(2);
-        if (!songPath.empty() && pp->loadSound((base / std::filesystem::u8path(songPath)).u8string())) {
-            SDL_Log("Loaded sound %s on pad %c", pp->name.c_str(), c);
-        } else {
-            SDL_Log("Failed to load sound %s on pad %c", songPath.c_str(), c);
+        auto songPath = line.size() > 2 ? line.substr(2) : std::string();
+        auto songKey = splitKey(songPath);
+        std::vector<std::pair<std::string, std::string> > variants; // name, key
+        bool more;
+        while ((more = (bool) std::getline(cfg, line)) && line.compare(0, 2, "+ ") == 0) {
+            auto variant = line.substr(2);
+            auto key = splitKey(variant);
+            variants.emplace_back(variant, key);
         }
-        if (!std::getline(cfg, line) || line.empty()) continue;
-        // Loading transitions
-        for (unsigned i = 0; i < line.size() && i < 16; ++i) {
-            c = tolower(line[i]);
-            PadStateRequest r = NONE;
-            switch (c) {
-            case 'o':
-                r = ONE_SHOT;
-                break;
-            case 's':
-                r = STOP;
-                break;
-            case 'p':
-                r = PAUSE;
-                break;
-            case 'r':
-                r = RESUME;
-                break;
-            case 'l':
-                r = LOOP;
-                break;
-            case 'h':
-                r = HELD;
-                break;
-            case 'n':
-            case ' ':
-                break;
-            default:
-                SDL_Log("Unknown request char %c for pad %c in config %s", c, pp->letter, path.u8string().c_str());
-                break;
+        // transitions and the volume line first: the sounds are decoded as its storage word says
+        do {
+            if (!more || line.empty()) break;
+            // Loading transitions
+            for (unsigned i = 0; i < line.size() && i < 16; ++i) {
+                c = tolower(line[i]);
+                PadStateRequest r = NONE;
+                switch (c) {
+                case 'o':
+                    r = ONE_SHOT;
+                    break;
+                case 's':
+                    r = STOP;
+                    break;
+                case 'p':
+                    r = PAUSE;
+                    break;
+                case 'r':
+                    r = RESUME;
+                    break;
+                case 'l':
+                    r = LOOP;
+                    break;
+                case 'h':
+                    r = HELD;
+                    break;
+                case 'n':
+                case ' ':
+                    break;
+                default:
+                    SDL_Log("Unknown request char %c for pad %c in config %s", c, pp->letter, path.u8string().c_str());
+                    break;
+                }
+                pp->table[(i & ctrl)][(i & shift) >> 1][(i & alt) >> 2][(i & playing) >> 3] = r;
             }
-            pp->table[(i & ctrl)][(i & shift) >> 1][(i & alt) >> 2][(i & playing) >> 3] = r;
-        }
-        // loading volume
-        if (!std::getline(cfg, line) || line.empty()) continue;
-        float volume;
-        std::stringstream vars(line);
-        vars >> volume;
-        pp->volume(volume);
-        SDL_Log("Volume of %c is %.3f", pp->letter, volume);
+            // loading volume, then rate, pan, filter, variant pick, storage and slices if any
+            if (!(more = (bool) std::getline(cfg, line)) || line.empty()) break;
+            float volume;
+            std::stringstream vars(line);
+            vars >> volume;
+            pp->volume(volume);
+            SDL_Log("Volume of %c is %.3f", pp->letter, volume);
+            std::string dspText;
+            if (std::getline(vars, dspText)) {
+                PadDsp dsp;
+                dsp.parse(dspText);
+                pp->setDsp(dsp);
+                pp->pick = parsePick(dspText);
+                pp->storage = parseStorage(dspText);
+                pp->usage = parseUsage(dspText);
+                PadSlice trim;
+                std::vector<PadSlice> cues;
+                parseSlices(dspText, trim, cues);
+                if (!trim.whole() || !cues.empty()) {
+                    pp->setSlices(trim, cues);
+                }
+            }
+        } while (false);
+        sounds.emplace_back(pp, [pp, songPath, songKey, variants, pack, base, group]() {
+            if (group && group->cancelled()) {
+                return;
+            }
+            bool loaded = false;
+            if (songPath.empty()) {
+                loaded = false;
+            } else if (!songKey.empty() && !pack) {
+                loaded = pp->loadStoredSound(songKey, songPath);
+            } else if (pack) {
+                auto entry = pack->findSound(songPath);
+                if (!entry) {
+                    loaded = false;
+                } else if (entry->kind == PACK_PCM) {
+                    loaded = pp->loadSound(pack->data(*entry), entry->size, entry->spec, songPath);
+                } else {
+                    loaded = pp->loadSound(pack->stream(*entry), songPath);
+                }
+            } else {
+                loaded = pp->loadSound((base / std::filesystem::u8path(songPath)).u8string());
+            }
+            if (loaded) {
+                SDL_Log("Loaded sound %s on pad %c", pp->name.c_str(), pp->letter);
+            } else if (!songPath.empty()) {
+                SDL_Log("Failed to load sound %s on pad %c", songPath.c_str(), pp->letter);
+            }
+            for (auto &v : variants) {
+                if (!loadVariant(pp, v.first, v.second, pack, base)) {
+                    SDL_Log("Failed to load variant %s on pad %c", v.first.c_str(), pp->letter);
+                }
+            }
+        });
+        if (!more || line.empty()) continue;
         // loading picture
         if (!std::getline(cfg, line) || line.empty()) continue;
         if (line.substr(0, 4) == "pic " && line.size() > 4) {
-            pp->loadPicture((base / std::filesystem::u8path(line.substr(4))).u8string());
+            auto picName = line.substr(4);
+            auto picKey = splitKey(picName);
+            jobs.run(priority, [pp, picName, picKey, pack, base, path, group]() {
+                if (group && group->cancelled()) {
+                    return;
+                }
+                if (!picKey.empty() && !pack) {
+                    pp->loadStoredPicture(picKey, picName);
+                } else if (pack) {
+                    auto entry = pack->find(PACK_PICTURE, picName);
+                    if (entry) {
+                        pp->loadPicture(pack->stream(*entry), picName);
+                    } else {
+                        SDL_Log("No picture %s in bundle %s", picName.c_str(), path.u8string().c_str());
+                    }
+                } else {
+                    pp->loadPicture((base / std::filesystem::u8path(picName)).u8string());
+                }
+            }, loads);
             if (std::getline(cfg, line) && !line.empty()) {
                 pp->pictureOpacity = std::stoi(line);
             }
         }
     }
+    // the most played pads first, so they are ready first; pictures went ahead, they are small
+    SDL_Time now = 0;
+    SDL_GetCurrentTime(&now);
+    now /= SDL_NS_PER_SECOND;
+    std::stable_sort(sounds.begin(), sounds.end(), [now](const auto &a, const auto &b) {
+        return a.first->usage.score(now) > b.first->usage.score(now);
+    });
+    for (auto &s : sounds) {
+        jobs.run(priority, std::move(s.second), loads);
+    }
+    jobs.wait(loads);
+    // no track is made or bound when a variant is first triggered
+    for (auto &row : *pad) {
+        for (auto &p : row) {
+            p.prepareTracks();
+        }
+    }
 
     return pad;
 }
 
-bool saveSoundPad(const std::filesystem::path &path, SoundPad *pad) {
-    std::ofstream cfg(path);
-    if (!cfg.is_open()) {
-        SDL_Log("Failed to open pad config %s for writing", path.u8string().c_str());
-        return false;
+SoundPad *loadSoundPad(const std::filesystem::path &path, MIX_Mixer *mixer, JobPriority priority, const JobGroupPtr &group) {
+    SDL_Log("Loading soundpad config from %s", path.u8string().c_str());
+    auto start = SDL_GetTicksNS();
+    SoundPad *pad;
+    if (isPack(path)) {
+        auto pack = Pack::open(path);
+        if (!pack) {
+            return createDefault(mixer);
+        }
+        std::istringstream cfg{std::string(pack->config())};
+        pad = parseSoundPad(cfg, path, mixer, pack, priority, group);
+        pad->pack = pack;
+    } else {
+        std::ifstream cfg(path);
+        if (!cfg.is_open()) {
+            SDL_Log("Failed to open pad config %s", path.u8string().c_str());
+            return createDefault(mixer);
+        }
+        pad = parseSoundPad(cfg, path, mixer, nullptr, priority, group);
+    }
+    if (group && group->cancelled()) {
+        SDL_Log("Loading %s was cancelled", path.filename().u8string().c_str());
+        delete pad;
+        return nullptr;
     }
+    pad->loadNS = SDL_GetTicksNS() - start;
+    SDL_Log("Opened %s in %.1f ms (%s)", path.filename().u8string().c_str(),
+        pad->loadNS / 1000000.0, pad->pack ? "bundle" : "directory");
+    return pad;
+}
 
-    // Write layout
+std::string serializeLayout(const SoundPad *pad) {
+    std::string res;
     for (auto &row : *pad) {
         for (auto &p : row) {
-            cfg << p.letter;
+            res += p.letter;
         }
-        cfg << std::endl;
+        res += '\n';
     }
+    res += '\n';
+    return res;
+}
+
+std::string serializePad(Pad &p) {
+    std::ostringstream cfg;
+    cfg << p.letter << " " << p.name;
+    if (!p.soundKey.empty()) cfg << '\t' << p.soundKey;
     cfg << std::endl;
+    for (auto &v : p.variants) {
+        cfg << "+ " << v.name;
+        if (!v.soundKey.empty()) cfg << '\t' << v.soundKey;
+        cfg << std::endl;
+    }
+    for (int i = 0; i < 16; ++i) {
+        PadStateRequest r = p.table[(i & ctrl)][(i & shift) >> 1][(i & alt) >> 2][(i & playing) >> 3];
+        char c = ' ';
+        switch (r) {
+        case NONE:
+            c = 'n';
+            break;
+        case ONE_SHOT:
+            c = 'o';
+            break;
+        case STOP:
+            c = 's';
+            break;
+        case PAUSE:
+            c = 'p';
+            break;
+        case RESUME:
+            c = 'r';
+            break;
+        case LOOP:
+            c = 'l';
+            break;
+        case HELD:
+            c = 'h';
+            break;
+        default:
+            SDL_Log("Unknown request %d for pad %c", r, p.letter);
+            break;
+        }
+        cfg << c;
+    }
+    auto dsp = p.dsp.serialize();
+    if (p.pick != PICK_ROUND_ROBIN) {
+        dsp += std::string(dsp.empty() ? "" : " ") + "pick=" + pickWords[p.pick];
+    }
+    if (p.storage != STORAGE_DEFAULT) {
+        dsp += std::string(dsp.empty() ? "" : " ") + "storage=" + storageWords[p.storage];
+    }
+    if (!p.trim.whole()) {
+        dsp += std::string(dsp.empty() ? "" : " ") + "trim=" + sliceText(p.trim);
+    }
+    for (auto &c : p.cues) {
+        dsp += std::string(dsp.empty() ? "" : " ") + "cue=" + c.name + ":" + sliceText(c);
+    }
+    if (p.usage.triggers > 0) {
+        dsp += std::string(dsp.empty() ? "" : " ") + "uses=" + std::to_string(p.usage.triggers) + ":"
+            + std::to_string(p.usage.lastTriggered);
+    }
+    cfg << std::endl 
+        << p.volume()
+        << (dsp.empty() ? "" : " ") << dsp
+        << std::endl
+        << "pic "
+        << p.picturePath;
+    if (!p.pictureKey.empty()) cfg << '\t' << p.pictureKey;
+    if (!p.picturePath.empty()) cfg 
+        << std::endl
+        << p.pictureOpacity;
+    cfg << std::endl
+        << std::endl;
+    return cfg.str();
+}
 
-    // Write keys
+ProfileAssets profileAssets(const SoundPad *pad) {
+    ProfileAssets res;
+    res.pack = pad->pack;
     for (auto &row : *pad) {
         for (auto &p : row) {
-            cfg << p.letter << " " << p.name << std::endl;
-            for (int i = 0; i < 16; ++i) {
-                PadStateRequest r = p.table[(i & ctrl)][(i & shift) >> 1][(i & alt) >> 2][(i & playing) >> 3];
-                char c = ' ';
-                switch (r) {
-                case NONE:
-                    c = 'n';
-                    break;
-                case ONE_SHOT:
-                    c = 'o';
-                    break;
-                case STOP:
-                    c = 's';
-                    break;
-                case PAUSE:
-                    c = 'p';
-                    break;
-                case RESUME:
-                    c = 'r';
-                    break;
-                case LOOP:
-                    c = 'l';
-                    break;
-                case HELD:
-                    c = 'h';
-                    break;
-                default:
-                    SDL_Log("Unknown request %d for pad %c in config %s", r, p.letter, path.u8string().c_str());
-                    break;
-                }
-                cfg << c;
+            res.sounds.push_back(p.name);
+            res.soundKeys.push_back(p.soundKey);
+            for (auto &v : p.variants) {
+                res.sounds.push_back(v.name);
+                res.soundKeys.push_back(v.soundKey);
             }
-            cfg << std::endl 
-                << p.volume()
-                << std::endl
-                << "pic "
-                << p.picturePath;
-            if (!p.picturePath.empty()) cfg 
-                << std::endl
-                << p.pictureOpacity;
-            cfg << std::endl
-                << std::endl;
+            res.pictures.push_back(p.picturePath);
+            res.pictureKeys.push_back(p.pictureKey);
         }
     }
+    return res;
+}
 
+// Stores the profile text and assets in a bundle, taking assets from the loaded bundle first, then from the store or assetDir
+static bool writePack(const std::filesystem::path &path, const std::string &text, const ProfileAssets &assets, const std::filesystem::path &assetDir, bool predecode) {
+    PackWriter w;
+    w.addMemory(PACK_CONFIG, "", text.data(), text.size());
+    auto pack = assets.pack;
+    auto add = [&](PackEntryKind kind, const std::string &name, const std::string &key) {
+        if (name.empty() || w.has(name)) {
+            return;
+        }
+        const PackEntry *entry = nullptr;
+        if (pack) {
+            entry = kind == PACK_SOUND ? pack->findSound(name) : pack->find(kind, name);
+        }
+        auto file = key.empty() ? assetDir / std::filesystem::u8path(name) : assetStore.path(key);
+        if (!entry && !std::filesystem::exists(file)) {
+            SDL_Log("Asset %s is missing, not bundled", name.c_str());
+            return;
+        }
+        if (kind == PACK_SOUND && predecode && !(entry && entry->kind == PACK_PCM)) {
+            std::vector<Uint8> pcm;
+            SDL_AudioSpec spec;
+            auto io = entry ? pack->stream(*entry) : SDL_IOFromFile(file.u8string().c_str(), "rb");
+            if (io && decodeToPCM(io, pcm, spec)) {
+                w.addBuffer(PACK_PCM, name, std::move(pcm), &spec);
+                return;
+            }
+            SDL_Log("Failed to decode %s, storing as is", name.c_str());
+        }
+        if (entry) {
+            w.addMemory(entry->kind, name, pack->data(*entry), entry->size, &entry->spec);
+        } else {
+            w.addFile(kind, name, file);
+        }
+    };
+    for (size_t i = 0; i < assets.sounds.size(); ++i) {
+        add(PACK_SOUND, assets.sounds[i], assets.soundKeys[i]);
+    }
+    for (size_t i = 0; i < assets.pictures.size(); ++i) {
+        add(PACK_PICTURE, assets.pictures[i], assets.pictureKeys[i]);
+    }
+    return w.finish(path);
+}
+
+bool writeProfile(const std::filesystem::path &path, const std::string &text, const ProfileAssets &assets) {
+    TraceSpan span("io", "save");
+    if (isPack(path)) {
+        // keep stored sounds as they are; new ones come from the sibling directory
+        bool predecode = false;
+        if (assets.pack) {
+            for (auto &e : assets.pack->entries()) {
+                predecode |= e.kind == PACK_PCM;
+            }
+        }
+        return writePack(path, text, assets, path.parent_path() / path.stem(), predecode);
+    }
+    if (!writeFileAtomic(path, text)) {
+        SDL_Log("Failed to write pad config %s", path.u8string().c_str());
+        return false;
+    }
+    auto keys = assets.soundKeys;
+    keys.insert(keys.end(), assets.pictureKeys.begin(), assets.pictureKeys.end());
+    assetStore.setRefs(path.filename().u8string(), keys);
     return true;
 }
 
+static std::string serializeSoundPad(SoundPad *pad) {
+    auto text = serializeLayout(pad);
+    for (auto &row : *pad) {
+        for (auto &p : row) {
+            text += serializePad(p);
+        }
+    }
+    return text;
+}
+
+bool saveSoundPad(const std::filesystem::path &path, SoundPad *pad) {
+    return writeProfile(path, serializeSoundPad(pad), profileAssets(pad));
+}
+
+// The saved text with every pad's "uses=" word set from pad, collecting the assets it names
+static std::string withUsage(const std::string &text, const SoundPad *pad, ProfileAssets &assets) {
+    std::istringstream in(text);
+    std::string line, res;
+    while (std::getline(in, line)) {
+        res += line + '\n';
+        if (std::none_of(line.begin(), line.end(), [](char c) { return isalnum((unsigned char) c); })) {
+            break; // end of layout
+        }
+    }
+    const Pad *pp = nullptr;
+    int at = -1; // -1 before a section, then past its name, transitions, volume
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            at = -1;
+        } else if (at < 0) {
+            pp = pad->find(toupper(line[0]));
+            auto name = line.size() > 2 ? line.substr(2) : std::string();
+            auto key = splitKey(name);
+            assets.sounds.push_back(name);
+            assets.soundKeys.push_back(key);
+            at = 0;
+        } else if (at == 0 && line.compare(0, 2, "+ ") == 0) {
+            auto name = line.substr(2);
+            auto key = splitKey(name);
+            assets.sounds.push_back(name);
+            assets.soundKeys.push_back(key);
+        } else if (at < 2) {
+            if (++at == 2 && pp) {
+                std::istringstream words(line);
+                std::string word, kept;
+                while (words >> word) {
+                    if (word.compare(0, 5, "uses=") != 0) {
+                        kept += (kept.empty() ? "" : " ") + word;
+                    }
+                }
+                if (pp->usage.triggers > 0) {
+                    kept += " uses=" + std::to_string(pp->usage.triggers) + ":" + std::to_string(pp->usage.lastTriggered);
+                }
+                line = kept;
+            }
+        } else if (line.compare(0, 4, "pic ") == 0) {
+            auto name = line.substr(4);
+            auto key = splitKey(name);
+            assets.pictures.push_back(name);
+            assets.pictureKeys.push_back(key);
+        }
+        res += line + '\n';
+    }
+    return res;
+}
+
+bool saveUsage(const std::filesystem::path &path, SoundPad *pad) {
+    std::string text;
+    Pack *pack = nullptr;
+    if (isPack(path)) {
+        // the file on disk, the loaded bundle may predate a save
+        if (!(pack = Pack::open(path))) {
+            return false;
+        }
+        text = std::string(pack->config());
+    } else {
+        std::ifstream in(path);
+        if (!in.is_open()) {
+            SDL_Log("Failed to open pad config %s", path.u8string().c_str());
+            return false;
+        }
+        std::stringstream all;
+        all << in.rdbuf();
+        text = all.str();
+    }
+    ProfileAssets assets;
+    assets.pack = pack;
+    text = withUsage(text, pad, assets);
+    bool ok = writeProfile(path, text, assets);
+    delete pack;
+    return ok;
+}
+
+bool exportSoundPad(const std::filesystem::path &profile, const std::filesystem::path &target, bool predecode, MIX_Mixer *mixer) {
+    auto start = SDL_GetTicksNS();
+    auto pad = loadSoundPad(profile, mixer);
+    bool ok = writePack(target, serializeSoundPad(pad), profileAssets(pad), profile.parent_path() / profile.stem(), predecode);
+    delete pad;
+    SDL_Log("Exported %s to %s in %.1f ms", profile.u8string().c_str(), target.u8string().c_str(), (SDL_GetTicksNS() - start) / 1000000.0);
+    return ok;
+}
+
+std::filesystem::path importSoundPad(const std::filesystem::path &bundle, const std::filesystem::path &profilesDir) {
+    auto pack = Pack::open(bundle);
+    if (!pack) {
+        return std::filesystem::path();
+    }
+    delete pack;
+    auto target = profilesDir / bundle.filename();
+    std::error_code ec;
+    if (std::filesystem::exists(target) || !std::filesystem::copy_file(bundle, target, ec)) {
+        SDL_Log("Failed to import %s: %s", bundle.u8string().c_str(), ec ? ec.message().c_str() : "profile already exists");
+        return std::filesystem::path();
+    }
+    return target;
+}
+
 bool saveAppConfig(AppConfig *cfg) {
     auto &root = cfg->appdir;
     std::ofstream app(root / "config.ini");
@@ -347,6 +932,24 @@ bool saveAppConfig(AppConfig *cfg) {
     app << "baseroot=" << cfg->baseRoot.u8string() << std::endl;
     app << "font=" << cfg->fontFiles.first << std::endl;
     app << "monofont=" << cfg->fontFiles.second << std::endl;
+    app << "controlsocket=" << cfg->controlSocket << std::endl;
+    app << "osc=" << cfg->osc << std::endl;
+    app << "oschost=" << cfg->oscHost << std::endl;
+    app << "oscport=" << cfg->oscPort << std::endl;
+    app << "warmcache=" << cfg->warmCacheMB << std::endl;
+    app << "memorybudget=" << cfg->memoryBudgetMB << std::endl;
+    app << "jobthreads=" << cfg->jobThreads << std::endl;
+    app << "trace=" << cfg->trace << std::endl;
+    app << "resampleonload=" << cfg->resampleOnLoad << std::endl;
+    app << "samplestorage=" << storageWords[cfg->sampleStorage] << std::endl;
+    app << "outputdevice=" << cfg->outputDevice << std::endl;
+    app << "recordfloats=" << cfg->recordFloats << std::endl;
+    app << "recordsplitmb=" << cfg->recordSplitMB << std::endl;
+    app << "recordsplitmin=" << cfg->recordSplitMinutes << std::endl;
+    app << "assetstore=" << cfg->storeMigrated << std::endl;
+    app << "fontcache.regular=" << cfg->fontCache.first << std::endl;
+    app << "fontcache.mono=" << cfg->fontCache.second << std::endl;
+    app << "fontcache.stamp=" << cfg->fontCacheStamp << std::endl;
     app.close();
     return true;
 }
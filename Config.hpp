@@ -6,26 +6,76 @@
 //#include <SDL3/SDL_filesystem.h>
 #include <string>
 #include <filesystem>
+#include "Catalog.hpp"
+#include "Jobs.hpp"
 #include "Pad.hpp"
 
 struct AppConfig {
     std::filesystem::path appdir;
     bool autosave = false;
     std::filesystem::path baseRoot;
-    std::vector<std::filesystem::path> profiles;
+    Catalog catalog; // of the profiles dir
     ImFont *fontMono;
     ImFont *fontRegular;
     std::pair<std::string, std::string> fontFiles;
+    std::string controlSocket; // empty if disabled
+    bool osc = false;
+    std::string oscHost = "127.0.0.1";
+    int oscPort = 9000;
+    size_t warmCacheMB = 256; // recently used profiles kept loaded
+    unsigned memoryBudgetMB = 0; // decoded sound of the shown profile, past it the least played is kept encoded; 0 for none
+    unsigned jobThreads = 0; // 0 is by the number of cores
+    bool trace = true; // recent frame, engine and I/O events, dumped on F12
+    bool resampleOnLoad = true; // sounds are converted to the output format once, when loaded
+    SampleStorage sampleStorage = STORAGE_FLOAT; // of sounds, unless a pad says otherwise
+    std::string outputDevice; // by name, empty for the system default
+    bool recordFloats = false; // show recordings in 32-bit float instead of 16-bit
+    unsigned recordSplitMB = 2048; // a new recording file past this size, 0 for none
+    unsigned recordSplitMinutes = 60; // or past this length
+    std::pair<std::string, std::string> fontCache; // last discovered default fonts
+    std::string fontCacheStamp;
+    bool storeMigrated = false; // assets of old profiles were moved to the store
 };
 
 // extern AppConfig appCfg;// = new AppConfig();
 
 SoundPad *createDefault(MIX_Mixer *mixer);
 
-SoundPad *loadSoundPad(const std::filesystem::path &path, MIX_Mixer *mixer);
+// Sounds and pictures are loaded by jobs of the given priority; nullptr only if the group was cancelled
+SoundPad *loadSoundPad(const std::filesystem::path &path, MIX_Mixer *mixer,
+    JobPriority priority = JOB_NOW, const JobGroupPtr &group = nullptr);
 
+// Profile is either a .cfg with a sibling asset directory or a .spack bundle, chosen by extension
 bool saveSoundPad(const std::filesystem::path &path, SoundPad *pad);
 
+// Profile text is the layout followed by every pad's section, in layout order
+std::string serializeLayout(const SoundPad *pad);
+
+std::string serializePad(Pad &pad);
+
+// What a bundle needs besides the text
+struct ProfileAssets {
+    std::vector<std::string> sounds;
+    std::vector<std::string> soundKeys; // per sound, empty if not in the store
+    std::vector<std::string> pictures;
+    std::vector<std::string> pictureKeys;
+    const Pack *pack = nullptr; // must stay alive until written
+};
+
+ProfileAssets profileAssets(const SoundPad *pad);
+
+// Atomically replaces the profile file, safe to call off the UI thread
+bool writeProfile(const std::filesystem::path &path, const std::string &text, const ProfileAssets &assets);
+
+// Rewrites only the trigger counts of the profile saved at path, other unsaved changes stay out
+bool saveUsage(const std::filesystem::path &path, SoundPad *pad);
+
+// Writes the profile as a single .spack, optionally with sounds decoded to PCM
+bool exportSoundPad(const std::filesystem::path &profile, const std::filesystem::path &target, bool predecode, MIX_Mixer *mixer);
+
+// Copies a checked bundle into the profiles dir, returns the new profile path or empty on failure
+std::filesystem::path importSoundPad(const std::filesystem::path &bundle, const std::filesystem::path &profilesDir);
+
 ImFont *getFont(std::string &path, bool useVectorFallback = true);
 
 AppConfig *loadAppConfig();
@@ -0,0 +1,349 @@
+#include "Control.hpp"
+#include "Jobs.hpp"
+#include <functional>
+#include <sstream>
+
+ControlServer::ControlServer(Engine *engine, const std::filesystem::path &path)
+    : engine(engine)
+    , path(path)
+{
+}
+
+ControlServer::~ControlServer() {
+    stop();
+}
+
+std::string ControlServer::handleLine(Client &client, const std::string &line) {
+    std::vector<Command> batch;
+    std::string reply;
+    // the rest of the line is checked before anything is done, these run once it is accepted
+    std::vector<std::function<void()> > actions;
+    std::stringstream cmds(line);
+    std::string cmdText;
+    auto now = SDL_GetTicksNS();
+    while (std::getline(cmds, cmdText, ';')) {
+        std::stringstream args(cmdText);
+        std::string verb;
+        if (!(args >> verb)) continue;
+        if (verb == "t" || verb == "trigger") {
+            std::string pad, request;
+            args >> pad >> request;
+            Command cmd;
+            cmd.type = CMD_TRIGGER;
+            cmd.letter = pad.empty() ? 0 : pad[0];
+            cmd.request = requestFromName(request);
+            cmd.issued = now;
+            if (pad.size() != 1 || cmd.request == NONE) {
+                return "err bad trigger '" + cmdText + "'\n";
+            }
+            batch.push_back(cmd);
+        } else if (verb == "v" || verb == "volume") {
+            std::string pad;
+            Command cmd;
+            cmd.type = CMD_VOLUME;
+            if (!(args >> pad >> cmd.value) || pad.size() != 1) {
+                return "err bad volume '" + cmdText + "'\n";
+            }
+            cmd.letter = pad[0];
+            cmd.issued = now;
+            batch.push_back(cmd);
+        } else if (verb == "c" || verb == "cue") {
+            std::string pad, name;
+            args >> pad;
+            std::getline(args >> std::ws, name);
+            Command cmd;
+            cmd.type = CMD_CUE;
+            cmd.letter = pad.empty() ? 0 : pad[0];
+            auto index = pad.size() == 1 ? engine->findCue(cmd.letter, name) : -1;
+            if (index < 0) {
+                return "err no cue '" + cmdText + "'\n";
+            }
+            cmd.index = (unsigned) index;
+            cmd.issued = now;
+            batch.push_back(cmd);
+        } else if (verb == "x" || verb == "stopall") {
+            Command cmd;
+            cmd.type = CMD_STOP_ALL;
+            cmd.issued = now;
+            batch.push_back(cmd);
+        } else if (verb == "p" || verb == "profile") {
+            std::string name;
+            std::getline(args >> std::ws, name);
+            if (name.empty()) {
+                return "err no profile name\n";
+            }
+            actions.push_back([this, name]() {
+                engine->requestProfile(name);
+            });
+        } else if (verb == "s" || verb == "subscribe") {
+            actions.push_back([this, &client]() {
+                if (client.subscribed) {
+                    return;
+                }
+                // states only change under padLock, so nothing is lost or reordered here
+                std::lock_guard<std::mutex> guard(engine->padLock);
+                flushEvents();
+                client.subscribed = true;
+                for (auto &ps : engine->snapshot()) {
+                    client.out += std::string("state ") + ps.first + " " + stateName(ps.second) + "\n";
+                }
+            });
+        } else if (verb == "u" || verb == "unsubscribe") {
+            actions.push_back([&client]() {
+                client.subscribed = false;
+            });
+        } else if (verb == "ping") {
+            actions.push_back([&reply]() {
+                reply += "pong\n";
+            });
+        } else if (verb == "jobs") {
+            actions.push_back([&reply]() {
+                for (unsigned p = 0; p < JOB_PRIORITIES; ++p) {
+                    auto st = jobs.stats((JobPriority) p);
+                    std::stringstream out;
+                    out << "jobs " << jobPriorityName((JobPriority) p) << " " << jobs.threads() << " " << st.queued << " "
+                        << st.completed << " " << st.cancelled << " " << st.stolen << " "
+                        << (st.completed ? st.totalWaitNS / st.completed / 1000 : 0) << " " << st.maxWaitNS / 1000 << " "
+                        << (st.completed ? st.totalRunNS / st.completed / 1000 : 0) << "\n";
+                    reply += out.str();
+                }
+            });
+        } else if (verb == "trace") {
+            actions.push_back([&reply]() {
+                auto written = tracer.save();
+                reply += written.empty() ? std::string("err trace not written\n") : "trace " + written.u8string() + "\n";
+            });
+        } else if (verb == "stats") {
+            actions.push_back([this, &reply]() {
+                auto st = engine->stats();
+                std::stringstream out;
+                out << "stats " << st.commands << " "
+                    << (st.commands ? st.totalLatencyNS / st.commands / 1000 : 0) << " "
+                    << st.maxLatencyNS / 1000 << " " << st.dropped << " "
+                    << st.latencyPercentileNS(0.99) / 1000 << " " << st.queueDepth << " " << st.maxQueueDepth << "\n";
+                reply += out.str();
+            });
+        } else {
+            return "err unknown command '" + verb + "'\n";
+        }
+    }
+    if (!batch.empty() && !engine->submit(batch.data(), batch.size())) {
+        return "err queue is full\n";
+    }
+    for (auto &action : actions) {
+        action();
+    }
+    return reply + "ok " + std::to_string(batch.size()) + "\n";
+}
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0 // SO_NOSIGPIPE on the socket instead
+#endif
+
+// Output a client may leave unread, e.g. a subscriber that stopped reading
+static const size_t outLimit = 1024 * 1024;
+
+bool ControlServer::start() {
+    if (running) {
+        return true;
+    }
+    auto p = path.u8string();
+    sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (p.size() >= sizeof(addr.sun_path)) {
+        SDL_Log("Control socket path %s is too long", p.c_str());
+        return false;
+    }
+    strncpy(addr.sun_path, p.c_str(), sizeof(addr.sun_path) - 1);
+    listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) {
+        SDL_Log("Failed to create control socket: %s", strerror(errno));
+        return false;
+    }
+    unlink(p.c_str()); // stale socket from previous run
+    if (bind(listenFd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0 || listen(listenFd, 8) != 0) {
+        SDL_Log("Failed to listen on control socket %s: %s", p.c_str(), strerror(errno));
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    fcntl(listenFd, F_SETFL, O_NONBLOCK);
+    if (pipe(wakeFds) != 0) {
+        SDL_Log("Failed to create control wake pipe: %s", strerror(errno));
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    fcntl(wakeFds[0], F_SETFL, O_NONBLOCK);
+    fcntl(wakeFds[1], F_SETFL, O_NONBLOCK);
+    running = true;
+    worker = std::thread(&ControlServer::run, this);
+    SDL_Log("Control socket listening on %s", p.c_str());
+    return true;
+}
+
+void ControlServer::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    wake();
+    if (worker.joinable()) {
+        worker.join();
+    }
+    for (auto &c : clients) {
+        close(c.fd);
+    }
+    clients.clear();
+    close(listenFd);
+    close(wakeFds[0]);
+    close(wakeFds[1]);
+    listenFd = wakeFds[0] = wakeFds[1] = -1;
+    unlink(path.u8string().c_str());
+}
+
+void ControlServer::wake() {
+    char c = 0;
+    if (write(wakeFds[1], &c, 1) < 0 && errno != EAGAIN) {
+        SDL_Log("Failed to wake control thread: %s", strerror(errno));
+    }
+}
+
+void ControlServer::notify(char letter, PadState state) {
+    if (!running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(eventsLock);
+        events += std::string("state ") + letter + " " + stateName(state) + "\n";
+    }
+    wake();
+}
+
+void ControlServer::flushEvents() {
+    std::string pending;
+    {
+        std::lock_guard<std::mutex> guard(eventsLock);
+        pending.swap(events);
+    }
+    if (pending.empty()) {
+        return;
+    }
+    for (auto &c : clients) {
+        if (c.subscribed) {
+            c.out += pending;
+        }
+    }
+}
+
+void ControlServer::run() {
+    tracer.nameThread("control");
+    std::vector<pollfd> fds;
+    char buf[4096];
+    while (running) {
+        fds.clear();
+        fds.push_back({wakeFds[0], POLLIN, 0});
+        fds.push_back({listenFd, POLLIN, 0});
+        for (auto &c : clients) {
+            fds.push_back({c.fd, static_cast<short>(POLLIN | (c.out.empty() ? 0 : POLLOUT)), 0});
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            SDL_Log("Control socket poll failed: %s", strerror(errno));
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            while (read(wakeFds[0], buf, sizeof(buf)) > 0);
+        }
+        if (fds[1].revents & POLLIN) {
+            int fd;
+            while ((fd = accept(listenFd, nullptr, nullptr)) >= 0) {
+                fcntl(fd, F_SETFL, O_NONBLOCK);
+#ifdef SO_NOSIGPIPE
+                int one = 1;
+                setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+                clients.push_back(Client{fd});
+            }
+        }
+        flushEvents();
+        // clients accepted during this iteration are polled on the next one
+        for (size_t i = 2; i < fds.size(); ++i) {
+            auto &c = clients[i - 2];
+            bool drop = (fds[i].revents & (POLLERR | POLLHUP)) != 0;
+            if (fds[i].revents & POLLIN) {
+                ssize_t n;
+                while ((n = read(c.fd, buf, sizeof(buf))) > 0) {
+                    c.in.append(buf, n);
+                }
+                if (n == 0) {
+                    drop = true;
+                }
+                size_t eol;
+                while ((eol = c.in.find('\n')) != std::string::npos) {
+                    auto line = c.in.substr(0, eol);
+                    if (!line.empty() && line.back() == '\r') line.pop_back();
+                    c.in.erase(0, eol + 1);
+                    c.out += handleLine(c, line);
+                }
+            }
+            if (!c.out.empty()) {
+                // a client gone meanwhile is EPIPE here, not a signal killing the app
+                auto n = send(c.fd, c.out.data(), c.out.size(), MSG_NOSIGNAL);
+                if (n > 0) {
+                    c.out.erase(0, n);
+                } else if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    drop = true;
+                }
+            }
+            if (c.out.size() > outLimit) {
+                SDL_Log("Control client has %zu bytes unread, disconnecting", c.out.size());
+                drop = true;
+            }
+            if (drop) {
+                close(c.fd);
+                c.fd = -1;
+            }
+        }
+        for (auto ci = clients.begin(); ci != clients.end();) {
+            if (ci->fd < 0) {
+                ci = clients.erase(ci);
+            } else {
+                ++ci;
+            }
+        }
+    }
+}
+
+#else // no unix sockets here yet
+
+bool ControlServer::start() {
+    SDL_Log("Control socket is not supported on this platform");
+    return false;
+}
+
+void ControlServer::stop() {
+}
+
+void ControlServer::wake() {
+}
+
+void ControlServer::notify(char letter, PadState state) {
+}
+
+void ControlServer::flushEvents() {
+}
+
+void ControlServer::run() {
+}
+
+#endif // _WIN32
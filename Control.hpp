@@ -0,0 +1,72 @@
+#ifndef CONTROL_HPP
+#define CONTROL_HPP
+
+#include "preface.hpp"
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Engine.hpp"
+
+/**
+ * Local control socket (unix domain, line protocol).
+ *
+ * Each line holds one or more commands separated by ';', all of them are
+ * submitted to the engine as a single batch:
+ *   t <pad> <request>   trigger pad (request: oneshot, stop, pause, resume, loop, held or o/s/p/r/l/h)
+ *   v <pad> <volume>    set pad volume
+ *   x                   stop all pads
+ *   p <profile>         switch profile (file name in profiles dir)
+ *   s / u               subscribe to / unsubscribe from state events
+ *   ping                reply with 'pong'
+ *   stats               reply with 'stats <commands> <avg us> <max us> <dropped> <p99 us> <queue depth> <max queue depth>'
+ * Every line is answered with 'ok <commands>' or 'err <reason>',
+ * a line with an error is rejected as a whole, before any of it is done.
+ * Replies to ping, stats and the like come after the line is accepted; a
+ * trace that can't be written is answered with 'err trace not written'
+ * while the rest of the line stands.
+ * Subscribers get 'state <pad> <IDLE|PLAYING|PAUSED|LOOPED>' lines,
+ * starting with the state of every pad. A client with more than a megabyte
+ * of output it hasn't read is disconnected.
+ */
+class ControlServer {
+public:
+    ControlServer(Engine *engine, const std::filesystem::path &path);
+    ~ControlServer();
+
+    bool start();
+
+    void stop();
+
+    // Queues a state event for subscribers, may be called from any thread
+    void notify(char letter, PadState state);
+private:
+    struct Client {
+        int fd;
+        bool subscribed = false;
+        std::string in;
+        std::string out;
+    };
+
+    Engine *engine;
+    std::filesystem::path path;
+    int listenFd = -1;
+    int wakeFds[2] = {-1, -1};
+    std::atomic<bool> running = false;
+    std::thread worker;
+    std::vector<Client> clients; // owned by the worker thread
+    std::mutex eventsLock;
+    std::string events;
+
+    void run();
+
+    void wake();
+
+    void flushEvents();
+
+    std::string handleLine(Client &client, const std::string &line);
+};
+
+#endif // CONTROL_HPP
@@ -0,0 +1,271 @@
+#include "Dsp.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <sstream>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define DSP_X86
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define DSP_TARGET(isa) __attribute__((target(isa)))
+#else
+#define DSP_TARGET(isa)
+#endif
+#endif
+
+std::string PadDsp::serialize() const {
+    std::ostringstream out;
+    if (rate != 1.f) {
+        out << " rate=" << rate;
+    }
+    if (pan != 0.f) {
+        out << " pan=" << pan;
+    }
+    if (filter != FILTER_OFF) {
+        out << " " << (filter == FILTER_LOWPASS ? "lowpass=" : "highpass=") << cutoff << ":" << resonance;
+    }
+    auto res = out.str();
+    return res.empty() ? res : res.substr(1);
+}
+
+void PadDsp::parse(const std::string &text) {
+    std::istringstream in(text);
+    std::string word;
+    while (in >> word) {
+        auto eq = word.find('=');
+        if (eq == std::string::npos) {
+            continue;
+        }
+        auto key = word.substr(0, eq);
+        auto value = word.c_str() + eq + 1;
+        if (key == "rate") {
+            rate = std::clamp(std::strtof(value, nullptr), 0.25f, 4.f);
+        } else if (key == "pan") {
+            pan = std::clamp(std::strtof(value, nullptr), -1.f, 1.f);
+        } else if (key == "lowpass" || key == "highpass") {
+            char *end;
+            filter = key == "lowpass" ? FILTER_LOWPASS : FILTER_HIGHPASS;
+            cutoff = std::clamp(std::strtof(value, &end), 10.f, 24000.f);
+            if (*end == ':') {
+                resonance = std::clamp(std::strtof(end + 1, nullptr), 0.1f, 20.f);
+            }
+        }
+    }
+}
+
+const char *filterName(FilterType type) {
+    switch (type) {
+    case FILTER_OFF:
+        return "Off";
+    case FILTER_LOWPASS:
+        return "Low-pass";
+    case FILTER_HIGHPASS:
+        return "High-pass";
+    }
+    return "Unknown";
+}
+
+BiquadCoeffs designFilter(FilterType type, float cutoff, float q, int rate) {
+    BiquadCoeffs c;
+    if (type == FILTER_OFF || rate <= 0) {
+        return c;
+    }
+    const double pi = 3.14159265358979323846;
+    double w0 = 2 * pi * std::clamp<double>(cutoff, 10, rate * 0.45) / rate;
+    double cosw = std::cos(w0);
+    double alpha = std::sin(w0) / (2 * std::clamp<double>(q, 0.1, 20));
+    double a0 = 1 + alpha;
+    double b1 = type == FILTER_LOWPASS ? 1 - cosw : -(1 + cosw);
+    c.b0 = (float) (std::abs(b1) / 2 / a0);
+    c.b1 = (float) (b1 / a0);
+    c.b2 = c.b0;
+    c.a1 = (float) (-2 * cosw / a0);
+    c.a2 = (float) ((1 - alpha) / a0);
+    return c;
+}
+
+void Biquad::set(const BiquadCoeffs &c) {
+    coeffs = c;
+    // response of four steps to each input alone; the filter is linear, so blocks are sums of these
+    for (int j = 0; j < 8; ++j) {
+        float in[8] = {};
+        in[j] = 1.f;
+        float x1 = in[4], x2 = in[5], y1 = in[6], y2 = in[7];
+        for (int i = 0; i < 4; ++i) {
+            float y = c.b0 * in[i] + c.b1 * x1 + c.b2 * x2 - c.a1 * y1 - c.a2 * y2;
+            block[j][i] = y;
+            x2 = x1;
+            x1 = in[i];
+            y2 = y1;
+            y1 = y;
+        }
+    }
+}
+
+void Biquad::reset() {
+    std::fill(&state[0][0], &state[0][0] + maxChannels * 4, 0.f);
+}
+
+// A decaying tail would otherwise end in denormals, which are slow on most CPUs
+static void flushTiny(float *s) {
+    for (int i = 0; i < 4; ++i) {
+        if (std::abs(s[i]) < 1e-20f) {
+            s[i] = 0.f;
+        }
+    }
+}
+
+static void biquadScalar(Biquad &f, float *pcm, int frames, int channels) {
+    auto &c = f.coeffs;
+    for (int ch = 0; ch < channels && ch < Biquad::maxChannels; ++ch) {
+        float *s = f.state[ch];
+        float x1 = s[0], x2 = s[1], y1 = s[2], y2 = s[3];
+        for (int i = 0; i < frames; ++i) {
+            float &v = pcm[(size_t) i * channels + ch];
+            float y = c.b0 * v + c.b1 * x1 + c.b2 * x2 - c.a1 * y1 - c.a2 * y2;
+            x2 = x1;
+            x1 = v;
+            y2 = y1;
+            y1 = y;
+            v = y;
+        }
+        s[0] = x1;
+        s[1] = x2;
+        s[2] = y1;
+        s[3] = y2;
+        flushTiny(s);
+    }
+}
+
+#ifdef DSP_X86
+
+// Four frames of one channel; the state stays broadcast across lanes between blocks
+DSP_TARGET("sse2") static inline __m128 block4(const __m128 *k, __m128 x, __m128 &x1, __m128 &x2, __m128 &y1, __m128 &y2) {
+    __m128 a = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(x, x, 0x00), k[0]), _mm_mul_ps(_mm_shuffle_ps(x, x, 0x55), k[1]));
+    __m128 b = _mm_add_ps(_mm_mul_ps(_mm_shuffle_ps(x, x, 0xaa), k[2]), _mm_mul_ps(_mm_shuffle_ps(x, x, 0xff), k[3]));
+    __m128 c = _mm_add_ps(_mm_mul_ps(x1, k[4]), _mm_mul_ps(x2, k[5]));
+    __m128 d = _mm_add_ps(_mm_mul_ps(y1, k[6]), _mm_mul_ps(y2, k[7]));
+    __m128 y = _mm_add_ps(_mm_add_ps(a, b), _mm_add_ps(c, d));
+    x1 = _mm_shuffle_ps(x, x, 0xff);
+    x2 = _mm_shuffle_ps(x, x, 0xaa);
+    y1 = _mm_shuffle_ps(y, y, 0xff);
+    y2 = _mm_shuffle_ps(y, y, 0xaa);
+    return y;
+}
+
+DSP_TARGET("sse2") static void loadState(const float *s, __m128 *v) {
+    for (int i = 0; i < 4; ++i) {
+        v[i] = _mm_set1_ps(s[i]);
+    }
+}
+
+DSP_TARGET("sse2") static void storeState(float *s, const __m128 *v) {
+    for (int i = 0; i < 4; ++i) {
+        s[i] = _mm_cvtss_f32(v[i]);
+    }
+    flushTiny(s);
+}
+
+DSP_TARGET("sse2") static void biquadSSE2(Biquad &f, float *pcm, int frames, int channels) {
+    if (channels != 1 && channels != 2) {
+        biquadScalar(f, pcm, frames, channels);
+        return;
+    }
+    __m128 k[8];
+    for (int j = 0; j < 8; ++j) {
+        k[j] = _mm_load_ps(f.block[j]);
+    }
+    int blocks = frames / 4;
+    __m128 l[4], r[4];
+    loadState(f.state[0], l);
+    if (channels == 1) {
+        for (int b = 0; b < blocks; ++b) {
+            float *p = pcm + b * 4;
+            _mm_storeu_ps(p, block4(k, _mm_loadu_ps(p), l[0], l[1], l[2], l[3]));
+        }
+    } else {
+        loadState(f.state[1], r);
+        for (int b = 0; b < blocks; ++b) {
+            float *p = pcm + b * 8;
+            __m128 lo = _mm_loadu_ps(p), hi = _mm_loadu_ps(p + 4);
+            __m128 left = block4(k, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)), l[0], l[1], l[2], l[3]);
+            __m128 right = block4(k, _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)), r[0], r[1], r[2], r[3]);
+            _mm_storeu_ps(p, _mm_unpacklo_ps(left, right));
+            _mm_storeu_ps(p + 4, _mm_unpackhi_ps(left, right));
+        }
+        storeState(f.state[1], r);
+    }
+    storeState(f.state[0], l);
+    biquadScalar(f, pcm + blocks * 4 * channels, frames - blocks * 4, channels);
+}
+
+// Both channels of four stereo frames in one register, left in the low half
+DSP_TARGET("avx2") static void biquadAVX2(Biquad &f, float *pcm, int frames, int channels) {
+    if (channels != 2) {
+        biquadSSE2(f, pcm, frames, channels);
+        return;
+    }
+    __m256 k[8];
+    for (int j = 0; j < 8; ++j) {
+        k[j] = _mm256_broadcast_ps(reinterpret_cast<const __m128 *>(f.block[j]));
+    }
+    __m256 s[4];
+    for (int i = 0; i < 4; ++i) {
+        s[i] = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_set1_ps(f.state[0][i])), _mm_set1_ps(f.state[1][i]), 1);
+    }
+    const __m256i split = _mm256_setr_epi32(0, 2, 4, 6, 1, 3, 5, 7);
+    const __m256i merge = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    int blocks = frames / 4;
+    for (int b = 0; b < blocks; ++b) {
+        float *p = pcm + b * 8;
+        __m256 x = _mm256_permutevar8x32_ps(_mm256_loadu_ps(p), split);
+        __m256 a = _mm256_add_ps(_mm256_mul_ps(_mm256_shuffle_ps(x, x, 0x00), k[0]), _mm256_mul_ps(_mm256_shuffle_ps(x, x, 0x55), k[1]));
+        __m256 c = _mm256_add_ps(_mm256_mul_ps(_mm256_shuffle_ps(x, x, 0xaa), k[2]), _mm256_mul_ps(_mm256_shuffle_ps(x, x, 0xff), k[3]));
+        __m256 d = _mm256_add_ps(_mm256_mul_ps(s[0], k[4]), _mm256_mul_ps(s[1], k[5]));
+        __m256 e = _mm256_add_ps(_mm256_mul_ps(s[2], k[6]), _mm256_mul_ps(s[3], k[7]));
+        __m256 y = _mm256_add_ps(_mm256_add_ps(a, c), _mm256_add_ps(d, e));
+        s[0] = _mm256_shuffle_ps(x, x, 0xff);
+        s[1] = _mm256_shuffle_ps(x, x, 0xaa);
+        s[2] = _mm256_shuffle_ps(y, y, 0xff);
+        s[3] = _mm256_shuffle_ps(y, y, 0xaa);
+        _mm256_storeu_ps(p, _mm256_permutevar8x32_ps(y, merge));
+    }
+    for (int i = 0; i < 4; ++i) {
+        f.state[0][i] = _mm_cvtss_f32(_mm256_castps256_ps128(s[i]));
+        f.state[1][i] = _mm_cvtss_f32(_mm256_extractf128_ps(s[i], 1));
+    }
+    flushTiny(f.state[0]);
+    flushTiny(f.state[1]);
+    biquadScalar(f, pcm + blocks * 8, frames - blocks * 4, channels);
+}
+
+#endif // DSP_X86
+
+std::vector<BiquadKernelInfo> biquadKernels() {
+    std::vector<BiquadKernelInfo> res = {{"scalar", biquadScalar}};
+#ifdef DSP_X86
+    if (SDL_HasSSE2()) {
+        res.push_back({"sse2", biquadSSE2});
+    }
+    if (SDL_HasAVX2()) {
+        res.push_back({"avx2", biquadAVX2});
+    }
+#endif
+    return res;
+}
+
+void Biquad::process(float *pcm, int frames, int channels) {
+    static const BiquadKernel kernel = biquadKernels().back().run; // picked once
+    kernel(*this, pcm, frames, channels);
+}
+
+void SDLCALL filterTrack(void *userdata, MIX_Track *track, const SDL_AudioSpec *spec, float *pcm, int samples) {
+    auto f = static_cast<TrackFilter *>(userdata);
+    if (f->changed || f->rate != spec->freq) {
+        f->biquad.set(designFilter(f->type, f->cutoff, f->resonance, spec->freq));
+        f->rate = spec->freq;
+        f->changed = false;
+    }
+    f->biquad.process(pcm, samples / std::max(spec->channels, 1), spec->channels);
+}
@@ -0,0 +1,100 @@
+#ifndef DSP_HPP
+#define DSP_HPP
+
+#include "preface.hpp"
+#include <string>
+#include <vector>
+
+enum FilterType {
+    FILTER_OFF,
+    FILTER_LOWPASS,
+    FILTER_HIGHPASS,
+};
+
+// Per-pad processing, stored in the profile; the default is neutral and costs nothing
+struct PadDsp {
+    float rate = 1.f;         // playback speed, pitch follows
+    float pan = 0.f;          // -1 is left only, 1 is right only
+    FilterType filter = FILTER_OFF;
+    float cutoff = 1000.f;    // Hz
+    float resonance = 0.707f; // Q, 0.707 has no peak
+
+    bool neutral() const {
+        return rate == 1.f && pan == 0.f && filter == FILTER_OFF;
+    }
+
+    bool operator==(const PadDsp &o) const {
+        return rate == o.rate && pan == o.pan && filter == o.filter && cutoff == o.cutoff && resonance == o.resonance;
+    }
+
+    bool operator!=(const PadDsp &o) const {
+        return !(*this == o);
+    }
+
+    // Goes after the volume in a profile, e.g. "rate=1.5 pan=-0.25 lowpass=800:2"; empty if neutral
+    std::string serialize() const;
+
+    // Reads what serialize() writes, unknown words are skipped
+    void parse(const std::string &text);
+};
+
+const char *filterName(FilterType type);
+
+// Normalized by a0
+struct BiquadCoeffs {
+    float b0 = 1.f;
+    float b1 = 0.f;
+    float b2 = 0.f;
+    float a1 = 0.f;
+    float a2 = 0.f;
+};
+
+// Resonant low- or high-pass of the audio EQ cookbook; FILTER_OFF passes everything
+BiquadCoeffs designFilter(FilterType type, float cutoff, float q, int rate);
+
+/**
+ * Direct form I biquad over interleaved float samples. Block kernels make four
+ * frames at once: each output of a block is a fixed combination of the block's
+ * inputs and the two previous inputs and outputs, so the recursion becomes
+ * eight multiply-adds of 4-wide vectors per channel.
+ */
+class Biquad {
+public:
+    static const int maxChannels = 8; // the rest pass unfiltered
+
+    void set(const BiquadCoeffs &c);
+
+    void reset();
+
+    // With the fastest kernel the CPU has
+    void process(float *pcm, int frames, int channels);
+
+    BiquadCoeffs coeffs;
+    alignas(16) float block[8][4] = {}; // per input (x0..x3, x-1, x-2, y-1, y-2), its weight in y0..y3
+    float state[maxChannels][4] = {};   // x-1, x-2, y-1, y-2
+};
+
+typedef void (*BiquadKernel)(Biquad &f, float *pcm, int frames, int channels);
+
+struct BiquadKernelInfo {
+    const char *name;
+    BiquadKernel run;
+};
+
+// Kernels this CPU can run, slowest first; process() uses the last
+std::vector<BiquadKernelInfo> biquadKernels();
+
+// Filter of one track; settings are written under the mixer lock
+struct TrackFilter {
+    FilterType type = FILTER_OFF;
+    float cutoff = 1000.f;
+    float resonance = 0.707f;
+    bool changed = true; // coefficients are made on the mixer thread, which knows the rate
+    int rate = 0;
+    Biquad biquad;
+};
+
+// MIX_TrackMixCallback of a track with a TrackFilter
+void SDLCALL filterTrack(void *userdata, MIX_Track *track, const SDL_AudioSpec *spec, float *pcm, int samples);
+
+#endif // DSP_HPP
@@ -0,0 +1,466 @@
+#include "Engine.hpp"
+#include "AssetStore.hpp"
+#include <algorithm>
+#include <cctype>
+
+// States of playing pads are polled this often, ms
+static const Sint32 pollInterval = 10;
+
+static void dropSound(LoadedSound *sound) {
+    if (!sound) {
+        return;
+    }
+    if (sound->audio && sound->key.empty()) {
+        MIX_DestroyAudio(sound->audio);
+    } else if (sound->audio) {
+        assetStore.releaseAudio(sound->key, sound->audio);
+    }
+    delete sound;
+}
+
+static const char *commandName(CommandType type) {
+    switch (type) {
+    case CMD_NONE:
+        return "none";
+    case CMD_TRIGGER:
+        return "trigger";
+    case CMD_VOLUME:
+        return "volume";
+    case CMD_STOP_ALL:
+        return "stop all";
+    case CMD_PRESS:
+        return "press";
+    case CMD_RELEASE:
+        return "release";
+    case CMD_SOUND:
+        return "sound";
+    case CMD_DSP:
+        return "dsp";
+    case CMD_VARIANT:
+        return "variant";
+    case CMD_CUE:
+        return "cue";
+    }
+    return "unknown";
+}
+
+Uint64 EngineStats::latencyPercentileNS(double part) const {
+    Uint64 total = 0;
+    for (auto b : latencyBuckets) {
+        total += b;
+    }
+    Uint64 seen = 0;
+    for (unsigned i = 0; i < sizeof(latencyBuckets) / sizeof(latencyBuckets[0]); ++i) {
+        seen += latencyBuckets[i];
+        if (total > 0 && seen >= total * part) {
+            return (1ull << i) * 1000;
+        }
+    }
+    return maxLatencyNS;
+}
+
+Engine::~Engine() {
+    stop();
+}
+
+bool Engine::start() {
+    if (running) {
+        return true;
+    }
+    wakeup = SDL_CreateSemaphore(0);
+    if (!wakeup) {
+        SDL_Log("Failed to create engine semaphore: %s", SDL_GetError());
+        return false;
+    }
+    running = true;
+    worker = std::thread(&Engine::run, this);
+    return true;
+}
+
+void Engine::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    SDL_SignalSemaphore(wakeup);
+    if (worker.joinable()) {
+        worker.join();
+    }
+    SDL_DestroySemaphore(wakeup);
+    wakeup = nullptr;
+}
+
+void Engine::attach(SoundPad *pads) {
+    {
+        std::lock_guard<std::mutex> guard(padLock);
+        this->pads = pads;
+        reattached = true; // a warm soundpad may be playing already
+    }
+    if (wakeup) {
+        SDL_SignalSemaphore(wakeup);
+    }
+}
+
+bool Engine::submit(const Command &cmd) {
+    return submit(&cmd, 1);
+}
+
+bool Engine::submit(const Command *cmds, size_t count) {
+    if (count == 0) {
+        return true;
+    }
+    if (queue.capacity() - queue.size() < count) {
+        // don't start a batch which can't be finished
+        dropped += count;
+        return false;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        Command cmd = cmds[i];
+        cmd.more = i + 1 < count;
+        TraceSpan span("engine", "submit", cmd.letter, cmd.type == CMD_TRIGGER ? requestName(cmd.request) : commandName(cmd.type));
+        cmd.flow = tracer.newFlow();
+        span.flow(cmd.flow, 's');
+        while (!queue.push(cmd)) {
+            if (i == 0) {
+                dropped += count;
+                return false;
+            }
+            // rest of the batch must follow, consumer is draining already
+            std::this_thread::yield();
+        }
+    }
+    accepted += count;
+    if (wakeup) {
+        SDL_SignalSemaphore(wakeup);
+    }
+    return true;
+}
+
+bool Engine::press(char letter, bool ctrl, bool shift, bool alt) {
+    Command cmd;
+    cmd.type = CMD_PRESS;
+    cmd.letter = letter;
+    cmd.mods = (ctrl ? MOD_CTRL : 0) | (shift ? MOD_SHIFT : 0) | (alt ? MOD_ALT : 0);
+    cmd.issued = SDL_GetTicksNS();
+    return submit(cmd);
+}
+
+bool Engine::release(char letter) {
+    Command cmd;
+    cmd.type = CMD_RELEASE;
+    cmd.letter = letter;
+    cmd.issued = SDL_GetTicksNS();
+    return submit(cmd);
+}
+
+bool Engine::assign(SoundPad *pads, char letter, MIX_Audio *audio, const std::string &key, const std::string &name) {
+    return submitSound(CMD_SOUND, pads, letter, audio, key, name);
+}
+
+bool Engine::addVariant(SoundPad *pads, char letter, MIX_Audio *audio, const std::string &key, const std::string &name) {
+    return submitSound(CMD_VARIANT, pads, letter, audio, key, name);
+}
+
+bool Engine::submitSound(CommandType type, SoundPad *pads, char letter, MIX_Audio *audio, const std::string &key,
+                         const std::string &name) {
+    Command cmd;
+    cmd.type = type;
+    cmd.letter = letter;
+    cmd.sound = new LoadedSound{pads, audio, key, name};
+    cmd.issued = SDL_GetTicksNS();
+    if (!submit(cmd)) {
+        dropSound(cmd.sound);
+        return false;
+    }
+    return true;
+}
+
+int Engine::findCue(char letter, const std::string &name) {
+    std::lock_guard<std::mutex> guard(padLock);
+    Pad *p = find(letter);
+    return p ? p->findCue(name) : -1;
+}
+
+void Engine::wait() {
+    auto until = SDL_GetTicksNS() + 100000000; // the engine is stopped or stuck otherwise
+    while (handled < accepted && SDL_GetTicksNS() < until) {
+        std::this_thread::yield();
+    }
+}
+
+void Engine::refresh() {
+    std::lock_guard<std::mutex> guard(padLock);
+    resolveAll();
+}
+
+void Engine::requestProfile(const std::string &name) {
+    std::lock_guard<std::mutex> guard(profileLock);
+    pendingProfile = name;
+}
+
+std::string Engine::takeProfileRequest() {
+    std::lock_guard<std::mutex> guard(profileLock);
+    std::string res;
+    res.swap(pendingProfile);
+    return res;
+}
+
+EngineStats Engine::stats() {
+    std::lock_guard<std::mutex> guard(padLock);
+    EngineStats res = counters;
+    res.dropped = dropped;
+    res.queueDepth = queue.size();
+    return res;
+}
+
+std::vector<std::pair<char, PadState> > Engine::snapshot() {
+    std::vector<std::pair<char, PadState> > res;
+    if (pads) {
+        for (auto &row : *pads) {
+            for (auto &p : row) {
+                res.emplace_back(p.letter, p.state);
+            }
+        }
+    }
+    return res;
+}
+
+void Engine::run() {
+    tracer.nameThread("engine");
+    std::vector<Command> due;
+    std::vector<Command> scheduled;
+    due.reserve(queue.capacity());
+    scheduled.reserve(queue.capacity());
+    Sint32 timeout = -1;
+    bool active = false;
+    while (running) {
+        SDL_WaitSemaphoreTimeout(wakeup, timeout);
+        Command cmd;
+        auto now = SDL_GetTicksNS();
+        size_t popped = 0;
+        while (queue.pop(cmd)) {
+            (cmd.at > now ? scheduled : due).push_back(cmd);
+            ++popped;
+            while (cmd.more) {
+                // producer is in the middle of the batch
+                while (!queue.pop(cmd)) std::this_thread::yield();
+                (cmd.at > now ? scheduled : due).push_back(cmd);
+                ++popped;
+            }
+        }
+        timeout = active ? pollInterval : -1;
+        if (!scheduled.empty()) {
+            Uint64 next = UINT64_MAX;
+            for (auto si = scheduled.begin(); si != scheduled.end();) {
+                if (si->at <= now) {
+                    due.push_back(*si);
+                    si = scheduled.erase(si);
+                } else {
+                    next = std::min(next, si->at);
+                    ++si;
+                }
+            }
+            if (next != UINT64_MAX) {
+                auto untilNext = (Sint32) ((next - now + 999999) / 1000000);
+                timeout = timeout < 0 ? untilNext : std::min(timeout, untilNext);
+            }
+        }
+        std::lock_guard<std::mutex> guard(padLock);
+        counters.maxQueueDepth = std::max(counters.maxQueueDepth, popped);
+        for (auto &c : due) {
+            TraceSpan span("engine", commandName(c.type), c.letter, c.type == CMD_TRIGGER ? requestName(c.request) : nullptr);
+            span.flow(c.flow, 't');
+            apply(c, span.event);
+            auto latency = SDL_GetTicksNS() - std::max(c.issued, c.at);
+            span.value("latencyUS", (Uint32) std::min<Uint64>(latency / 1000, UINT32_MAX));
+            ++counters.commands;
+            counters.totalLatencyNS += latency;
+            if (latency > counters.maxLatencyNS) {
+                counters.maxLatencyNS = latency;
+            }
+            unsigned bucket = 0;
+            while ((1ull << bucket) * 1000 < latency && bucket + 1 < sizeof(counters.latencyBuckets) / sizeof(counters.latencyBuckets[0])) {
+                ++bucket;
+            }
+            ++counters.latencyBuckets[bucket];
+        }
+        due.clear();
+        handled += popped;
+        if (active || popped > 0 || reattached) {
+            reattached = false;
+            // tracks end on their own, someone has to notice
+            bool wasActive = active;
+            TraceSpan span("engine", "poll");
+            active = resolveAll();
+            if (active && !wasActive && (timeout < 0 || timeout > pollInterval)) {
+                timeout = pollInterval;
+            }
+        }
+    }
+    Command cmd;
+    while (queue.pop(cmd)) {
+        dropSound(cmd.sound);
+    }
+    for (auto &c : scheduled) {
+        dropSound(c.sound);
+    }
+}
+
+bool Engine::resolveAll() {
+    if (!pads) {
+        return false;
+    }
+    bool active = false;
+    for (auto &row : *pads) {
+        for (auto &p : row) {
+            p.resolveState();
+            active |= p.state != IDLE;
+        }
+    }
+    return active;
+}
+
+Pad *Engine::find(char letter) {
+    if (!pads) {
+        return nullptr;
+    }
+    return pads->find(letter);
+}
+
+void Engine::apply(const Command &cmd, TraceEvent &trace) {
+    switch (cmd.type) {
+    case CMD_NONE:
+        break;
+    case CMD_TRIGGER: {
+        Pad *p = find(cmd.letter);
+        if (!p) {
+            SDL_Log("Engine: no pad %c", cmd.letter);
+            break;
+        }
+        p->request = cmd.request;
+        p->fulfillRequest(cmd.flow);
+        p->resolveState();
+        break;
+    }
+    case CMD_VOLUME: {
+        Pad *p = find(cmd.letter);
+        if (!p) {
+            SDL_Log("Engine: no pad %c", cmd.letter);
+            break;
+        }
+        p->volume(cmd.value);
+        break;
+    }
+    case CMD_DSP: {
+        Pad *p = find(cmd.letter);
+        if (!p) {
+            SDL_Log("Engine: no pad %c", cmd.letter);
+            break;
+        }
+        p->setDsp(cmd.dsp);
+        break;
+    }
+    case CMD_PRESS:
+    case CMD_RELEASE: {
+        Pad *p = find(cmd.letter);
+        if (!p) {
+            break; // keys without a pad
+        }
+        if (cmd.type == CMD_PRESS) {
+            p->press(cmd.mods & MOD_CTRL, cmd.mods & MOD_SHIFT, cmd.mods & MOD_ALT);
+        } else {
+            p->release();
+        }
+        trace.detail = requestName(p->request); // what the key means depends on the pad
+        p->fulfillRequest(cmd.flow);
+        p->resolveState();
+        break;
+    }
+    case CMD_SOUND: {
+        Pad *p = cmd.sound->pads == pads ? find(cmd.letter) : nullptr;
+        if (!p) {
+            SDL_Log("Engine: pad %c is gone, dropping its sound", cmd.letter);
+            dropSound(cmd.sound);
+            break;
+        }
+        if (cmd.sound->audio) {
+            p->adoptSound(cmd.sound->audio, cmd.sound->key, cmd.sound->name);
+            p->prepareTracks();
+        } else {
+            p->unloadSound();
+            p->clearVariants();
+        }
+        p->resolveState();
+        delete cmd.sound;
+        break;
+    }
+    case CMD_VARIANT: {
+        Pad *p = !cmd.sound || cmd.sound->pads == pads ? find(cmd.letter) : nullptr;
+        if (!p) {
+            SDL_Log("Engine: pad %c is gone, dropping its variant", cmd.letter);
+            dropSound(cmd.sound);
+            break;
+        }
+        if (cmd.sound) {
+            p->addVariant(cmd.sound->audio, cmd.sound->key, cmd.sound->name);
+            p->prepareTracks();
+            delete cmd.sound;
+        } else {
+            p->removeVariant(cmd.index);
+        }
+        p->resolveState();
+        break;
+    }
+    case CMD_CUE: {
+        Pad *p = find(cmd.letter);
+        if (!p) {
+            SDL_Log("Engine: no pad %c", cmd.letter);
+            break;
+        }
+        p->playCue(cmd.index, cmd.flow);
+        p->resolveState();
+        break;
+    }
+    case CMD_STOP_ALL: {
+        if (!pads) {
+            break;
+        }
+        for (auto &row : *pads) {
+            for (auto &p : row) {
+                p.request = STOP;
+                p.fulfillRequest(cmd.flow);
+                p.resolveState();
+            }
+        }
+        break;
+    }
+    }
+}
+
+PadStateRequest requestFromName(const std::string &name) {
+    std::string n;
+    for (auto c : name) {
+        if (c != '_' && c != '-') n.push_back(tolower(c));
+    }
+    if (n == "o" || n == "oneshot") return ONE_SHOT;
+    if (n == "s" || n == "stop") return STOP;
+    if (n == "p" || n == "pause") return PAUSE;
+    if (n == "r" || n == "resume") return RESUME;
+    if (n == "l" || n == "loop") return LOOP;
+    if (n == "h" || n == "held") return HELD;
+    return NONE;
+}
+
+const char *stateName(PadState state) {
+    switch (state) {
+    case IDLE:
+        return "IDLE";
+    case PLAYING:
+        return "PLAYING";
+    case PAUSED:
+        return "PAUSED";
+    case LOOPED:
+        return "LOOPED";
+    }
+    return "UNKNOWN";
+}
@@ -0,0 +1,160 @@
+#ifndef ENGINE_HPP
+#define ENGINE_HPP
+
+#include "preface.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Pad.hpp"
+#include "Queue.hpp"
+#include "Trace.hpp"
+
+enum CommandType {
+    CMD_NONE,
+    CMD_TRIGGER,  // letter + request
+    CMD_VOLUME,   // letter + value
+    CMD_STOP_ALL,
+    CMD_PRESS,    // letter + mods, request is looked up in the pad's table
+    CMD_RELEASE,  // letter
+    CMD_SOUND,    // letter + sound, nullptr audio unloads it and the variants
+    CMD_DSP,      // letter + dsp
+    CMD_VARIANT,  // letter + sound adds a variant, without a sound removes variant `index`
+    CMD_CUE,      // letter + index of the cue
+};
+
+enum CommandMods {
+    MOD_CTRL = 1,
+    MOD_SHIFT = 2,
+    MOD_ALT = 4,
+};
+
+// Decoded off the engine thread, owned by the command until applied
+struct LoadedSound {
+    SoundPad *pads;    // sound is dropped if another soundpad is attached meanwhile
+    MIX_Audio *audio;
+    std::string key;   // in the asset store, empty if the pad owns the audio
+    std::string name;
+};
+
+struct Command {
+    CommandType type = CMD_NONE;
+    char letter = 0;
+    PadStateRequest request = NONE;
+    float value = 0.f;
+    Uint8 mods = 0;
+    LoadedSound *sound = nullptr;
+    PadDsp dsp;
+    unsigned index = 0; // of a variant or a cue
+    Uint64 issued = 0; // SDL_GetTicksNS() when the command was received
+    Uint64 at = 0;     // SDL_GetTicksNS() when to apply, 0 is immediately
+    bool more = false; // next command belongs to the same batch
+    Uint32 flow = 0;   // trace flow, given on submit
+};
+
+struct EngineStats {
+    Uint64 commands = 0;
+    Uint64 totalLatencyNS = 0;
+    Uint64 maxLatencyNS = 0;
+    Uint64 dropped = 0;
+    size_t queueDepth = 0;     // right now
+    size_t maxQueueDepth = 0;  // most commands found waiting at once
+    Uint64 latencyBuckets[24] = {}; // by power of two of µs
+
+    // Upper bound of the latency in ns below which the given part of commands went
+    Uint64 latencyPercentileNS(double part) const;
+};
+
+/**
+ * The only thread which talks to the mixer about the attached soundpad:
+ * keys, mouse, control socket and OSC all send commands through a lock-free
+ * queue, so a slow frame or a blocked file dialog never delays a trigger.
+ * Scheduled commands are kept until their time and all commands due together
+ * are applied at once. While anything plays, pad states are polled here and
+ * published in Pad::state for the UI to draw.
+ * Pads are only touched while holding `padLock`; UI must hold it too
+ * while it reads names or edits the attached soundpad.
+ */
+class Engine {
+public:
+    std::mutex padLock;
+
+    Engine() = default;
+    ~Engine();
+
+    bool start();
+
+    void stop();
+
+    // Replaces the soundpad commands are applied to, nullptr detaches.
+    void attach(SoundPad *pads);
+
+    // Returns false if the queue is full and command was dropped
+    bool submit(const Command &cmd);
+
+    // Submits a batch; it will be applied at once, under a single lock.
+    bool submit(const Command *cmds, size_t count);
+
+    // Key or mouse button went down on the pad
+    bool press(char letter, bool ctrl, bool shift, bool alt);
+
+    bool release(char letter);
+
+    // Puts the decoded sound on the pad, or releases it if it can't be queued
+    bool assign(SoundPad *pads, char letter, MIX_Audio *audio, const std::string &key, const std::string &name);
+
+    // Same for another take of the pad's sound
+    bool addVariant(SoundPad *pads, char letter, MIX_Audio *audio, const std::string &key, const std::string &name);
+
+    // Index of the pad's cue for CMD_CUE, -1 if there is none
+    int findCue(char letter, const std::string &name);
+
+    // Waits until everything submitted so far is applied (or scheduled), for replays
+    void wait();
+
+    // Publishes pad states right away instead of on the next poll, for replays
+    void refresh();
+
+    // Profile switches require the main thread, so they are only recorded here.
+    void requestProfile(const std::string &name);
+
+    std::string takeProfileRequest();
+
+    EngineStats stats();
+
+    // Returns state of every pad as (letter, state) pairs, caller must hold padLock.
+    std::vector<std::pair<char, PadState> > snapshot();
+private:
+    SoundPad *pads = nullptr;
+    bool reattached = false;
+    std::thread worker;
+    BoundedQueue<Command> queue = BoundedQueue<Command>(4096);
+    SDL_Semaphore *wakeup = nullptr;
+    std::atomic<bool> running = false;
+    std::atomic<Uint64> dropped = 0;
+    std::atomic<Uint64> accepted = 0;
+    std::atomic<Uint64> handled = 0;
+    std::mutex profileLock;
+    std::string pendingProfile;
+    EngineStats counters;
+
+    void run();
+
+    bool submitSound(CommandType type, SoundPad *pads, char letter, MIX_Audio *audio, const std::string &key,
+                     const std::string &name);
+
+    // Details found on the way, like the request a key press means, go to the trace event
+    void apply(const Command &cmd, TraceEvent &trace);
+
+    // Publishes states of all pads, returns true if any of them is not idle
+    bool resolveAll();
+
+    Pad *find(char letter);
+};
+
+PadStateRequest requestFromName(const std::string &name);
+
+const char *stateName(PadState state);
+
+#endif // ENGINE_HPP
@@ -1,4 +1,6 @@
 #include "Font.hpp"
+#include <cstdlib>
+#include <filesystem>
 
 #ifdef __linux__
 
@@ -80,3 +82,24 @@ std::pair<std::string, std::string> getDefaultFontFiles() {
 }
 
 #endif
+
+static long long mtimeOf(const std::filesystem::path &path) {
+    std::error_code ec;
+    auto t = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : (long long) t.time_since_epoch().count();
+}
+
+std::string fontDiscoveryStamp(const std::pair<std::string, std::string> &files) {
+    std::string res;
+#ifdef __linux__
+    res += std::to_string(mtimeOf("/etc/fonts/fonts.conf")) + ":";
+    res += std::to_string(mtimeOf("/etc/fonts/conf.d")) + ":";
+    const char *xdg = getenv("XDG_CONFIG_HOME");
+    const char *home = getenv("HOME");
+    std::filesystem::path user = xdg && *xdg ? std::filesystem::path(xdg) : std::filesystem::path(home ? home : "") / ".config";
+    res += std::to_string(mtimeOf(user / "fontconfig" / "fonts.conf")) + ":";
+#endif
+    res += std::to_string(mtimeOf(files.first)) + ":";
+    res += std::to_string(mtimeOf(files.second));
+    return res;
+}
@@ -7,4 +7,8 @@
 
 std::pair<std::string, std::string> getDefaultFontFiles();
 
+// Modification times of what font discovery depends on (its config and the found files),
+// so a cached result is reused until one of them changes
+std::string fontDiscoveryStamp(const std::pair<std::string, std::string> &files);
+
 #endif // FONT_HPP
@@ -0,0 +1,253 @@
+#include "Jobs.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <chrono>
+
+// Index of the worker running on this thread, or none
+static thread_local int currentWorker = -1;
+
+JobSystem::~JobSystem() {
+    stop();
+}
+
+void JobSystem::start(unsigned threads) {
+    if (running) {
+        return;
+    }
+    if (threads == 0) {
+        threads = std::clamp(std::thread::hardware_concurrency(), 3u, 9u) - 1; // the main thread has its own work
+    }
+    for (unsigned i = 0; i < threads; ++i) {
+        workers.push_back(new Worker());
+    }
+    running = true;
+    for (unsigned i = 0; i < threads; ++i) {
+        workers[i]->thread = std::thread(&JobSystem::work, this, i);
+    }
+    SDL_Log("Started %u job threads", threads);
+}
+
+void JobSystem::stop() {
+    if (!running) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+        running = false;
+    }
+    wake.notify_all();
+    for (auto w : workers) {
+        w->thread.join();
+    }
+    for (auto w : workers) {
+        for (auto &q : w->queues) {
+            for (auto &job : q) {
+                ++counters[job.priority].cancelled;
+                --counters[job.priority].queued;
+                if (job.group) {
+                    --job.group->pending; // so nobody waits for it forever
+                }
+            }
+        }
+        delete w;
+    }
+    workers.clear();
+    std::lock_guard<std::mutex> guard(mainLock);
+    mainQueue.clear();
+}
+
+void JobSystem::run(JobPriority priority, std::function<void()> fn, const JobGroupPtr &group) {
+    ++counters[priority].submitted;
+    Job job = {std::move(fn), group, priority, 0, SDL_GetTicksNS()};
+    if (group) {
+        ++group->pending;
+    }
+    if (!running) {
+        execute(job);
+        return;
+    }
+    unsigned home = currentWorker >= 0 ? (unsigned) currentWorker : nextWorker++ % workers.size();
+    job.home = home;
+    {
+        std::lock_guard<std::mutex> guard(workers[home]->lock);
+        ++counters[priority].queued; // before anyone can take it
+        workers[home]->queues[priority].push_back(std::move(job));
+    }
+    {
+        std::lock_guard<std::mutex> guard(sleepLock);
+    }
+    wake.notify_one();
+}
+
+void JobSystem::wait(const JobGroupPtr &group) {
+    if (!group) {
+        return;
+    }
+    unsigned self = currentWorker >= 0 ? (unsigned) currentWorker : (unsigned) workers.size();
+    while (!group->done()) {
+        Job job;
+        if (take(self, job, group.get())) {
+            execute(job);
+        } else {
+            // the rest is running elsewhere
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    }
+}
+
+void JobSystem::onMain(std::function<void()> fn, const JobGroupPtr &group) {
+    std::lock_guard<std::mutex> guard(mainLock);
+    mainQueue.push_back({std::move(fn), group, JOB_NOW, 0, SDL_GetTicksNS()});
+}
+
+void JobSystem::drainMain(Uint64 budgetNS) {
+    auto start = SDL_GetTicksNS();
+    while (SDL_GetTicksNS() - start < budgetNS) {
+        Job job;
+        {
+            std::lock_guard<std::mutex> guard(mainLock);
+            if (mainQueue.empty()) {
+                return;
+            }
+            job = std::move(mainQueue.front());
+            mainQueue.pop_front();
+        }
+        if (!job.group || !job.group->cancelled()) {
+            job.fn();
+        }
+    }
+}
+
+JobStats JobSystem::stats(JobPriority priority) {
+    auto &c = counters[priority];
+    JobStats res;
+    res.submitted = c.submitted;
+    res.completed = c.completed;
+    res.cancelled = c.cancelled;
+    res.stolen = c.stolen;
+    res.totalWaitNS = c.totalWaitNS;
+    res.maxWaitNS = c.maxWaitNS;
+    res.totalRunNS = c.totalRunNS;
+    res.queued = c.queued;
+    return res;
+}
+
+void JobSystem::logStats() {
+    for (unsigned p = 0; p < JOB_PRIORITIES; ++p) {
+        auto st = stats((JobPriority) p);
+        if (st.submitted == 0) {
+            continue;
+        }
+        SDL_Log("Jobs %s: %llu done, %llu cancelled, %llu stolen; wait avg %.2f ms, max %.2f ms; run avg %.2f ms",
+            jobPriorityName((JobPriority) p), (unsigned long long) st.completed, (unsigned long long) st.cancelled,
+            (unsigned long long) st.stolen,
+            st.completed ? st.totalWaitNS / 1000000.0 / st.completed : 0.0, st.maxWaitNS / 1000000.0,
+            st.completed ? st.totalRunNS / 1000000.0 / st.completed : 0.0);
+    }
+}
+
+void JobSystem::work(unsigned index) {
+    currentWorker = (int) index;
+    tracer.nameThread("job " + std::to_string(index));
+    while (running) {
+        Job job;
+        if (take(index, job, nullptr)) {
+            execute(job);
+            continue;
+        }
+        std::unique_lock<std::mutex> guard(sleepLock);
+        wake.wait(guard, [this] { return !running || ready(); });
+    }
+    currentWorker = -1;
+}
+
+bool JobSystem::ready() {
+    unsigned n = (unsigned) workers.size();
+    return counters[JOB_NOW].queued > 0 || counters[JOB_PREFETCH].queued > 0
+        || (counters[JOB_BACKGROUND].queued > 0 && (n <= 1 || busyBackground + 1 < n));
+}
+
+bool JobSystem::take(unsigned index, Job &job, const JobGroup *only) {
+    unsigned n = (unsigned) workers.size();
+    for (unsigned p = 0; p < JOB_PRIORITIES; ++p) {
+        if (p == JOB_BACKGROUND && !only && n > 1 && busyBackground + 1 >= n) {
+            break; // one worker stays free for whatever comes next
+        }
+        // own queue from the front, others from the back
+        for (unsigned i = 0; i < n; ++i) {
+            unsigned victim = index < n ? (index + i) % n : i;
+            auto w = workers[victim];
+            std::lock_guard<std::mutex> guard(w->lock);
+            auto &q = w->queues[p];
+            if (q.empty()) {
+                continue;
+            }
+            if (only) {
+                auto it = std::find_if(q.begin(), q.end(), [only](const Job &j) { return j.group.get() == only; });
+                if (it == q.end()) {
+                    continue;
+                }
+                job = std::move(*it);
+                q.erase(it);
+            } else if (victim == index) {
+                job = std::move(q.front());
+                q.pop_front();
+            } else {
+                job = std::move(q.back());
+                q.pop_back();
+            }
+            --counters[p].queued;
+            if (job.home != index) {
+                ++counters[p].stolen;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::execute(Job &job) {
+    auto &c = counters[job.priority];
+    if (job.group && job.group->cancelled()) {
+        ++c.cancelled;
+    } else {
+        auto start = SDL_GetTicksNS();
+        auto waited = start - job.queued;
+        c.totalWaitNS += waited;
+        auto max = c.maxWaitNS.load();
+        while (waited > max && !c.maxWaitNS.compare_exchange_weak(max, waited));
+        bool background = job.priority == JOB_BACKGROUND;
+        if (background) {
+            ++busyBackground;
+        }
+        TraceSpan span("jobs", "job", 0, jobPriorityName(job.priority));
+        span.value("waitUS", (Uint32) std::min<Uint64>(waited / 1000, UINT32_MAX));
+        job.fn();
+        if (background) {
+            --busyBackground;
+            {
+                std::lock_guard<std::mutex> guard(sleepLock);
+            }
+            wake.notify_one(); // a worker may be holding off a background job
+        }
+        c.totalRunNS += SDL_GetTicksNS() - start;
+        ++c.completed;
+    }
+    job.fn = nullptr; // captures go before the group may be seen done
+    if (job.group) {
+        --job.group->pending;
+    }
+}
+
+const char *jobPriorityName(JobPriority priority) {
+    switch (priority) {
+    case JOB_NOW:
+        return "now";
+    case JOB_PREFETCH:
+        return "prefetch";
+    case JOB_BACKGROUND:
+        return "background";
+    default:
+        return "unknown";
+    }
+}
@@ -0,0 +1,147 @@
+#ifndef JOBS_HPP
+#define JOBS_HPP
+
+#include "preface.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum JobPriority {
+    JOB_NOW,        // somebody is waiting for it: profile switch, startup
+    JOB_PREFETCH,   // likely needed soon
+    JOB_BACKGROUND, // analysis, indexing; never takes the last free worker
+    JOB_PRIORITIES,
+};
+
+/**
+ * Jobs which are cancelled and waited for together, e.g. everything loading
+ * one profile. Cancelled jobs which haven't started yet are skipped, running
+ * ones may look at cancelled() to give up early.
+ */
+class JobGroup {
+public:
+    void cancel() {
+        stopped = true;
+    }
+
+    bool cancelled() const {
+        return stopped;
+    }
+
+    bool done() const {
+        return pending == 0;
+    }
+private:
+    friend class JobSystem;
+    std::atomic<bool> stopped = false;
+    std::atomic<unsigned> pending = 0;
+};
+
+typedef std::shared_ptr<JobGroup> JobGroupPtr;
+
+struct JobStats {
+    Uint64 submitted = 0;
+    Uint64 completed = 0;
+    Uint64 cancelled = 0;
+    Uint64 stolen = 0;       // run by another worker than the one it was queued on
+    Uint64 totalWaitNS = 0;  // queued until started
+    Uint64 maxWaitNS = 0;
+    Uint64 totalRunNS = 0;
+    size_t queued = 0;       // right now
+};
+
+/**
+ * Worker threads shared by everything heavy: decoding, pictures, scans, analysis.
+ * Every worker has a queue per priority; jobs submitted by a worker stay on its
+ * queue, others are spread round robin, and an idle worker steals from the
+ * others, always taking the most urgent job there is.
+ * Results which need the main thread (textures) go through onMain() and are
+ * applied once per frame.
+ */
+class JobSystem {
+public:
+    ~JobSystem();
+
+    // 0 picks by the number of cores
+    void start(unsigned threads = 0);
+
+    // Running jobs finish, queued ones are dropped
+    void stop();
+
+    unsigned threads() const {
+        return (unsigned) workers.size();
+    }
+
+    // Runs right away on the calling thread if the system is not started
+    void run(JobPriority priority, std::function<void()> job, const JobGroupPtr &group = nullptr);
+
+    // Runs the jobs of the group until none is left; the caller helps instead of blocking a worker
+    void wait(const JobGroupPtr &group);
+
+    // Queues for the main thread, skipped if the group is cancelled by then
+    void onMain(std::function<void()> job, const JobGroupPtr &group = nullptr);
+
+    // Main thread, once per frame; what doesn't fit the budget waits for the next one
+    void drainMain(Uint64 budgetNS);
+
+    JobStats stats(JobPriority priority);
+
+    void logStats();
+private:
+    struct Job {
+        std::function<void()> fn;
+        JobGroupPtr group;
+        JobPriority priority;
+        unsigned home;
+        Uint64 queued;
+    };
+
+    struct Worker {
+        std::mutex lock;
+        std::deque<Job> queues[JOB_PRIORITIES];
+        std::thread thread;
+    };
+
+    struct Counters {
+        std::atomic<Uint64> submitted = 0;
+        std::atomic<Uint64> completed = 0;
+        std::atomic<Uint64> cancelled = 0;
+        std::atomic<Uint64> stolen = 0;
+        std::atomic<Uint64> totalWaitNS = 0;
+        std::atomic<Uint64> maxWaitNS = 0;
+        std::atomic<Uint64> totalRunNS = 0;
+        std::atomic<size_t> queued = 0;
+    };
+
+    std::vector<Worker *> workers;
+    std::atomic<bool> running = false;
+    std::atomic<unsigned> nextWorker = 0;
+    std::atomic<unsigned> busyBackground = 0;
+    std::mutex sleepLock;
+    std::condition_variable wake;
+    Counters counters[JOB_PRIORITIES];
+
+    std::mutex mainLock;
+    std::deque<Job> mainQueue;
+
+    void work(unsigned index);
+
+    // There is a job some worker may take
+    bool ready();
+
+    // Most urgent job, own queue first; only jobs of the group if one is given
+    bool take(unsigned index, Job &job, const JobGroup *only);
+
+    void execute(Job &job);
+};
+
+inline JobSystem jobs;
+
+const char *jobPriorityName(JobPriority priority);
+
+#endif // JOBS_HPP
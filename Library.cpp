@@ -0,0 +1,522 @@
+#include "Library.hpp"
+#include "Jobs.hpp"
+#include "Trace.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+static const char *libraryHeader = "soundpad library 1";
+
+static std::shared_ptr<const std::vector<std::string> > keysOf(const std::vector<LibraryEntry> &entries) {
+    auto keys = std::make_shared<std::vector<std::string> >();
+    keys->reserve(entries.size());
+    for (auto &e : entries) {
+        keys->push_back(e.key);
+    }
+    return keys;
+}
+
+// Most of what SDL_mixer decodes, checked by extension to avoid opening every file
+static const char *audioExtensions[] = {
+    ".wav", ".flac", ".mp3", ".ogg", ".opus", ".aiff", ".aif", ".aifc", ".voc", ".au", ".snd",
+    ".wv", ".mid", ".midi", ".mod", ".xm", ".it", ".s3m", ".669", ".mtm", ".stm", ".ult",
+};
+
+static bool isAudio(const std::filesystem::path &path) {
+    auto ext = lowercase(path.extension().u8string());
+    for (auto e : audioExtensions) {
+        if (ext == e) return true;
+    }
+    return false;
+}
+
+static long long stampOf(const std::filesystem::path &path) {
+    std::error_code ec;
+    auto t = std::filesystem::last_write_time(path, ec);
+    return ec ? 0 : (long long) t.time_since_epoch().count();
+}
+
+static std::string parentOf(const std::string &rel) {
+    auto slash = rel.rfind('/');
+    return slash == std::string::npos ? std::string() : rel.substr(0, slash);
+}
+
+Library::Library(MIX_Mixer *mixer)
+    : mixer(mixer)
+{
+}
+
+Library::~Library() {
+    stop();
+    stopAudition();
+    if (track) {
+        MIX_DestroyTrack(track);
+    }
+}
+
+void Library::open(const std::filesystem::path &root, const std::filesystem::path &indexPath) {
+    stop();
+    rootPath = root;
+    this->indexPath = indexPath;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = false;
+        rescanRequested = true;
+        entries.clear();
+        keys.reset();
+        dirs.clear();
+        ++version;
+    }
+    worker = std::thread(&Library::run, this);
+}
+
+void Library::rescan() {
+    std::lock_guard<std::mutex> guard(lock);
+    rescanRequested = true;
+    wake.notify_all();
+}
+
+void Library::stop() {
+    if (!worker.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+        wake.notify_all();
+    }
+    worker.join();
+}
+
+size_t Library::size() {
+    std::lock_guard<std::mutex> guard(lock);
+    return entries.size();
+}
+
+void Library::run() {
+    tracer.nameThread("library");
+    read();
+    size_t cursor = 0;
+    Uint64 lastSave = SDL_GetTicks();
+    bool unsaved = false;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            if (toProbe == 0) {
+                wake.wait(guard, [this]() { return stopping || rescanRequested; });
+            }
+            if (stopping) {
+                break;
+            }
+            if (rescanRequested) {
+                rescanRequested = false;
+                guard.unlock();
+                scan();
+                cursor = 0;
+                unsaved = true;
+                continue;
+            }
+        }
+        if (probeNext(cursor)) {
+            unsaved = true;
+        } else {
+            toProbe = 0;
+        }
+        // probing a big library takes long, don't lose it all on a crash
+        if (unsaved && (toProbe == 0 || SDL_GetTicks() - lastSave > 30000)) {
+            save();
+            unsaved = false;
+            lastSave = SDL_GetTicks();
+        }
+    }
+    if (unsaved) {
+        save();
+    }
+}
+
+void Library::read() {
+    std::ifstream in(indexPath);
+    if (!in.is_open()) {
+        return;
+    }
+    std::string line;
+    if (!std::getline(in, line) || line != libraryHeader || !std::getline(in, line)) {
+        SDL_Log("Ignoring library index %s of unknown format", indexPath.u8string().c_str());
+        return;
+    }
+    if (std::filesystem::u8path(line) != rootPath) {
+        return; // some other root, start over
+    }
+    std::vector<LibraryEntry> loaded;
+    std::vector<Dir> loadedDirs;
+    std::string dir;
+    std::vector<std::string> fields;
+    while (std::getline(in, line)) {
+        fields.clear();
+        std::stringstream ls(line);
+        std::string field;
+        while (std::getline(ls, field, '\t')) {
+            fields.push_back(field);
+        }
+        if (fields.size() == 3 && fields[0] == "d") {
+            // d, mtime, dir relative to the root
+            dir = fields[2] == "." ? std::string() : fields[2];
+            loadedDirs.push_back({dir, std::strtoll(fields[1].c_str(), nullptr, 10)});
+        } else if (fields.size() == 8 && fields[0] == "f") {
+            // f, mtime, size, duration, channels, freq, loudness, name in the dir above
+            LibraryEntry e;
+            e.path = dir.empty() ? fields[7] : dir + "/" + fields[7];
+            e.key = lowercase(e.path);
+            e.mtime = std::strtoll(fields[1].c_str(), nullptr, 10);
+            e.size = std::strtoull(fields[2].c_str(), nullptr, 10);
+            e.duration = std::strtof(fields[3].c_str(), nullptr);
+            e.channels = std::strtol(fields[4].c_str(), nullptr, 10);
+            e.freq = std::strtol(fields[5].c_str(), nullptr, 10);
+            e.loudness = std::strtof(fields[6].c_str(), nullptr);
+            loaded.push_back(std::move(e));
+        }
+    }
+    std::sort(loaded.begin(), loaded.end(), [](const LibraryEntry &a, const LibraryEntry &b) { return a.path < b.path; });
+    auto loadedKeys = keysOf(loaded);
+    std::lock_guard<std::mutex> guard(lock);
+    entries.swap(loaded);
+    keys = loadedKeys;
+    dirs.swap(loadedDirs);
+    ++version;
+}
+
+bool Library::save() {
+    // entries are changed by this thread only, so reading them needs no lock
+    std::unordered_map<std::string, std::vector<const LibraryEntry *> > byDir;
+    for (auto &e : entries) {
+        byDir[parentOf(e.path)].push_back(&e);
+    }
+    std::string out;
+    out.reserve(entries.size() * 80);
+    out += libraryHeader;
+    out += "\n" + rootPath.u8string() + "\n";
+    char buf[128];
+    for (auto &d : dirs) {
+        out += "d\t" + std::to_string(d.mtime) + "\t" + (d.path.empty() ? "." : d.path) + "\n";
+        auto it = byDir.find(d.path);
+        if (it == byDir.end()) {
+            continue;
+        }
+        for (auto e : it->second) {
+            SDL_snprintf(buf, sizeof(buf), "f\t%lld\t%llu\t%.3f\t%d\t%d\t%.2f\t",
+                e->mtime, (unsigned long long) e->size, e->duration, e->channels, e->freq, e->loudness);
+            out += buf;
+            out += e->path.substr(d.path.empty() ? 0 : d.path.size() + 1);
+            out += "\n";
+        }
+    }
+    if (!writeFileAtomic(indexPath, out)) {
+        SDL_Log("Failed to save library index %s", indexPath.u8string().c_str());
+        return false;
+    }
+    return true;
+}
+
+void Library::scan() {
+    auto started = SDL_GetTicksNS();
+    walking = true;
+
+    // what the last walk found, per directory
+    struct Known {
+        long long mtime = 0;
+        std::vector<std::string> subdirs;
+        std::vector<const LibraryEntry *> files;
+    };
+    std::unordered_map<std::string, Known> known;
+    for (auto &d : dirs) {
+        known[d.path].mtime = d.mtime;
+        if (!d.path.empty()) {
+            known[parentOf(d.path)].subdirs.push_back(d.path);
+        }
+    }
+    for (auto &e : entries) {
+        known[parentOf(e.path)].files.push_back(&e);
+    }
+
+    struct Part {
+        std::vector<Dir> dirs;
+        std::vector<LibraryEntry> files;
+        unsigned listed = 0;
+    };
+    unsigned threads = std::clamp(jobs.threads(), 1u, 8u);
+    std::vector<Part> parts(threads);
+    std::mutex queueLock;
+    std::condition_variable queueChanged;
+    std::deque<std::string> queue(1, std::string());
+    unsigned busy = 0;
+
+    auto visit = [this, &known](const std::string &rel, Part &part, std::vector<std::string> &subdirs) {
+        auto dir = rel.empty() ? rootPath : rootPath / std::filesystem::u8path(rel);
+        auto mtime = stampOf(dir);
+        part.dirs.push_back({rel, mtime});
+        auto k = known.find(rel);
+        if (k != known.end() && mtime != 0 && k->second.mtime == mtime) {
+            // nothing was added, removed or renamed here
+            subdirs = k->second.subdirs;
+            for (auto e : k->second.files) {
+                part.files.push_back(*e);
+            }
+            return;
+        }
+        ++part.listed;
+        std::unordered_map<std::string, const LibraryEntry *> old;
+        if (k != known.end()) {
+            for (auto e : k->second.files) {
+                old.emplace(e->path, e);
+            }
+        }
+        std::error_code ec;
+        for (auto &p : std::filesystem::directory_iterator(dir, std::filesystem::directory_options::skip_permission_denied, ec)) {
+            auto name = p.path().filename().u8string();
+            auto sub = rel.empty() ? name : rel + "/" + name;
+            if (p.is_symlink(ec)) {
+                continue; // might loop
+            }
+            if (p.is_directory(ec)) {
+                subdirs.push_back(sub);
+                continue;
+            }
+            if (!p.is_regular_file(ec) || !isAudio(p.path())) {
+                continue;
+            }
+            auto size = p.file_size(ec);
+            auto fileTime = (long long) p.last_write_time(ec).time_since_epoch().count();
+            auto o = old.find(sub);
+            if (o != old.end() && o->second->size == size && o->second->mtime == fileTime) {
+                part.files.push_back(*o->second);
+                continue;
+            }
+            LibraryEntry e;
+            e.path = sub;
+            e.key = lowercase(sub);
+            e.size = size;
+            e.mtime = fileTime;
+            part.files.push_back(std::move(e));
+        }
+    };
+
+    auto walk = [&](Part &part) {
+        std::unique_lock<std::mutex> guard(queueLock);
+        for (;;) {
+            queueChanged.wait(guard, [&]() { return !queue.empty() || busy == 0; });
+            if (queue.empty()) {
+                return; // nobody is left to add more
+            }
+            auto rel = std::move(queue.front());
+            queue.pop_front();
+            ++busy;
+            guard.unlock();
+            bool quit;
+            {
+                std::lock_guard<std::mutex> stopGuard(lock);
+                quit = stopping;
+            }
+            std::vector<std::string> subdirs;
+            if (!quit) {
+                visit(rel, part, subdirs); // nothing new is queued once stopping
+            }
+            guard.lock();
+            for (auto &s : subdirs) {
+                queue.push_back(std::move(s));
+            }
+            --busy;
+            queueChanged.notify_all();
+        }
+    };
+    // helpers join whenever job workers are free, this thread walks meanwhile
+    auto walkers = std::make_shared<JobGroup>();
+    for (unsigned i = 1; i < threads; ++i) {
+        jobs.run(JOB_BACKGROUND, [&walk, &parts, i]() { walk(parts[i]); }, walkers);
+    }
+    walk(parts[0]);
+    jobs.wait(walkers);
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (stopping) {
+            walking = false;
+            return; // a partial walk would make the index forget the rest
+        }
+    }
+    std::vector<LibraryEntry> found;
+    std::vector<Dir> foundDirs;
+    unsigned listed = 0;
+    for (auto &part : parts) {
+        std::move(part.files.begin(), part.files.end(), std::back_inserter(found));
+        std::move(part.dirs.begin(), part.dirs.end(), std::back_inserter(foundDirs));
+        listed += part.listed;
+    }
+    std::sort(found.begin(), found.end(), [](const LibraryEntry &a, const LibraryEntry &b) { return a.path < b.path; });
+    std::sort(foundDirs.begin(), foundDirs.end(), [](const Dir &a, const Dir &b) { return a.path < b.path; });
+    size_t unknown = 0;
+    for (auto &e : found) {
+        if (e.freq == 0) ++unknown;
+    }
+    auto foundKeys = keysOf(found);
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        entries.swap(found);
+        keys = foundKeys;
+        dirs.swap(foundDirs);
+        ++version;
+    }
+    toProbe = unknown;
+    walking = false;
+    SDL_Log("Indexed %zu sounds in %zu dirs (%u listed) in %.1f ms, %zu to probe", entries.size(), dirs.size(), listed,
+        (SDL_GetTicksNS() - started) / 1000000.0, unknown);
+}
+
+bool Library::probeNext(size_t &cursor) {
+    while (cursor < entries.size() && entries[cursor].freq != 0) {
+        ++cursor;
+    }
+    if (cursor >= entries.size()) {
+        return false;
+    }
+    auto path = rootPath / std::filesystem::u8path(entries[cursor].path);
+    LibraryEntry probed;
+    probed.freq = -1;
+    auto decoder = MIX_CreateAudioDecoder(path.u8string().c_str(), 0);
+    SDL_AudioSpec spec;
+    if (decoder && MIX_GetAudioDecoderFormat(decoder, &spec) && spec.channels > 0 && spec.freq > 0) {
+        SDL_AudioSpec f32 = { SDL_AUDIO_F32, spec.channels, spec.freq };
+        float buf[16 * 1024];
+        Uint64 samples = 0;
+        double sum = 0;
+        int n;
+        while ((n = MIX_DecodeAudio(decoder, buf, sizeof(buf), &f32)) > 0) {
+            int count = n / sizeof(float);
+            for (int i = 0; i < count; ++i) {
+                sum += buf[i] * buf[i];
+            }
+            samples += count;
+        }
+        probed.channels = spec.channels;
+        probed.freq = spec.freq;
+        probed.duration = (double) samples / spec.channels / spec.freq;
+        probed.loudness = samples && sum > 0 ? 10 * std::log10(sum / samples) : -100.0f;
+    }
+    if (decoder) {
+        MIX_DestroyAudioDecoder(decoder);
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        auto &e = entries[cursor];
+        e.channels = probed.channels;
+        e.freq = probed.freq;
+        e.duration = probed.duration;
+        e.loudness = probed.loudness;
+    }
+    if (toProbe > 0) {
+        --toProbe;
+    }
+    ++cursor;
+    return true;
+}
+
+const std::vector<size_t> &Library::search(const std::string &query) {
+    std::shared_ptr<const std::vector<std::string> > snapshot;
+    Uint64 current;
+    {
+        // the worker keeps probing meanwhile, only a new list of paths is a new version
+        std::lock_guard<std::mutex> guard(lock);
+        snapshot = keys;
+        current = version;
+    }
+    if (current == lastVersion && query == lastQuery) {
+        return results;
+    }
+    // typing on only narrows what already matched
+    bool narrowing = current == lastVersion && !lastQuery.empty()
+        && query.size() > lastQuery.size() && query.compare(0, lastQuery.size(), lastQuery) == 0;
+    lastQuery = query;
+    lastVersion = current;
+    size_t count = snapshot ? snapshot->size() : 0;
+    if (query.empty()) {
+        results.resize(count);
+        std::iota(results.begin(), results.end(), 0);
+        return results;
+    }
+    auto q = lowercase(query);
+    std::vector<std::pair<int, size_t> > scored;
+    auto consider = [&](size_t i) {
+        int score = fuzzyScore((*snapshot)[i], q);
+        if (score >= 0) {
+            scored.emplace_back(score, i);
+        }
+    };
+    if (narrowing) {
+        for (auto i : results) consider(i);
+    } else {
+        for (size_t i = 0; i < count; ++i) consider(i);
+    }
+    // entries are in path order already, so ties stay sorted by path
+    std::stable_sort(scored.begin(), scored.end(), [](const std::pair<int, size_t> &a, const std::pair<int, size_t> &b) {
+        return a.first > b.first;
+    });
+    results.clear();
+    results.reserve(scored.size());
+    for (auto &s : scored) {
+        results.push_back(s.second);
+    }
+    return results;
+}
+
+bool Library::entry(size_t index, LibraryEntry &out) {
+    std::lock_guard<std::mutex> guard(lock);
+    if (version != lastVersion || index >= entries.size()) {
+        return false;
+    }
+    out = entries[index];
+    return true;
+}
+
+void Library::audition(const std::filesystem::path &path) {
+    stopAudition();
+    if (!track) {
+        track = MIX_CreateTrack(mixer);
+        if (!track) {
+            SDL_Log("Failed to create audition track: %s", SDL_GetError());
+            return;
+        }
+    }
+    auto wanted = auditions;
+    jobs.run(JOB_NOW, [this, path, wanted, mixer = mixer]() {
+        auto loaded = MIX_LoadAudio(mixer, path.u8string().c_str(), false); // streamed, starts at once
+        if (!loaded) {
+            SDL_Log("Failed to load %s: %s", path.u8string().c_str(), SDL_GetError());
+            return;
+        }
+        jobs.onMain([this, loaded, wanted]() {
+            if (wanted != auditions || !track) {
+                MIX_DestroyAudio(loaded); // another one was picked, or it was stopped
+                return;
+            }
+            audio = loaded;
+            MIX_SetTrackAudio(track, audio);
+            MIX_PlayTrack(track, 0);
+        });
+    });
+}
+
+void Library::stopAudition() {
+    ++auditions;
+    if (track) {
+        MIX_StopTrack(track, 0);
+        MIX_SetTrackAudio(track, nullptr);
+    }
+    if (audio) {
+        MIX_DestroyAudio(audio);
+        audio = nullptr;
+    }
+}
@@ -0,0 +1,113 @@
+#ifndef LIBRARY_HPP
+#define LIBRARY_HPP
+
+#include "preface.hpp"
+#include <atomic>
+#include <condition_variable>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct LibraryEntry {
+    std::string path;       // relative to the root, '/' separated
+    std::string key;        // lowercase path, what search looks at
+    long long mtime = 0;
+    Uint64 size = 0;
+    float duration = 0;     // seconds
+    float loudness = 0;     // RMS, dBFS
+    int channels = 0;
+    int freq = 0;           // 0 until probed, -1 if it can't be decoded
+};
+
+/**
+ * Index of the sounds under baseRoot for the library browser.
+ * A background worker walks the tree with several threads, then decodes every
+ * new sound once to learn its duration, format and loudness. The index is kept
+ * in a file, and a directory whose mtime didn't change is not listed again,
+ * so rescanning a big library costs a stat per directory.
+ * Everything but the worker is for the UI thread.
+ */
+class Library {
+public:
+    explicit Library(MIX_Mixer *mixer);
+    ~Library();
+
+    // Starts indexing the root, picking up what the index file already knows
+    void open(const std::filesystem::path &root, const std::filesystem::path &indexPath);
+
+    void rescan();
+
+    void stop();
+
+    const std::filesystem::path &root() const {
+        return rootPath;
+    }
+
+    bool scanning() const {
+        return walking;
+    }
+
+    size_t size();
+
+    size_t unprobed() const {
+        return toProbe;
+    }
+
+    // Indices of matching sounds, best first, or all in path order for an empty query.
+    // Cached until the query or the index changes.
+    const std::vector<size_t> &search(const std::string &query);
+
+    // Copies the entry out, false if the index changed under it
+    bool entry(size_t index, LibraryEntry &out);
+
+    // Plays the file on its own track, stopping the previous one; opened by a job
+    void audition(const std::filesystem::path &path);
+
+    void stopAudition();
+private:
+    struct Dir {
+        std::string path;
+        long long mtime;
+    };
+
+    MIX_Mixer *mixer;
+    MIX_Track *track = nullptr;
+    MIX_Audio *audio = nullptr;
+    unsigned auditions = 0; // the one still wanted, an older one opened late is dropped
+
+    std::filesystem::path rootPath;
+    std::filesystem::path indexPath;
+    std::thread worker;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    bool stopping = false;
+    bool rescanRequested = false;
+    std::vector<LibraryEntry> entries; // sorted by path, written by the worker only
+    std::shared_ptr<const std::vector<std::string> > keys; // of entries, replaced with them so search needs no lock
+    std::vector<Dir> dirs;
+    Uint64 version = 0;
+    std::atomic<bool> walking = false;
+    std::atomic<size_t> toProbe = 0;
+
+    // UI thread
+    std::string lastQuery;
+    Uint64 lastVersion = ~0ull;
+    std::vector<size_t> results;
+
+    void run();
+
+    void read();
+
+    bool save();
+
+    void scan();
+
+    // Decodes the sound once, false if there was nothing left to probe
+    bool probeNext(size_t &cursor);
+};
+
+#endif // LIBRARY_HPP
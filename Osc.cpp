@@ -0,0 +1,289 @@
+#include "Osc.hpp"
+#include <chrono>
+#include <cstring>
+
+OscServer::OscServer(Engine *engine, const std::string &host, int port)
+    : engine(engine)
+    , host(host)
+    , port(port)
+{
+}
+
+OscServer::~OscServer() {
+    stop();
+}
+
+static Uint32 readU32(const char *p) {
+    auto u = reinterpret_cast<const unsigned char *>(p);
+    return ((Uint32) u[0] << 24) | ((Uint32) u[1] << 16) | ((Uint32) u[2] << 8) | (Uint32) u[3];
+}
+
+static Uint64 readU64(const char *p) {
+    return ((Uint64) readU32(p) << 32) | readU32(p + 4);
+}
+
+// Reads a padded OSC string, returns nullptr if it is malformed
+static const char *readString(const char *data, size_t size, size_t &offset) {
+    if (offset >= size) {
+        return nullptr;
+    }
+    auto start = data + offset;
+    auto end = static_cast<const char *>(memchr(start, 0, size - offset));
+    if (!end) {
+        return nullptr;
+    }
+    offset += ((end - start) / 4 + 1) * 4;
+    return offset <= size ? start : nullptr;
+}
+
+// Converts NTP time tag to SDL_GetTicksNS() time, 0 means immediately
+static Uint64 ticksFromTimeTag(Uint64 tag, Uint64 received) {
+    if (tag <= 1) {
+        return 0;
+    }
+    const Uint64 ntpEpochOffset = 2208988800ull; // seconds from 1900 to 1970
+    auto unixNS = (Uint64) std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    auto nowNS = unixNS + ntpEpochOffset * 1000000000ull;
+    auto tagNS = (tag >> 32) * 1000000000ull + (((tag & 0xFFFFFFFFull) * 1000000000ull) >> 32);
+    if (tagNS <= nowNS) {
+        return received; // late, but still together with the rest of the bundle
+    }
+    auto delta = tagNS - nowNS;
+    if (delta > 60 * 1000000000ull) {
+        SDL_Log("OSC bundle is scheduled %llu s ahead, playing now", (unsigned long long) (delta / 1000000000ull));
+        return received;
+    }
+    return received + delta;
+}
+
+bool OscServer::decode(const char *data, size_t size, Uint64 received, std::vector<Command> &out, std::string &profile) {
+    if (size >= 8 && memcmp(data, "#bundle", 8) == 0) {
+        return decodeBundle(data, size, received, out, profile);
+    }
+    return decodeMessage(data, size, received, 0, out, profile);
+}
+
+bool OscServer::decodeBundle(const char *data, size_t size, Uint64 received, std::vector<Command> &out, std::string &profile) {
+    if (size < 16) {
+        return false;
+    }
+    auto at = ticksFromTimeTag(readU64(data + 8), received);
+    size_t offset = 16;
+    while (offset + 4 <= size) {
+        size_t elemSize = readU32(data + offset);
+        offset += 4;
+        if (elemSize > size - offset || elemSize % 4 != 0) {
+            return false;
+        }
+        auto elem = data + offset;
+        bool ok;
+        if (elemSize >= 8 && memcmp(elem, "#bundle", 8) == 0) {
+            ok = decodeBundle(elem, elemSize, received, out, profile);
+        } else {
+            ok = decodeMessage(elem, elemSize, received, at, out, profile);
+        }
+        if (!ok) {
+            return false;
+        }
+        offset += elemSize;
+    }
+    return offset == size;
+}
+
+bool OscServer::decodeMessage(const char *data, size_t size, Uint64 received, Uint64 at, std::vector<Command> &out,
+                              std::string &profile) {
+    size_t offset = 0;
+    auto address = readString(data, size, offset);
+    if (!address || address[0] != '/') {
+        return false;
+    }
+    // Types are optional in old senders
+    const char *types = offset < size ? readString(data, size, offset) : ",";
+    if (!types || types[0] != ',') {
+        return false;
+    }
+    // only the first argument matters here
+    bool hasArg = false;
+    float number = 0.f;
+    std::string text;
+    switch (types[1]) {
+    case 'i':
+        if (offset + 4 > size) return false;
+        number = (float) (Sint32) readU32(data + offset);
+        hasArg = true;
+        break;
+    case 'f': {
+        if (offset + 4 > size) return false;
+        Uint32 bits = readU32(data + offset);
+        memcpy(&number, &bits, sizeof(number));
+        hasArg = true;
+        break;
+    }
+    case 's': {
+        auto s = readString(data, size, offset);
+        if (!s) return false;
+        text = s;
+        hasArg = true;
+        break;
+    }
+    case 'T':
+        number = 1.f;
+        hasArg = true;
+        break;
+    case 'F':
+        number = 0.f;
+        hasArg = true;
+        break;
+    default:
+        break;
+    }
+
+    std::vector<std::string> parts;
+    for (auto p = address + 1; *p;) {
+        auto slash = strchr(p, '/');
+        if (!slash) {
+            parts.emplace_back(p);
+            break;
+        }
+        parts.emplace_back(p, slash - p);
+        p = slash + 1;
+    }
+
+    Command cmd;
+    cmd.issued = received;
+    cmd.at = at;
+    if (parts.size() == 2 && parts[0] == "group" && parts[1] == "stopall") {
+        if (hasArg && number == 0.f && text.empty()) return true;
+        cmd.type = CMD_STOP_ALL;
+        out.push_back(cmd);
+        return true;
+    }
+    if (parts.size() == 1 && parts[0] == "profile") {
+        if (text.empty()) return false;
+        profile = text; // the last one wins
+        return true;
+    }
+    if (parts.size() != 3 || parts[0] != "pad" || parts[1].size() != 1) {
+        SDL_Log("Unknown OSC address %s", address);
+        return false;
+    }
+    cmd.letter = parts[1][0];
+    if (parts[2] == "volume") {
+        if (!hasArg || !text.empty()) return false;
+        cmd.type = CMD_VOLUME;
+        cmd.value = number;
+        out.push_back(cmd);
+        return true;
+    }
+    cmd.request = requestFromName(parts[2]);
+    if (cmd.request == NONE) {
+        SDL_Log("Unknown OSC request %s", address);
+        return false;
+    }
+    if (hasArg && number == 0.f && text.empty()) {
+        // button release
+        if (cmd.request != HELD) return true;
+        cmd.request = STOP;
+    }
+    cmd.type = CMD_TRIGGER;
+    out.push_back(cmd);
+    return true;
+}
+
+#ifndef _WIN32
+
+#include <arpa/inet.h>
+#include <cerrno>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+bool OscServer::start() {
+    if (running) {
+        return true;
+    }
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    auto h = host == "localhost" ? std::string("127.0.0.1") : host;
+    if (inet_pton(AF_INET, h.c_str(), &addr.sin_addr) != 1) {
+        SDL_Log("Invalid OSC host %s", host.c_str());
+        return false;
+    }
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0) {
+        SDL_Log("Failed to create OSC socket: %s", strerror(errno));
+        return false;
+    }
+    if (bind(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+        SDL_Log("Failed to bind OSC socket to %s:%d: %s", h.c_str(), port, strerror(errno));
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    running = true;
+    worker = std::thread(&OscServer::run, this);
+    SDL_Log("OSC listening on %s:%d", h.c_str(), port);
+    return true;
+}
+
+void OscServer::stop() {
+    if (!running) {
+        return;
+    }
+    running = false;
+    if (worker.joinable()) {
+        worker.join();
+    }
+    close(fd);
+    fd = -1;
+}
+
+void OscServer::run() {
+    tracer.nameThread("osc");
+    std::vector<char> buf(65536);
+    std::vector<Command> cmds;
+    std::string profile;
+    pollfd pfd = {fd, POLLIN, 0};
+    while (running) {
+        // wake up periodically to notice stop()
+        if (poll(&pfd, 1, 200) <= 0) {
+            continue;
+        }
+        auto n = recv(fd, buf.data(), buf.size(), 0);
+        if (n <= 0) {
+            continue;
+        }
+        auto received = SDL_GetTicksNS();
+        cmds.clear();
+        profile.clear();
+        if (!decode(buf.data(), n, received, cmds, profile)) {
+            SDL_Log("Malformed OSC packet (%ld bytes)", (long) n);
+            continue;
+        }
+        if (!engine->submit(cmds.data(), cmds.size())) {
+            SDL_Log("Engine queue is full, OSC packet dropped");
+            continue;
+        }
+        if (!profile.empty()) {
+            engine->requestProfile(profile);
+        }
+    }
+}
+
+#else // winsock is not wired yet
+
+bool OscServer::start() {
+    SDL_Log("OSC input is not supported on this platform");
+    return false;
+}
+
+void OscServer::stop() {
+}
+
+void OscServer::run() {
+}
+
+#endif // _WIN32
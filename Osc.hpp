@@ -0,0 +1,48 @@
+#ifndef OSC_HPP
+#define OSC_HPP
+
+#include "preface.hpp"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Engine.hpp"
+
+/**
+ * OSC over UDP input. Understands
+ *   /pad/<pad>/<request> [i|f]  trigger, zero argument (button release) is ignored
+ *   /pad/<pad>/volume f         set pad volume
+ *   /group/stopall              stop everything
+ *   /profile s                  switch profile
+ * Bundle time tags are honored: everything in a bundle is applied together,
+ * at the tagged time if it is in the future. A profile switch is requested
+ * only once the whole packet is decoded and its commands are queued.
+ */
+class OscServer {
+public:
+    OscServer(Engine *engine, const std::string &host, int port);
+    ~OscServer();
+
+    bool start();
+
+    void stop();
+
+    // Decodes a packet into commands and the profile it asks for, if any; exposed for benchmarks
+    bool decode(const char *data, size_t size, Uint64 received, std::vector<Command> &out, std::string &profile);
+private:
+    Engine *engine;
+    std::string host;
+    int port;
+    int fd = -1;
+    std::atomic<bool> running = false;
+    std::thread worker;
+
+    void run();
+
+    bool decodeMessage(const char *data, size_t size, Uint64 received, Uint64 at, std::vector<Command> &out,
+                       std::string &profile);
+
+    bool decodeBundle(const char *data, size_t size, Uint64 received, std::vector<Command> &out, std::string &profile);
+};
+
+#endif // OSC_HPP
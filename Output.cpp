@@ -0,0 +1,193 @@
+#include "Output.hpp"
+#include "Jobs.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+
+MIX_Mixer *AudioOutput::createMixer() {
+    int frames = 0;
+    if (!SDL_GetAudioDeviceFormat(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, &frames)) {
+        SDL_Log("Failed to query the output format: %s", SDL_GetError());
+        spec = { SDL_AUDIO_F32, 2, 48000 };
+    }
+    // fixed for good, so loaded sounds stay in the mixer's format whatever device plays them
+    spec.format = SDL_AUDIO_F32;
+    mixer = MIX_CreateMixer(&spec);
+    if (!mixer) {
+        return nullptr;
+    }
+    stream = SDL_CreateAudioStream(&spec, &spec); // the device side follows the device once bound
+    if (!stream || !SDL_SetAudioStreamGetCallback(stream, pull, this)) {
+        SDL_Log("Failed to create the output stream: %s", SDL_GetError());
+        if (stream) {
+            SDL_DestroyAudioStream(stream);
+            stream = nullptr;
+        }
+        MIX_DestroyMixer(mixer);
+        mixer = nullptr;
+        return nullptr;
+    }
+    block.resize((size_t) std::max(frames, 1024) * spec.channels * sizeof(float) * 2);
+    return mixer;
+}
+
+void AudioOutput::select(const std::string &device) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        requested = device;
+    }
+    jobs.run(JOB_NOW, [this, device]() {
+        switchTo(device);
+    });
+}
+
+void AudioOutput::switchTo(const std::string &name) {
+    std::lock_guard<std::mutex> serial(switching);
+    SDL_AudioDeviceID chosen = 0;
+    if (!name.empty()) {
+        int count = 0;
+        if (auto ids = SDL_GetAudioPlaybackDevices(&count)) {
+            for (int i = 0; i < count && !chosen; ++i) {
+                auto n = SDL_GetAudioDeviceName(ids[i]);
+                if (n && name == n) {
+                    chosen = ids[i];
+                }
+            }
+            SDL_free(ids);
+        }
+        if (!chosen) {
+            SDL_Log("Output device %s is not there, using the default", name.c_str());
+        }
+    }
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (closed || !stream || (device && physical == chosen)) {
+            return;
+        }
+    }
+    // the slow part, while the old device still plays
+    auto start = SDL_GetTicksNS();
+    auto opened = SDL_OpenAudioDevice(chosen ? chosen : SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, nullptr);
+    if (!opened) {
+        SDL_Log("Failed to open output device: %s", SDL_GetError());
+        return;
+    }
+    auto openNS = SDL_GetTicksNS() - start;
+    std::lock_guard<std::mutex> guard(lock);
+    if (closed) {
+        SDL_CloseAudioDevice(opened);
+        return;
+    }
+    auto old = device;
+    if (old) {
+        switchedFrom = lastPull.load();
+        SDL_UnbindAudioStream(stream);
+    }
+    if (!SDL_BindAudioStream(opened, stream)) {
+        SDL_Log("Failed to play on the output device: %s", SDL_GetError());
+        SDL_CloseAudioDevice(opened);
+        if (old) {
+            SDL_BindAudioStream(old, stream);
+        }
+        return;
+    }
+    device = opened;
+    physical = chosen;
+    auto n = SDL_GetAudioDeviceName(opened);
+    playing = n ? n : "default";
+    if (old) {
+        SDL_CloseAudioDevice(old);
+    }
+    SDL_Log("Output on %s, opened in %.1f ms", playing.c_str(), openNS / 1000000.0);
+}
+
+void AudioOutput::close() {
+    std::lock_guard<std::mutex> serial(switching);
+    std::lock_guard<std::mutex> guard(lock);
+    closed = true;
+    if (stream) {
+        SDL_DestroyAudioStream(stream); // unbinds, the callback is done once it returns
+        stream = nullptr;
+    }
+    if (device) {
+        SDL_CloseAudioDevice(device);
+        device = 0;
+    }
+}
+
+void AudioOutput::handleEvent(const SDL_Event &event) {
+    if (event.adevice.recording) {
+        return;
+    }
+    std::string name;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (closed || !stream) {
+            return;
+        }
+        if (event.type == SDL_EVENT_AUDIO_DEVICE_REMOVED) {
+            // the default device is followed by SDL
+            if (!physical || (event.adevice.which != physical && event.adevice.which != device)) {
+                return;
+            }
+            SDL_Log("Output device %s is gone, using the default", playing.c_str());
+        } else if (event.type == SDL_EVENT_AUDIO_DEVICE_ADDED) {
+            auto n = SDL_GetAudioDeviceName(event.adevice.which);
+            if (physical || requested.empty() || !n || requested != n) {
+                return;
+            }
+            SDL_Log("Output device %s is back", n);
+            name = requested;
+        } else {
+            return;
+        }
+    }
+    jobs.run(JOB_NOW, [this, name]() {
+        switchTo(name);
+    });
+}
+
+std::vector<std::string> AudioOutput::devices() {
+    std::vector<std::string> res;
+    int count = 0;
+    if (auto ids = SDL_GetAudioPlaybackDevices(&count)) {
+        for (int i = 0; i < count; ++i) {
+            if (auto n = SDL_GetAudioDeviceName(ids[i])) {
+                res.emplace_back(n);
+            }
+        }
+        SDL_free(ids);
+    }
+    return res;
+}
+
+std::string AudioOutput::current() {
+    std::lock_guard<std::mutex> guard(lock);
+    return playing;
+}
+
+// Device thread, whenever the device wants more: mixes just as much
+void SDLCALL AudioOutput::pull(void *userdata, SDL_AudioStream *stream, int additional, int total) {
+    auto self = static_cast<AudioOutput *>(userdata);
+    auto now = SDL_GetTicksNS();
+    if (auto from = self->switchedFrom.exchange(0)) {
+        auto gap = now - from;
+        self->lastGap.store(gap, std::memory_order_relaxed);
+        if (gap > self->worstGap.load(std::memory_order_relaxed)) {
+            self->worstGap.store(gap, std::memory_order_relaxed);
+        }
+        tracer.span("audio", "device switch", from, now);
+    }
+    self->lastPull.store(now, std::memory_order_relaxed);
+    if (additional <= 0) {
+        return;
+    }
+    auto frameBytes = (int) (self->spec.channels * sizeof(float));
+    additional = (additional + frameBytes - 1) / frameBytes * frameBytes;
+    if ((size_t) additional > self->block.size()) {
+        self->block.resize(additional); // only when a device asks for more than any before
+    }
+    auto n = MIX_Generate(self->mixer, self->block.data(), additional);
+    if (n > 0) {
+        SDL_PutAudioStreamData(stream, self->block.data(), n);
+    }
+}
@@ -0,0 +1,73 @@
+#ifndef OUTPUT_HPP
+#define OUTPUT_HPP
+
+#include "preface.hpp"
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Plays the mixer on a device it isn't bound to: the mixer is made without one,
+ * and an audio stream pulls its blocks for whatever device is open. Switching
+ * opens the new device first and then moves the stream over, so sounds, tracks
+ * and loop positions stay where they are, and the mixer simply isn't pulled
+ * for the moment in between. Opened on the default device, SDL follows default
+ * changes by itself; a chosen device that goes away falls back to the default
+ * until it comes back.
+ */
+class AudioOutput {
+public:
+    // The mixer for the default device's rate and channels, in floats, not playing anywhere yet
+    MIX_Mixer *createMixer();
+
+    // Any thread: opens the device by name (empty for the default) as a job; sound goes on meanwhile
+    void select(const std::string &device);
+
+    // Stops pulling the mixer, before it is destroyed and before SDL quits
+    void close();
+
+    // UI thread: device added or removed events
+    void handleEvent(const SDL_Event &event);
+
+    // Names of the playback devices there are now
+    static std::vector<std::string> devices();
+
+    // Name of the device playing, empty before one is open
+    std::string current();
+
+    // From the last block pulled on the old device to the first on the new one, of the last switch
+    Uint64 lastGapNS() const {
+        return lastGap.load(std::memory_order_relaxed);
+    }
+
+    Uint64 worstGapNS() const {
+        return worstGap.load(std::memory_order_relaxed);
+    }
+private:
+    MIX_Mixer *mixer = nullptr;
+    SDL_AudioSpec spec = {};
+    SDL_AudioStream *stream = nullptr;
+
+    std::mutex switching; // one switch at a time
+    std::mutex lock;      // the fields below
+    SDL_AudioDeviceID device = 0;   // logical device opened here
+    SDL_AudioDeviceID physical = 0; // the chosen device, 0 on the default
+    std::string requested;          // what the user chose, kept while it is away
+    std::string playing;
+    bool closed = false;
+
+    std::atomic<Uint64> lastPull = 0;
+    std::atomic<Uint64> switchedFrom = 0; // last pull before a switch, until the next one
+    std::atomic<Uint64> lastGap = 0;
+    std::atomic<Uint64> worstGap = 0;
+    std::vector<Uint8> block; // audio thread only
+
+    void switchTo(const std::string &name);
+
+    static void SDLCALL pull(void *userdata, SDL_AudioStream *stream, int additional, int total);
+};
+
+inline AudioOutput audioOutput;
+
+#endif // OUTPUT_HPP
@@ -0,0 +1,350 @@
+#include "Pack.hpp"
+#include "Utils.hpp"
+#include <cstring>
+#include <fstream>
+
+static const char packMagic[8] = {'S', 'P', 'A', 'C', 'K', '\r', '\n', '\x1a'};
+static const size_t headerSize = 32;
+static const size_t tocEntrySize = 40; // without name
+
+static Uint32 get32(const Uint8 *p) {
+    Uint32 v;
+    memcpy(&v, p, sizeof(v));
+    return SDL_Swap32LE(v);
+}
+
+static Uint64 get64(const Uint8 *p) {
+    Uint64 v;
+    memcpy(&v, p, sizeof(v));
+    return SDL_Swap64LE(v);
+}
+
+static void put32(std::ostream &out, Uint32 v) {
+    v = SDL_Swap32LE(v);
+    out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+static void put64(std::ostream &out, Uint64 v) {
+    v = SDL_Swap64LE(v);
+    out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+static Uint64 alignUp(Uint64 v, Uint64 align) {
+    return (v + align - 1) / align * align;
+}
+
+Pack *Pack::open(const std::filesystem::path &path) {
+    auto pack = new Pack();
+    if (!pack->map(path)) {
+        delete pack;
+        return nullptr;
+    }
+    if (!pack->parse()) {
+        SDL_Log("Malformed bundle %s", path.u8string().c_str());
+        delete pack;
+        return nullptr;
+    }
+    return pack;
+}
+
+bool Pack::parse() {
+    if (size < headerSize || memcmp(base, packMagic, sizeof(packMagic)) != 0) {
+        return false;
+    }
+    auto version = get32(base + 8);
+    if (version != PACK_VERSION) {
+        SDL_Log("Unsupported bundle version %u", version);
+        return false;
+    }
+    auto count = get32(base + 12);
+    auto tocOffset = get64(base + 16);
+    auto tocSize = get64(base + 24);
+    // every entry takes at least tocEntrySize, so the count can't ask for more than the file holds
+    if (tocOffset > size || tocSize > size - tocOffset || count > tocSize / tocEntrySize) {
+        return false;
+    }
+    toc.reserve(count);
+    const Uint8 *p = base + tocOffset;
+    const Uint8 *end = p + tocSize;
+    for (Uint32 i = 0; i < count; ++i) {
+        if ((Uint64) (end - p) < tocEntrySize) {
+            return false;
+        }
+        PackEntry e;
+        auto kind = get32(p);
+        if (kind > PACK_PCM) {
+            return false;
+        }
+        e.kind = (PackEntryKind) kind;
+        auto nameLen = get32(p + 4);
+        e.offset = get64(p + 8);
+        e.size = get64(p + 16);
+        e.spec.format = (SDL_AudioFormat) get32(p + 24);
+        e.spec.channels = get32(p + 28);
+        e.spec.freq = get32(p + 32);
+        p += tocEntrySize;
+        if ((Uint64) (end - p) < alignUp(nameLen, 8) || e.offset > size || e.size > size - e.offset) {
+            return false;
+        }
+        e.name.assign(reinterpret_cast<const char *>(p), nameLen);
+        p += alignUp(nameLen, 8);
+        toc.push_back(std::move(e));
+    }
+    return true;
+}
+
+const PackEntry *Pack::find(PackEntryKind kind, const std::string &name) const {
+    // a profile has a few dozens of assets at most
+    for (auto &e : toc) {
+        if (e.kind == kind && e.name == name) {
+            return &e;
+        }
+    }
+    return nullptr;
+}
+
+const PackEntry *Pack::findSound(const std::string &name) const {
+    auto e = find(PACK_PCM, name);
+    return e ? e : find(PACK_SOUND, name);
+}
+
+SDL_IOStream *Pack::stream(const PackEntry &entry) const {
+    return SDL_IOFromConstMem(data(entry), entry.size);
+}
+
+std::string_view Pack::config() const {
+    auto e = find(PACK_CONFIG, "");
+    if (!e) {
+        return std::string_view();
+    }
+    return std::string_view(reinterpret_cast<const char *>(data(*e)), e->size);
+}
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+bool Pack::map(const std::filesystem::path &path) {
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        SDL_Log("Failed to open bundle %s: error %lu", path.u8string().c_str(), GetLastError());
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+        SDL_Log("Failed to get size of bundle %s", path.u8string().c_str());
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        SDL_Log("Failed to map bundle %s: error %lu", path.u8string().c_str(), GetLastError());
+        CloseHandle(file);
+        return false;
+    }
+    base = static_cast<const Uint8 *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!base) {
+        SDL_Log("Failed to map view of bundle %s: error %lu", path.u8string().c_str(), GetLastError());
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+    size = fileSize.QuadPart;
+    fileHandle = file;
+    mappingHandle = mapping;
+    return true;
+}
+
+Pack::~Pack() {
+    if (base) {
+        UnmapViewOfFile(base);
+    }
+    if (mappingHandle) {
+        CloseHandle(mappingHandle);
+    }
+    if (fileHandle) {
+        CloseHandle(fileHandle);
+    }
+}
+
+#else // posix
+
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+bool Pack::map(const std::filesystem::path &path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        SDL_Log("Failed to open bundle %s: %s", path.u8string().c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        SDL_Log("Failed to get size of bundle %s", path.u8string().c_str());
+        close(fd);
+        return false;
+    }
+    void *m = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // mapping keeps the file
+    if (m == MAP_FAILED) {
+        SDL_Log("Failed to map bundle %s: %s", path.u8string().c_str(), strerror(errno));
+        return false;
+    }
+    base = static_cast<const Uint8 *>(m);
+    size = st.st_size;
+    return true;
+}
+
+Pack::~Pack() {
+    if (base) {
+        munmap(const_cast<Uint8 *>(base), size);
+    }
+}
+
+#endif // _WIN32
+
+void PackWriter::addMemory(PackEntryKind kind, const std::string &name, const void *data, size_t size, const SDL_AudioSpec *spec) {
+    Source s;
+    s.entry.kind = kind;
+    s.entry.name = name;
+    s.entry.size = size;
+    if (spec) s.entry.spec = *spec;
+    s.data = data;
+    sources.push_back(std::move(s));
+}
+
+void PackWriter::addFile(PackEntryKind kind, const std::string &name, const std::filesystem::path &path) {
+    Source s;
+    s.entry.kind = kind;
+    s.entry.name = name;
+    s.entry.size = std::filesystem::file_size(path);
+    s.file = path;
+    sources.push_back(std::move(s));
+}
+
+void PackWriter::addBuffer(PackEntryKind kind, const std::string &name, std::vector<Uint8> &&data, const SDL_AudioSpec *spec) {
+    Source s;
+    s.entry.kind = kind;
+    s.entry.name = name;
+    s.entry.size = data.size();
+    if (spec) s.entry.spec = *spec;
+    s.buffer = buffers.size();
+    buffers.push_back(std::move(data));
+    sources.push_back(std::move(s));
+}
+
+bool PackWriter::has(const std::string &name) const {
+    for (auto &s : sources) {
+        if (s.entry.name == name && s.entry.kind != PACK_CONFIG) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PackWriter::finish(const std::filesystem::path &path) {
+    // lay out first, so toc can be written before blobs
+    Uint64 tocSize = 0;
+    for (auto &s : sources) {
+        tocSize += tocEntrySize + alignUp(s.entry.name.size(), 8);
+    }
+    Uint64 offset = alignUp(headerSize + tocSize, PACK_ALIGN);
+    for (auto &s : sources) {
+        s.entry.offset = offset;
+        offset = alignUp(offset + s.entry.size, PACK_ALIGN);
+    }
+
+    auto tmp = path;
+    tmp += ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        SDL_Log("Failed to open %s for writing", tmp.u8string().c_str());
+        return false;
+    }
+    out.write(packMagic, sizeof(packMagic));
+    put32(out, PACK_VERSION);
+    put32(out, sources.size());
+    put64(out, headerSize);
+    put64(out, tocSize);
+    const char zeros[PACK_ALIGN] = {};
+    for (auto &s : sources) {
+        auto &e = s.entry;
+        put32(out, e.kind);
+        put32(out, e.name.size());
+        put64(out, e.offset);
+        put64(out, e.size);
+        put32(out, e.spec.format);
+        put32(out, e.spec.channels);
+        put32(out, e.spec.freq);
+        put32(out, 0);
+        out.write(e.name.data(), e.name.size());
+        out.write(zeros, alignUp(e.name.size(), 8) - e.name.size());
+    }
+    std::vector<char> chunk;
+    for (auto &s : sources) {
+        auto pos = (Uint64) out.tellp();
+        out.write(zeros, s.entry.offset - pos);
+        if (s.buffer != SIZE_MAX) {
+            out.write(reinterpret_cast<const char *>(buffers[s.buffer].data()), s.entry.size);
+        } else if (s.data) {
+            out.write(static_cast<const char *>(s.data), s.entry.size);
+        } else {
+            std::ifstream in(s.file, std::ios::binary);
+            chunk.resize(1 << 20);
+            Uint64 left = s.entry.size;
+            while (in && left > 0) {
+                in.read(chunk.data(), std::min<Uint64>(left, chunk.size()));
+                out.write(chunk.data(), in.gcount());
+                left -= in.gcount();
+            }
+            if (left != 0) {
+                SDL_Log("Failed to read %s into bundle", s.file.u8string().c_str());
+                out.close();
+                std::filesystem::remove(tmp);
+                return false;
+            }
+        }
+    }
+    out.close();
+    if (out.fail() || !syncFile(tmp)) {
+        SDL_Log("Failed to write bundle %s", tmp.u8string().c_str());
+        std::filesystem::remove(tmp);
+        return false;
+    }
+    std::error_code ec;
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        SDL_Log("Failed to replace bundle %s: %s", path.u8string().c_str(), ec.message().c_str());
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
+
+bool decodeToPCM(SDL_IOStream *io, std::vector<Uint8> &out, SDL_AudioSpec &spec) {
+    auto decoder = MIX_CreateAudioDecoder_IO(io, true, 0);
+    if (!decoder) {
+        SDL_Log("Failed to create decoder: %s", SDL_GetError());
+        return false;
+    }
+    bool ok = MIX_GetAudioDecoderFormat(decoder, &spec);
+    out.clear();
+    Uint8 buf[64 * 1024];
+    while (ok) {
+        int n = MIX_DecodeAudio(decoder, buf, sizeof(buf), &spec);
+        if (n < 0) {
+            SDL_Log("Failed to decode: %s", SDL_GetError());
+            ok = false;
+        } else if (n == 0) {
+            break;
+        } else {
+            out.insert(out.end(), buf, buf + n);
+        }
+    }
+    MIX_DestroyAudioDecoder(decoder);
+    return ok;
+}
@@ -0,0 +1,112 @@
+#ifndef PACK_HPP
+#define PACK_HPP
+
+#include "preface.hpp"
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Single file profile bundle (.spack), little endian:
+ *   header   "SPACK\r\n\x1a", u32 version, u32 entry count, u64 toc offset, u64 toc size
+ *   toc      per entry: u32 kind, u32 name length, u64 offset, u64 size,
+ *            u32 format, u32 channels, u32 freq, u32 reserved, name padded to 8 bytes
+ *   blobs    each one starts at a PACK_ALIGN boundary
+ * The profile text (same as .cfg) is the PACK_CONFIG entry, assets are looked up
+ * by the names it mentions. PCM entries are decoded sound in the stored spec.
+ */
+enum PackEntryKind {
+    PACK_CONFIG,
+    PACK_SOUND,
+    PACK_PICTURE,
+    PACK_PCM,
+};
+
+const Uint32 PACK_VERSION = 1;
+const Uint64 PACK_ALIGN = 64;
+
+struct PackEntry {
+    PackEntryKind kind;
+    std::string name;
+    Uint64 offset = 0;
+    Uint64 size = 0;
+    SDL_AudioSpec spec = {}; // PCM only
+};
+
+/**
+ * Read-only bundle, memory-mapped for its whole lifetime; assets are handed
+ * out as pointers into the mapping, so anything using them must be gone first.
+ */
+class Pack {
+public:
+    ~Pack();
+
+    // Returns nullptr if the file is missing or malformed
+    static Pack *open(const std::filesystem::path &path);
+
+    const PackEntry *find(PackEntryKind kind, const std::string &name) const;
+
+    // Sound is either compressed or PCM, whichever is stored
+    const PackEntry *findSound(const std::string &name) const;
+
+    const Uint8 *data(const PackEntry &entry) const {
+        return base + entry.offset;
+    }
+
+    // Stream over the entry without copying, closing it doesn't touch the mapping
+    SDL_IOStream *stream(const PackEntry &entry) const;
+
+    std::string_view config() const;
+
+    const std::vector<PackEntry> &entries() const {
+        return toc;
+    }
+private:
+    const Uint8 *base = nullptr;
+    Uint64 size = 0;
+    std::vector<PackEntry> toc;
+#ifdef _WIN32
+    void *fileHandle = nullptr;
+    void *mappingHandle = nullptr;
+#endif
+
+    Pack() = default;
+
+    bool map(const std::filesystem::path &path);
+
+    bool parse();
+};
+
+/**
+ * Collects entries and writes them in one go. Data is not copied:
+ * memory entries must stay valid and file entries must exist until finish().
+ */
+class PackWriter {
+public:
+    void addMemory(PackEntryKind kind, const std::string &name, const void *data, size_t size, const SDL_AudioSpec *spec = nullptr);
+
+    void addFile(PackEntryKind kind, const std::string &name, const std::filesystem::path &path);
+
+    // Takes ownership of the buffer, handy for freshly decoded PCM
+    void addBuffer(PackEntryKind kind, const std::string &name, std::vector<Uint8> &&data, const SDL_AudioSpec *spec = nullptr);
+
+    bool has(const std::string &name) const;
+
+    // Writes to a temporary file next to the target and renames it over
+    bool finish(const std::filesystem::path &path);
+private:
+    struct Source {
+        PackEntry entry;
+        const void *data = nullptr;
+        std::filesystem::path file;
+        size_t buffer = SIZE_MAX;
+    };
+    std::vector<Source> sources;
+    std::vector<std::vector<Uint8> > buffers;
+};
+
+// Decodes any supported sound to PCM in its native spec
+bool decodeToPCM(SDL_IOStream *io, std::vector<Uint8> &out, SDL_AudioSpec &spec);
+
+#endif // PACK_HPP
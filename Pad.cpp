@@ -1,6 +1,19 @@
 #include "Pad.hpp"
+#include "AssetStore.hpp"
+#include "Pack.hpp"
+#include "Resample.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <cctype>
 
 SDLLoopProp Pad::loop = SDLLoopProp();
+PadStateListener Pad::stateListener = nullptr;
+void *Pad::stateListenerData = nullptr;
+
+void Pad::setStateListener(PadStateListener listener, void *userdata) {
+    stateListener = listener;
+    stateListenerData = userdata;
+}
 
 void Pad::unloadPicture() {
     if (picture) {
@@ -8,13 +21,56 @@ void Pad::unloadPicture() {
         picture = nullptr;
         picturePath = "";
     }
+    if (pendingPicture) {
+        SDL_DestroySurface(pendingPicture);
+        pendingPicture = nullptr;
+        picturePath = "";
+    }
+    pictureKey = "";
+    countPicture(0, 0, 0, 0);
+}
+
+void Pad::countPicture(int w, int h, size_t bytes, Uint64 loadNS) {
+    resources.pictureWidth = w;
+    resources.pictureHeight = h;
+    resources.pictureBytes = bytes;
+    resources.pictureLoadNS = loadNS;
+}
+
+static std::string fileName(const std::string &path) {
+    auto lastSlash = path.find_last_of("/\\");
+    return path.substr(lastSlash == std::string::npos ? 0 : lastSlash + 1);
 }
 
 bool Pad::loadPicture(const std::string &path) {
+    SDL_IOStream *io = SDL_IOFromFile(path.c_str(), "rb");
+    if (!io) {
+        SDL_Log("Failed to open picture on %c: %s", letter, SDL_GetError());
+        return false;
+    }
+    return loadPicture(io, fileName(path));
+}
+
+bool Pad::loadPicture(SDL_IOStream *io, const std::string &name) {
     unloadPicture();
-    picture = IMG_LoadTexture(renderer, path.c_str());
+    TraceSpan span("io", "picture", letter);
+    auto start = SDL_GetTicksNS();
+    if (!SDL_IsMainThread()) {
+        // renderer belongs to the main thread, texture is made on first render
+        pendingPicture = IMG_Load_IO(io, true);
+        if (!pendingPicture) {
+            SDL_Log("Failed to load picture surface on %c: %s", letter, SDL_GetError());
+            return false;
+        }
+        picturePath = name;
+        countPicture(pendingPicture->w, pendingPicture->h, (size_t) pendingPicture->pitch * pendingPicture->h,
+            SDL_GetTicksNS() - start);
+        return true;
+    }
+    picture = IMG_LoadTexture_IO(renderer, io, false);
     if (!picture) {
         SDL_Log("Failed to load picture on %c: %s", letter, SDL_GetError());
+        SDL_CloseIO(io);
         return false;
     }
 
@@ -25,7 +81,9 @@ bool Pad::loadPicture(const std::string &path) {
         picture = nullptr;
 
         // slow reload via surface
-        SDL_Surface *surface = IMG_Load(path.c_str());
+        SDL_Surface *surface = SDL_SeekIO(io, 0, SDL_IO_SEEK_SET) == 0 ? IMG_Load_IO(io, false) : nullptr;
+        SDL_CloseIO(io);
+        io = nullptr;
         if (!surface) {
             SDL_Log("Failed to load picture surface on %c: %s", letter, SDL_GetError());
             return false;
@@ -53,18 +111,120 @@ bool Pad::loadPicture(const std::string &path) {
             return false;
         }
     }
-    auto lastSlash = path.find_last_of("/\\");
-    picturePath = path.substr(lastSlash == std::string::npos ? 0 : lastSlash + 1);
+    if (io) {
+        SDL_CloseIO(io);
+    }
+    picturePath = name;
+    countPicture(picture->w, picture->h, (size_t) picture->w * picture->h * 4, SDL_GetTicksNS() - start);
+    return true;
+}
+
+bool Pad::loadStoredPicture(const std::string &key, const std::string &name) {
+    SDL_IOStream *io = SDL_IOFromFile(assetStore.path(key).u8string().c_str(), "rb");
+    if (!io) {
+        SDL_Log("Failed to open stored picture on %c: %s", letter, SDL_GetError());
+        return false;
+    }
+    if (!loadPicture(io, name)) {
+        return false;
+    }
+    pictureKey = key;
+    return true;
+}
+
+void Pad::adoptPicture(SDL_Surface *surface, const std::string &key, const std::string &name, Uint64 loadNS) {
+    unloadPicture();
+    pendingPicture = surface;
+    picturePath = name;
+    pictureKey = key;
+    countPicture(surface->w, surface->h, (size_t) surface->pitch * surface->h, loadNS);
+}
+
+bool Pad::uploadPicture() {
+    TraceSpan span("io", "upload", letter);
+    auto start = SDL_GetTicksNS();
+    picture = SDL_CreateTextureFromSurface(renderer, pendingPicture);
+    if (picture && !SDL_SetTextureBlendMode(picture, SDL_BLENDMODE_BLEND)) {
+        SDL_DestroyTexture(picture);
+        picture = nullptr;
+        SDL_Surface *converted = SDL_ConvertSurface(pendingPicture, SDL_PIXELFORMAT_RGBA8888);
+        if (converted) {
+            picture = SDL_CreateTextureFromSurface(renderer, converted);
+            SDL_DestroySurface(converted);
+        }
+        if (picture && !SDL_SetTextureBlendMode(picture, SDL_BLENDMODE_BLEND)) {
+            SDL_DestroyTexture(picture);
+            picture = nullptr;
+        }
+    }
+    SDL_DestroySurface(pendingPicture);
+    pendingPicture = nullptr;
+    if (!picture) {
+        SDL_Log("Failed to create texture on %c: %s", letter, SDL_GetError());
+        picturePath = "";
+        countPicture(0, 0, 0, 0);
+        return false;
+    }
+    countPicture(picture->w, picture->h, (size_t) picture->w * picture->h * 4,
+        resources.pictureLoadNS + SDL_GetTicksNS() - start);
     return true;
 }
 
 bool Pad::loadSound(const std::string &path) {
     unloadSound();
-    audio = MIX_LoadAudio(mixer, path.c_str(), true);
+    TraceSpan span("io", "decode", letter);
+    auto start = SDL_GetTicksNS();
+    auto loaded = loadForMixer(mixer, path.c_str(), storage);
+    return setAudio(loaded, fileName(path), SDL_GetTicksNS() - start);
+}
+
+bool Pad::loadSound(SDL_IOStream *io, const std::string &name) {
+    unloadSound();
+    TraceSpan span("io", "decode", letter);
+    auto start = SDL_GetTicksNS();
+    auto loaded = loadForMixer(mixer, io, true, storage);
+    return setAudio(loaded, name, SDL_GetTicksNS() - start);
+}
+
+bool Pad::loadSound(const void *pcm, size_t size, const SDL_AudioSpec &spec, const std::string &name) {
+    unloadSound();
+    return setAudio(MIX_LoadRawAudioNoCopy(mixer, pcm, size, &spec, false), name, 0, true);
+}
+
+bool Pad::loadStoredSound(const std::string &key, const std::string &name) {
+    unloadSound();
+    return adoptSound(assetStore.acquireAudio(key, mixer, storage), key, name);
+}
+
+bool Pad::adoptSound(MIX_Audio *loaded, const std::string &key, const std::string &name) {
+    unloadSound();
+    if (!setAudio(loaded, name, key.empty() ? 0 : assetStore.decodeTime(key, loaded))) {
+        return false;
+    }
+    soundKey = key;
+    return true;
+}
+
+bool Pad::setAudio(MIX_Audio *loaded, const std::string &name, Uint64 loadNS, bool mapped) {
+    audio = loaded;
     if (audio) {
-        auto lastSlash = path.find_last_of("/\\");
-        name = path.substr(lastSlash == std::string::npos ? 0 : lastSlash + 1);
-        for (auto t : track) {
+        this->name = name;
+        SDL_AudioSpec spec;
+        if (MIX_GetAudioFormat(audio, &spec)) {
+            resources.audioFrames = std::max<Sint64>(MIX_GetAudioDuration(audio), 0);
+            resources.audioChannels = spec.channels;
+            resources.audioRate = spec.freq;
+            resources.audioFormat = spec.format;
+            resources.audioBytes = decodedBytes(audio, mapped);
+        }
+        resources.audioMapped = mapped;
+        resources.audioEncoded = isEncoded(audio);
+        resources.soundLoadNS = loadNS;
+        for (size_t i = 0; i < track.size(); ++i) {
+            if (trackVariant[i] != 0) {
+                continue; // variants keep playing
+            }
+            auto t = track[i];
             if (!MIX_StopTrack(t, 0)) {
                 SDL_Log("Failed to stop track on %c: %s", letter, SDL_GetError());
             }
@@ -76,57 +236,204 @@ bool Pad::loadSound(const std::string &path) {
     return audio != nullptr;
 }
 
-bool Pad::processInput() {
-    bool lmbDown = ImGui::IsMouseDown(0);
-    bool rmb = ImGui::IsMouseClicked(1);
-    bool hovered = ImGui::IsItemHovered();
-    bool lmbReleased = ImGui::IsMouseReleased(0);
-    bool active = ImGui::IsKeyDown(key) || (lmbDown && hovered);
-    bool activate = active && !wasActive;
-    bool release = !active && wasActive;
-    
-    // SDL_Log("Pad %c: lmbDown=%d rmb=%d hovered=%d lmbReleased=%d active=%d activate=%d release=%d wasActive=%d", letter, lmbDown, rmb, hovered, lmbReleased, active, activate, release, wasActive);
-    if (activate) {
-        auto io = ImGui::GetIO();
-        auto ctrl = io.KeyCtrl;
-        auto shift = io.KeyShift;
-        auto alt = io.KeyAlt;
-        request = table[ctrl ? 1 : 0][shift ? 1 : 0][alt ? 1 : 0][(state == IDLE || state == PAUSED) ? 0 : 1];
-        SDL_Log("Pad %c activated: request=%d, ctrl = %d, shift = %d, alt = %d, state = %d", letter, request, ctrl, shift, alt, state);
-    } else if (ImGui::IsKeyReleased(key) || (hovered && lmbReleased)) {
-        SDL_Log("Catch release, state=%d, request=%d", state, request);
-        if (state == LOOPED && request == HELD) {
-            request = STOP;
-        }
-        SDL_Log("Pad %c key released: request=%d", letter, request);
+// The pad's reference to a sound, decoded by it or taken from the store
+static void releaseSound(MIX_Audio *audio, const std::string &key) {
+    if (key.empty()) {
+        MIX_DestroyAudio(audio);
+    } else {
+        assetStore.releaseAudio(key, audio);
     }
-    if (hovered) {
-        // check scroll
+}
+
+bool Pad::addVariant(MIX_Audio *loaded, const std::string &key, const std::string &name, bool mapped) {
+    if (!loaded) {
+        return false;
+    }
+    PadVariant v;
+    v.audio = loaded;
+    v.name = name;
+    v.soundKey = key;
+    v.mapped = mapped;
+    v.bytes = decodedBytes(loaded, mapped);
+    variants.push_back(v);
+    resources.variants = (unsigned) variants.size();
+    resources.variantBytes += mapped ? 0 : v.bytes;
+    return true;
+}
+
+void Pad::removeVariant(size_t index) {
+    if (index >= variants.size()) {
+        return;
+    }
+    unsigned removed = (unsigned) index + 1;
+    for (size_t i = 0; i < track.size(); ++i) {
+        if (trackVariant[i] == removed) {
+            // back to the main sound, so the track stays useful
+            MIX_StopTrack(track[i], 0);
+            if (!MIX_SetTrackAudio(track[i], audio)) {
+                SDL_Log("Failed to set track audio on %c: %s", letter, SDL_GetError());
+            }
+            trackVariant[i] = 0;
+        } else if (trackVariant[i] > removed) {
+            --trackVariant[i];
+        }
+    }
+    auto &v = variants[index];
+    resources.variantBytes -= v.mapped ? 0 : v.bytes;
+    releaseSound(v.audio, v.soundKey);
+    variants.erase(variants.begin() + index);
+    resources.variants = (unsigned) variants.size();
+    lastVariant = 0;
+}
+
+void Pad::clearVariants() {
+    while (!variants.empty()) {
+        removeVariant(variants.size() - 1);
+    }
+}
+
+void Pad::prepareTracks() {
+    makeSliceProps(); // the sound may have been loaded since they were set
+    for (unsigned v = 1; v <= variants.size(); ++v) {
+        if (std::find(trackVariant.begin(), trackVariant.end(), v) != trackVariant.end()) {
+            continue;
+        }
+        // rebinding an idle track of the main sound is as good as a new one
+        size_t spare = track.size();
+        unsigned mainTracks = 0;
+        for (size_t i = 0; i < track.size(); ++i) {
+            if (trackVariant[i] == 0 && ++mainTracks > 1 && !MIX_TrackPlaying(track[i]) && !MIX_TrackPaused(track[i])) {
+                spare = i;
+            }
+        }
+        if (spare < track.size()) {
+            if (MIX_SetTrackAudio(track[spare], variantAudio(v))) {
+                trackVariant[spare] = v;
+            }
+        } else {
+            createTrack(v);
+        }
+    }
+}
+
+unsigned Pad::nextVariant() {
+    unsigned takes = (unsigned) variants.size() + 1;
+    if (takes == 1) {
+        return 0;
+    }
+    switch (pick) {
+    case PICK_ROUND_ROBIN:
+        lastVariant = (lastVariant + 1) % takes;
+        break;
+    case PICK_RANDOM:
+        lastVariant = (unsigned) SDL_rand((Sint32) takes);
+        break;
+    case PICK_NO_REPEAT: {
+        // one of the others, equally likely
+        auto r = (unsigned) SDL_rand((Sint32) takes - 1);
+        lastVariant = r >= lastVariant ? r + 1 : r;
+        break;
+    }
+    }
+    return lastVariant;
+}
+
+MIX_Audio *Pad::variantAudio(unsigned variant) const {
+    return variant == 0 || variant > variants.size() ? audio : variants[variant - 1].audio;
+}
+
+void Pad::press(bool ctrl, bool shift, bool alt) {
+    request = table[ctrl ? 1 : 0][shift ? 1 : 0][alt ? 1 : 0][(state == IDLE || state == PAUSED) ? 0 : 1];
+    SDL_Log("Pad %c activated: request=%d, ctrl = %d, shift = %d, alt = %d, state = %d", letter, request, ctrl, shift, alt, state.load());
+}
+
+void Pad::release() {
+    if (state == LOOPED && request == HELD) {
+        request = STOP;
+    }
+    SDL_Log("Pad %c released: request=%d", letter, request);
+}
+
+SoundPad::~SoundPad() {
+    clear(); // pads may play straight from the mapping
+    delete pack;
+}
+
+void SoundPad::buildIndex() {
+    std::fill(byLetter, byLetter + 128, nullptr);
+    for (auto &row : *this) {
+        for (auto &p : row) {
+            if (p.letter >= 0) {
+                byLetter[(unsigned char) p.letter] = &p;
+            }
+        }
     }
-    wasActive = active;
-    return rmb && hovered;
+    mousePad = nullptr;
+}
+
+Pad *SoundPad::find(char letter) const {
+    if (letter < 0) {
+        return nullptr;
+    }
+    return byLetter[(unsigned char) toupper(letter)];
+}
+
+Pad *SoundPad::findKey(SDL_Keycode key) const {
+    // letter and digit keycodes are their (lowercase) ascii
+    return key < 128 ? find((char) key) : nullptr;
+}
+
+Pad *SoundPad::hitTest(ImVec2 pos) const {
+    if (padSize <= 0 || pos.x < origin.x || pos.y < origin.y) {
+        return nullptr;
+    }
+    size_t row = (pos.y - origin.y) / padSize;
+    size_t col = (pos.x - origin.x) / padSize;
+    if (row >= size() || col >= (*this)[row].size()) {
+        return nullptr;
+    }
+    return const_cast<Pad *>(&(*this)[row][col]);
 }
 
 void Pad::unloadSound() {
     if (audio) {
-        MIX_DestroyAudio(audio);
+        releaseSound(audio, soundKey);
         audio = nullptr;
         name = "";
+        soundKey = "";
     }
+    resources.audioFrames = 0;
+    resources.audioChannels = 0;
+    resources.audioRate = 0;
+    resources.audioFormat = SDL_AUDIO_UNKNOWN;
+    resources.audioBytes = 0;
+    resources.audioMapped = false;
+    resources.audioEncoded = false;
+    resources.soundLoadNS = 0;
 }
 
 Pad::~Pad() {
     unloadSound();
+    for (auto &v : variants) {
+        releaseSound(v.audio, v.soundKey);
+    }
     for (auto t : track) {
         MIX_DestroyTrack(t);
     }
-    if (picture) {
-        SDL_DestroyTexture(picture);
+    for (auto f : filters) {
+        delete f; // callbacks are gone with the tracks
     }
+    unloadPicture();
+    setSlices(PadSlice(), std::vector<PadSlice>());
     // SDL_Log("Pad %c destroyed", letter);
 }
 
-void Pad::fulfillRequest() {
+void Pad::fulfillRequest(Uint32 flow) {
+    if (request == NONE) {
+        return;
+    }
+    TraceSpan span("pad", "fulfill", letter, requestName(request));
+    span.flow(flow, 't');
     switch (request) {
     case NONE:
         break;
@@ -135,15 +442,17 @@ void Pad::fulfillRequest() {
             break;
         }
         // find an idle track
-        MIX_Track *idle = getIdleTrack();
+        MIX_Track *idle = getIdleTrack(nextVariant());
         if (idle == nullptr) {
             break;
         }
         SDL_Log("Shouting track on %c", letter);
-        if (!MIX_PlayTrack(idle, 0)) {
+        if (!MIX_PlayTrack(idle, playProps)) {
             SDL_Log("Failed to play track on %c: %s", letter, SDL_GetError());
             break;
         }
+        tracer.started(flow, letter, "ONE_SHOT");
+        countTrigger();
         break;
     }
     case STOP: {
@@ -183,15 +492,17 @@ void Pad::fulfillRequest() {
         if (!audio) {
             break;
         }
-        MIX_Track *t = getIdleTrack();
+        MIX_Track *t = getIdleTrack(nextVariant());
         if (!t) {
             break;
         }
         SDL_Log("Playing looped track on %c", letter);
-        if (!MIX_PlayTrack(t, loop)) {
+        if (!MIX_PlayTrack(t, loopProps ? loopProps : loop.id)) {
             SDL_Log("Failed to play track on %c: %s", letter, SDL_GetError());
             break;
         }
+        tracer.started(flow, letter, "LOOP");
+        countTrigger();
         break;
     }
     case HELD: {
@@ -200,15 +511,17 @@ void Pad::fulfillRequest() {
         } else if (!audio) {
             break;
         } else {
-            MIX_Track *t = getIdleTrack();
+            MIX_Track *t = getIdleTrack(nextVariant());
             if (!t) {
                 break;
             }
             SDL_Log("Playing looped track on %c (%ld loops)", letter, SDL_GetNumberProperty(loop, MIX_PROP_PLAY_LOOPS_NUMBER, -2));
-            if (!MIX_PlayTrack(t, loop)) {
+            if (!MIX_PlayTrack(t, loopProps ? loopProps : loop.id)) {
                 SDL_Log("Failed to play track on %c: %s", letter, SDL_GetError());
                 break;
             }
+            tracer.started(flow, letter, "HELD");
+            countTrigger();
         }
         break;
     }
@@ -216,13 +529,95 @@ void Pad::fulfillRequest() {
     request = request == HELD ? HELD : NONE;
 }
 
-void Pad::resolveState() {
+void Pad::playCue(size_t index, Uint32 flow) {
+    if (!audio || index >= cueProps.size()) {
+        return;
+    }
+    TraceSpan span("pad", "cue", letter, cues[index].name.c_str());
+    span.flow(flow, 't');
+    MIX_Track *t = getIdleTrack(0);
+    if (!t) {
+        return;
+    }
+    if (!MIX_PlayTrack(t, cueProps[index])) {
+        SDL_Log("Failed to play cue %s on %c: %s", cues[index].name.c_str(), letter, SDL_GetError());
+        return;
+    }
+    tracer.started(flow, letter, "CUE");
+    countTrigger();
+}
+
+void Pad::countTrigger() {
+    ++usage.triggers;
+    SDL_Time now;
+    if (SDL_GetCurrentTime(&now)) {
+        usage.lastTriggered = now / SDL_NS_PER_SECOND;
+    }
+}
+
+int Pad::findCue(const std::string &name) const {
+    for (size_t i = 0; i < cues.size(); ++i) {
+        if (cues[i].name == name) {
+            return (int) i;
+        }
+    }
+    return -1;
+}
+
+// Start and end of the slice for MIX_PlayTrack; the mixer stops at MAX_FRAME, a position in the sound.
+// Slices count frames of the source, which differ from the sound's once it is resampled on load
+static SDL_PropertiesID sliceProps(const PadSlice &slice, bool looped, MIX_Audio *audio) {
+    auto props = SDL_CreateProperties();
+    if (!props) {
+        SDL_Log("Failed to create play properties: %s", SDL_GetError());
+        return 0;
+    }
+    auto start = audio ? toLoadedFrames(audio, slice.start) : slice.start;
+    SDL_SetNumberProperty(props, MIX_PROP_PLAY_START_FRAME_NUMBER, start);
+    if (slice.end > slice.start) {
+        SDL_SetNumberProperty(props, MIX_PROP_PLAY_MAX_FRAME_NUMBER, audio ? toLoadedFrames(audio, slice.end) : slice.end);
+    }
+    if (looped) {
+        SDL_SetNumberProperty(props, MIX_PROP_PLAY_LOOPS_NUMBER, -1);
+        SDL_SetNumberProperty(props, MIX_PROP_PLAY_LOOP_START_FRAME_NUMBER, start);
+    }
+    return props;
+}
+
+void Pad::setSlices(const PadSlice &trim, const std::vector<PadSlice> &cues) {
+    this->trim = trim;
+    this->trim.name.clear();
+    this->cues = cues;
+    makeSliceProps();
+}
+
+void Pad::makeSliceProps() {
+    for (auto props : {playProps, loopProps}) {
+        if (props) {
+            SDL_DestroyProperties(props);
+        }
+    }
+    for (auto props : cueProps) {
+        SDL_DestroyProperties(props);
+    }
+    playProps = trim.whole() ? 0 : sliceProps(trim, false, audio);
+    loopProps = trim.whole() ? 0 : sliceProps(trim, true, audio);
+    cueProps.clear();
+    for (auto &c : cues) {
+        cueProps.push_back(sliceProps(c, false, audio));
+    }
+}
+
+bool Pad::resolveState() {
+    PadState old = state;
     bool anyPlaying = false;
     bool anyPaused = false;
     bool anyLooped = false;
+    unsigned playing = 0;
     for (auto t : track) {
         if (MIX_TrackPlaying(t)) {
             anyPlaying = true;
+            ++playing;
             if (MIX_GetTrackLoops(t) == -1) {
                 anyLooped = true;
                 // SDL_Log("Track on %c is looped", letter);
@@ -232,6 +627,7 @@ void Pad::resolveState() {
             anyPaused = true;
         }
     }
+    tracksPlaying = playing;
     if (anyPlaying) {
         state = anyLooped ? LOOPED : PLAYING;
     } else if (anyPaused) {
@@ -239,36 +635,50 @@ void Pad::resolveState() {
     } else {
         state = IDLE;
     }
+    if (state == old) {
+        return false;
+    }
+    if (stateListener) {
+        stateListener(stateListenerData, *this);
+    }
+    return true;
 }
 
-MIX_Track *Pad::getIdleTrack() {
-    MIX_Track *idle = nullptr;
-    for (auto t : track) {
-        if (!MIX_TrackPlaying(t) && !MIX_TrackPaused(t)) {
-            idle = t;
-            break;
+MIX_Track *Pad::getIdleTrack(unsigned variant) {
+    for (size_t i = 0; i < track.size(); ++i) {
+        auto t = track[i];
+        if (trackVariant[i] == variant && !MIX_TrackPlaying(t) && !MIX_TrackPaused(t)) {
+            return t;
         }
     }
-    if (idle == nullptr) {
-        SDL_Log("Creating new track on %c", letter);
-        idle = MIX_CreateTrack(mixer);
-        if (idle) {
-            track.push_back(idle);
-            MIX_SetTrackAudio(idle, audio);
-        } else {
-            SDL_Log("Failed to create new track on %c: %s", letter, SDL_GetError());
-        }
+    SDL_Log("Creating new track on %c", letter);
+    return createTrack(variant);
+}
+
+MIX_Track *Pad::createTrack(unsigned variant) {
+    auto t = MIX_CreateTrack(mixer);
+    if (!t) {
+        SDL_Log("Failed to create new track on %c: %s", letter, SDL_GetError());
+        return nullptr;
     }
-    return idle;
+    track.push_back(t);
+    trackVariant.push_back(variant);
+    tracksAllocated = (unsigned) track.size();
+    MIX_SetTrackAudio(t, variantAudio(variant));
+    MIX_SetTrackGain(t, gain);
+    applyDsp(track.size() - 1, PadDsp());
+    return t;
 }
 
-bool Pad::render(ImVec2 &size, bool interactive, ImFont *letterFont, float fontSize) {
+void Pad::render(ImVec2 &size, bool hovered, ImFont *letterFont, float fontSize) {
     ImDrawList *draw = ImGui::GetWindowDrawList();
     ImVec2 pos = ImGui::GetCursorScreenPos();
 
-    ImGui::PushID(letter);
+    ImGui::Dummy(size);
 
-    ImGui::InvisibleButton("", size);
+    if (pendingPicture) {
+        uploadPicture();
+    }
 
     ImU32 bg, bright;
     switch (state) {
@@ -301,7 +711,7 @@ bool Pad::render(ImVec2 &size, bool interactive, ImFont *letterFont, float fontS
     draw->AddRectFilled(pos, pMidB, bg);
     draw->AddRectFilled(pMidT, pMax, bright);
 
-    if (ImGui::IsItemHovered()) {
+    if (hovered) {
         draw->AddRect(pos, pMax, IM_COL32(0, 150, 0, 255), 0, 0, 1);
     }
 
@@ -337,13 +747,6 @@ bool Pad::render(ImVec2 &size, bool interactive, ImFont *letterFont, float fontS
         draw->AddRectFilled(namePos, ImVec2(namePos.x + nameSize.x, namePos.y + nameSize.y), IM_COL32(128, 128, 128, 128));
         draw->AddText(nullptr, 0, namePos, IM_COL32(255, 255, 255, 255), name.c_str(), nullptr, size.x);
     }
-
-    bool res = interactive ? processInput() : false;
-    fulfillRequest();
-    resolveState();
-
-    ImGui::PopID();
-    return res;
 }
 
 bool Pad::volume(float volume) {
@@ -351,21 +754,156 @@ bool Pad::volume(float volume) {
     for (auto &t : track) {
         res &= MIX_SetTrackGain(t, volume);
     }
+    gain = volume;
     return res;
 }
 
-#ifdef _MSC_VER // 0.f / 0.f is not permitted, so we need limits<float>::nan to acquire nan
-#include <limits>
-#endif // _MSC_VER
-
 float Pad::volume() {
-    if (track.empty()) {
-        SDL_Log("No tracks on pad %c?..", letter);
-#ifdef _MSC_VER
-        return std::numeric_limits<float>::quiet_NaN();
-#else // any sane compiler
-        return 0.f / 0.f;
-#endif // _MSC_VER
-    }
-    return MIX_GetTrackGain(track[0]);
+    return gain;
+}
+
+void Pad::setDsp(const PadDsp &dsp) {
+    if (dsp == this->dsp) {
+        return;
+    }
+    auto old = this->dsp;
+    this->dsp = dsp;
+    for (size_t i = 0; i < track.size(); ++i) {
+        applyDsp(i, old);
+    }
+}
+
+void Pad::applyDsp(size_t index, const PadDsp &old) {
+    auto t = track[index];
+    if (dsp.rate != old.rate && !MIX_SetTrackFrequencyRatio(t, dsp.rate)) {
+        SDL_Log("Failed to set rate on %c: %s", letter, SDL_GetError());
+    }
+    if (dsp.pan != old.pan) {
+        // balance: the center keeps both channels at full level
+        MIX_StereoGains gains = {std::min(1.f, 1.f - dsp.pan), std::min(1.f, 1.f + dsp.pan)};
+        if (!MIX_SetTrackStereo(t, dsp.pan == 0.f ? nullptr : &gains)) {
+            SDL_Log("Failed to set pan on %c: %s", letter, SDL_GetError());
+        }
+    }
+    if (dsp.filter == old.filter && dsp.cutoff == old.cutoff && dsp.resonance == old.resonance) {
+        return;
+    }
+    if (dsp.filter == FILTER_OFF) {
+        MIX_SetTrackCookedCallback(t, nullptr, nullptr);
+        return;
+    }
+    filters.resize(track.size(), nullptr);
+    auto &f = filters[index];
+    if (!f) {
+        f = new TrackFilter();
+    }
+    MIX_LockMixer(mixer); // the callback may be running
+    f->type = dsp.filter;
+    f->cutoff = dsp.cutoff;
+    f->resonance = dsp.resonance;
+    f->changed = true;
+    if (old.filter == FILTER_OFF) {
+        f->biquad.reset(); // tail of the last time it was on
+    }
+    MIX_UnlockMixer(mixer);
+    if (old.filter == FILTER_OFF && !MIX_SetTrackCookedCallback(t, filterTrack, f)) {
+        SDL_Log("Failed to set filter on %c: %s", letter, SDL_GetError());
+    }
+}
+
+unsigned Pad::playingTracks() {
+    unsigned res = 0;
+    for (auto t : track) {
+        if (MIX_TrackPlaying(t)) {
+            ++res;
+        }
+    }
+    return res;
+}
+
+void Pad::finishLoops() {
+    for (auto t : track) {
+        if (MIX_TrackPlaying(t) && MIX_GetTrackLoops(t) != 0) {
+            MIX_SetTrackLoops(t, 0);
+        }
+    }
+}
+
+size_t Pad::memoryUsage() {
+    return (resources.audioMapped ? 0 : resources.audioBytes) + resources.variantBytes + resources.pictureBytes;
+}
+
+bool Pad::demoted() const {
+    return audio && resources.audioEncoded && resolveStorage(storage) != STORAGE_ENCODED;
+}
+
+double PadUsage::score(Sint64 now) const {
+    if (triggers == 0) {
+        return 0;
+    }
+    // a pad played a lot last month still goes after one played a little today
+    double days = std::max<Sint64>(now - lastTriggered, 0) / 86400.0;
+    return triggers / (1.0 + days);
+}
+
+unsigned SoundPad::playingTracks() {
+    unsigned res = 0;
+    for (auto &row : *this) {
+        for (auto &p : row) {
+            res += p.playingTracks();
+        }
+    }
+    return res;
+}
+
+void SoundPad::uploadPictures() {
+    for (auto &row : *this) {
+        for (auto &p : row) {
+            if (p.pendingPicture) {
+                p.uploadPicture();
+            }
+        }
+    }
+}
+
+size_t SoundPad::memoryUsage() {
+    size_t res = 0;
+    for (auto &row : *this) {
+        for (auto &p : row) {
+            res += p.memoryUsage();
+        }
+    }
+    return res;
+}
+
+const char *requestName(PadStateRequest request) {
+    switch (request) {
+    case NONE:
+        return "NONE";
+    case ONE_SHOT:
+        return "ONE_SHOT";
+    case STOP:
+        return "STOP";
+    case PAUSE:
+        return "PAUSE";
+    case RESUME:
+        return "RESUME";
+    case LOOP:
+        return "LOOP";
+    case HELD:
+        return "HELD";
+    }
+    return "UNKNOWN";
+}
+
+const char *pickName(VariantPick pick) {
+    switch (pick) {
+    case PICK_ROUND_ROBIN:
+        return "Round-robin";
+    case PICK_RANDOM:
+        return "Random";
+    case PICK_NO_REPEAT:
+        return "Random, no repeat";
+    }
+    return "Unknown";
 }
@@ -2,7 +2,10 @@
 #define PAD_HPP
 
 #include "preface.hpp"
+#include "Dsp.hpp"
+#include "Resample.hpp"
 #include "Utils.hpp"
+#include <atomic>
 #include <string>
 #include <vector>
 
@@ -39,11 +42,70 @@ public:
     operator SDL_PropertiesID() const { return id; }
 };
 
+// Which take of the sound the next trigger plays
+enum VariantPick {
+    PICK_ROUND_ROBIN,
+    PICK_RANDOM,
+    PICK_NO_REPEAT, // random, never the same take twice in a row
+};
+
+// Another take of a pad's sound, decoded on load like the main one
+struct PadVariant {
+    MIX_Audio *audio = nullptr;
+    std::string name = "";
+    std::string soundKey = ""; // in the asset store, empty if the pad owns the audio
+    size_t bytes = 0;
+    bool mapped = false;
+};
+
+// Part of the sound in frames of the source, so it is sample accurate; played in place, nothing is copied
+struct PadSlice {
+    std::string name = ""; // of a cue, empty for the trim
+    Sint64 start = 0;
+    Sint64 end = 0;        // 0 plays to the end
+
+    bool whole() const {
+        return start == 0 && end == 0;
+    }
+};
+
+class Pad;
+class Pack;
+
+// Kept up to date when sounds and pictures are loaded and unloaded, read by the resources window
+struct PadResources {
+    Sint64 audioFrames = 0;
+    int audioChannels = 0;
+    int audioRate = 0;
+    SDL_AudioFormat audioFormat = SDL_AUDIO_UNKNOWN; // of the source
+    size_t audioBytes = 0;  // decoded samples, or the mapping played in place
+    bool audioMapped = false;
+    bool audioEncoded = false; // the file itself, decoded as it plays
+    unsigned variants = 0;
+    size_t variantBytes = 0; // decoded samples of the variants, mapped ones excluded
+    Uint64 soundLoadNS = 0; // decoding, for stored sounds the first decode of the blob
+    int pictureWidth = 0;
+    int pictureHeight = 0;
+    size_t pictureBytes = 0; // texture estimate, or the surface until uploaded
+    Uint64 pictureLoadNS = 0; // decoding and upload
+};
+
+// How much the pad is played, kept in the profile so the most used pads are decoded first
+struct PadUsage {
+    Uint32 triggers = 0;
+    Sint64 lastTriggered = 0; // seconds since the epoch, 0 if never
+
+    // Triggers weighed by how long ago the last one was; higher is decoded first
+    double score(Sint64 now) const;
+};
+
+typedef void (*PadStateListener)(void *userdata, const Pad &pad);
+
 class Pad {
 public:
     const char letter;
     const ImGuiKey key;
-    PadState state = IDLE;
+    std::atomic<PadState> state = IDLE; // published by the engine thread
     PadStateRequest request = NONE;
     PadStateRequest table[2][2][2][2] = {
         {   // NO ctrl
@@ -73,10 +135,25 @@ public:
 
     MIX_Audio *audio = nullptr;
     std::string name = "";
+    std::string soundKey = ""; // in the asset store, empty if loaded from elsewhere
+    std::atomic<float> gain = 1.f; // of the tracks, for the UI
+    PadDsp dsp; // of the tracks, set by the engine thread; the UI reads it under padLock
+    std::vector<PadVariant> variants = std::vector<PadVariant>(); // taken in turn with the main sound
+    VariantPick pick = PICK_ROUND_ROBIN;
+    PadSlice trim;                 // what triggers play, of every take
+    std::vector<PadSlice> cues = std::vector<PadSlice>(); // of the main sound, played by name
+    SampleStorage storage = STORAGE_DEFAULT; // of sounds loaded from now on
+    PadUsage usage; // counted by the engine thread; the UI reads it under padLock
 
     int pictureOpacity = 192;
     SDL_Texture *picture = nullptr;
+    SDL_Surface *pendingPicture = nullptr; // loaded off the main thread, uploaded on render
     std::string picturePath = "";
+    std::string pictureKey = "";
+
+    PadResources resources;
+    std::atomic<unsigned> tracksAllocated = 1;
+    std::atomic<unsigned> tracksPlaying = 0; // as of the last resolveState()
 
     Pad(const char letter, MIX_Mixer *mixer)
         : letter(letter)
@@ -85,12 +162,13 @@ public:
     {
         track.reserve(8);
         track.push_back(MIX_CreateTrack(mixer));
+        trackVariant.push_back(0);
     }
     ~Pad();
     Pad(Pad &&o)
         : letter(o.letter)
         , key(o.key)
-        , state(o.state)
+        , state(o.state.load())
         , request(o.request)
         , table{o.table[0][0][0][0], o.table[0][0][0][1], o.table[0][0][1][0], o.table[0][0][1][1],
                 o.table[0][1][0][0], o.table[0][1][0][1], o.table[0][1][1][0], o.table[0][1][1][1],
@@ -100,24 +178,91 @@ public:
         , track(std::move(o.track))
         , audio(o.audio)
         , name(std::move(o.name))
-        , wasActive(o.wasActive)
+        , soundKey(std::move(o.soundKey))
+        , gain(o.gain.load())
+        , dsp(o.dsp)
+        , variants(std::move(o.variants))
+        , pick(o.pick)
+        , trim(std::move(o.trim))
+        , cues(std::move(o.cues))
+        , storage(o.storage)
+        , usage(o.usage)
+        , resources(o.resources)
+        , tracksAllocated(o.tracksAllocated.load())
+        , tracksPlaying(o.tracksPlaying.load())
+        , filters(std::move(o.filters))
+        , trackVariant(std::move(o.trackVariant))
+        , lastVariant(o.lastVariant)
+        , playProps(o.playProps)
+        , loopProps(o.loopProps)
+        , cueProps(std::move(o.cueProps))
     {
         o.mixer = nullptr;
         o.audio = nullptr;
+        o.playProps = 0;
+        o.loopProps = 0;
         // SDL_Log("Pad %c moved", letter);
     }
 
     bool loadPicture(const std::string &path);
 
+    // Takes ownership of the stream, name is what goes into the profile
+    bool loadPicture(SDL_IOStream *io, const std::string &name);
+
     bool loadSound(const std::string &path);
 
-    bool render(ImVec2 &size, bool interactive, ImFont *letterFont, float fontSize);
+    // Takes ownership of the stream, name is what goes into the profile
+    bool loadSound(SDL_IOStream *io, const std::string &name);
+
+    // Plays PCM in place, it must outlive the pad (e.g. a mapped bundle)
+    bool loadSound(const void *pcm, size_t size, const SDL_AudioSpec &spec, const std::string &name);
+
+    // From the asset store, decoded once for every pad using the same blob
+    bool loadStoredSound(const std::string &key, const std::string &name);
+
+    // Replaces the sound with one decoded elsewhere; key as in loadStoredSound, empty if the pad owns it
+    bool adoptSound(MIX_Audio *loaded, const std::string &key, const std::string &name);
+
+    bool loadStoredPicture(const std::string &key, const std::string &name);
+
+    // Takes a picture decoded elsewhere, its texture is made on render; key as in loadStoredPicture
+    void adoptPicture(SDL_Surface *surface, const std::string &key, const std::string &name, Uint64 loadNS);
+
+    // Takes the decoded take; key as in adoptSound. Call prepareTracks() before triggers
+    bool addVariant(MIX_Audio *loaded, const std::string &key, const std::string &name, bool mapped = false);
+
+    // Tracks playing the variant stop
+    void removeVariant(size_t index);
+
+    void clearVariants();
 
-    bool processInput();
+    // An idle track per take and the play options of the slices for the loaded sound,
+    // so triggers pick a take by index without creating tracks, binding audio or making options
+    void prepareTracks();
 
-    void fulfillRequest();
+    // Draws the published state only, the mixer is left to the engine thread
+    void render(ImVec2 &size, bool hovered, ImFont *letterFont, float fontSize);
 
-    void resolveState();
+    // Key or mouse button went down on this pad
+    void press(bool ctrl, bool shift, bool alt);
+
+    // Key or mouse button went up
+    void release();
+
+    // `flow` is the traced command behind the request, 0 if none
+    void fulfillRequest(Uint32 flow = 0);
+
+    // Plays the cue once, from its first frame without seeking
+    void playCue(size_t index, Uint32 flow = 0);
+
+    // Index of the cue, -1 if there is none
+    int findCue(const std::string &name) const;
+
+    // Replaces the trim and the cues; their play options are made here, so triggers make none
+    void setSlices(const PadSlice &trim, const std::vector<PadSlice> &cues);
+
+    // Returns true when state was changed
+    bool resolveState();
 
     void unloadPicture();
 
@@ -126,12 +271,91 @@ public:
     bool volume(float volume);
 
     float volume();
+
+    // Rate, pan and filter of every track; only what differs from neutral is set on them
+    void setDsp(const PadDsp &dsp);
+
+    unsigned playingTracks();
+
+    // Looped tracks stop after their current round
+    void finishLoops();
+
+    // Memory held by decoded sound and picture, from the resource counters
+    size_t memoryUsage();
+
+    // The sound is kept encoded while its storage says otherwise, to stay in the memory budget
+    bool demoted() const;
+
+    // Makes the texture of a picture loaded off the main thread; main thread only
+    bool uploadPicture();
+
+    // Called from any thread which resolves a pad state, so it must be thread-safe
+    static void setStateListener(PadStateListener listener, void *userdata);
 private:
-    MIX_Track *getIdleTrack();
-    bool wasActive = false;
+    std::vector<TrackFilter *> filters; // per track, nullptr until it is filtered
+    std::vector<unsigned> trackVariant;  // per track, the take it is bound to, 0 is the main sound
+    unsigned lastVariant = 0;
+    SDL_PropertiesID playProps = 0; // trimmed one shot, 0 plays the whole sound
+    SDL_PropertiesID loopProps = 0; // trimmed loop, 0 uses `loop`
+    std::vector<SDL_PropertiesID> cueProps;
+
+    void makeSliceProps();
+    // A trigger started a track
+    void countTrigger();
+    // Take the next trigger plays, 0 is the main sound
+    unsigned nextVariant();
+    MIX_Audio *variantAudio(unsigned variant) const;
+    // Idle track bound to the take, a new one if all of them play
+    MIX_Track *getIdleTrack(unsigned variant);
+    MIX_Track *createTrack(unsigned variant);
+    // Sets what changed since `old` on the track
+    void applyDsp(size_t index, const PadDsp &old);
+    bool setAudio(MIX_Audio *loaded, const std::string &name, Uint64 loadNS, bool mapped = false);
+    void countPicture(int w, int h, size_t bytes, Uint64 loadNS);
     static SDLLoopProp loop;
+    static PadStateListener stateListener;
+    static void *stateListenerData;
 };
 
-typedef std::vector<std::vector<Pad> > SoundPad;
+/**
+ * Rows of pads, plus lookup tables built once the layout is complete
+ * (pads must not be added afterwards, as it would move them).
+ */
+class SoundPad : public std::vector<std::vector<Pad> > {
+public:
+    // Top left corner and pad size of the last rendered frame
+    ImVec2 origin = ImVec2(0, 0);
+    float padSize = 0;
+    // Pad held by the left mouse button
+    Pad *mousePad = nullptr;
+    // Wall clock of loadSoundPad()
+    Uint64 loadNS = 0;
+    // Bundle the assets are mapped from, if any
+    Pack *pack = nullptr;
+
+    ~SoundPad();
+
+    void buildIndex();
+
+    Pad *find(char letter) const;
+
+    Pad *findKey(SDL_Keycode key) const;
+
+    // Pad under the point on the last rendered frame
+    Pad *hitTest(ImVec2 pos) const;
+
+    unsigned playingTracks();
+
+    size_t memoryUsage();
+
+    // Textures of pictures loaded off the main thread; main thread only
+    void uploadPictures();
+private:
+    Pad *byLetter[128] = {};
+};
+
+const char *requestName(PadStateRequest request);
+
+const char *pickName(VariantPick pick);
 
 #endif // PAD_HPP
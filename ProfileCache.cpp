@@ -0,0 +1,191 @@
+#include "ProfileCache.hpp"
+#include <algorithm>
+#include "Config.hpp"
+
+ProfileCache::ProfileCache(MIX_Mixer *mixer, size_t budget)
+    : mixer(mixer)
+    , budget(budget)
+{
+}
+
+ProfileCache::~ProfileCache() {
+    stop();
+    for (auto &e : warm) {
+        delete e.pad;
+    }
+}
+
+void ProfileCache::start() {
+    std::lock_guard<std::mutex> guard(lock);
+    running = true;
+}
+
+void ProfileCache::stop() {
+    std::vector<std::pair<std::filesystem::path, JobGroupPtr> > loads;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        running = false;
+        loads = loading;
+    }
+    for (auto &l : loads) {
+        l.second->cancel();
+        jobs.wait(l.second);
+    }
+}
+
+void ProfileCache::preload(const std::filesystem::path &path) {
+    auto group = std::make_shared<JobGroup>();
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        if (!running) {
+            return;
+        }
+        for (auto &l : loading) {
+            // a cancelled load gives nothing back, so asking again needs a new one
+            if (l.first == path && !l.second->cancelled()) {
+                return;
+            }
+        }
+        for (auto &e : warm) {
+            if (e.path == path) {
+                return;
+            }
+        }
+        loading.emplace_back(path, group);
+    }
+    // somebody is waiting for the switch
+    jobs.run(JOB_NOW, [this, path, group]() { load(path, group); }, group);
+}
+
+void ProfileCache::cancel(const std::filesystem::path &path) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &l : loading) {
+        if (l.first == path) {
+            l.second->cancel();
+        }
+    }
+}
+
+SoundPad *ProfileCache::take(const std::filesystem::path &path) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto it = warm.begin(); it != warm.end(); ++it) {
+        if (it->path == path) {
+            auto pad = it->pad;
+            total -= it->bytes;
+            warm.erase(it);
+            pad->mousePad = nullptr;
+            return pad;
+        }
+    }
+    return nullptr;
+}
+
+bool ProfileCache::isWarm(const std::filesystem::path &path) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &e : warm) {
+        if (e.path == path) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void ProfileCache::retire(SoundPad *pad, const std::filesystem::path &path) {
+    if (!pad) {
+        return;
+    }
+    for (auto &row : *pad) {
+        for (auto &p : row) {
+            p.finishLoops();
+            p.request = NONE;
+        }
+    }
+    Entry e = {path, pad, pad->memoryUsage()};
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        total += e.bytes;
+        warm.push_front(e);
+    }
+    trim();
+}
+
+void ProfileCache::forget(const std::filesystem::path &path) {
+    cancel(path);
+    SoundPad *pad = take(path);
+    delete pad;
+}
+
+void ProfileCache::trim() {
+    std::vector<SoundPad *> evicted;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        // the most recent one stays, it is either just loaded or just left
+        for (auto it = warm.end(); total > budget && it != warm.begin();) {
+            --it;
+            if (it == warm.begin()) {
+                break;
+            }
+            if (it->pad->playingTracks() > 0) {
+                continue; // let it finish, it will be evicted later
+            }
+            SDL_Log("Evicting profile %s from warm cache (%zu KiB)", it->path.filename().u8string().c_str(), it->bytes / 1024);
+            total -= it->bytes;
+            evicted.push_back(it->pad);
+            it = warm.erase(it);
+        }
+    }
+    for (auto pad : evicted) {
+        delete pad;
+    }
+}
+
+size_t ProfileCache::bytes() {
+    std::lock_guard<std::mutex> guard(lock);
+    return total;
+}
+
+void ProfileCache::forEachWarm(const std::function<void(const std::filesystem::path &, SoundPad &)> &fn) {
+    std::lock_guard<std::mutex> guard(lock);
+    for (auto &e : warm) {
+        fn(e.path, *e.pad);
+    }
+}
+
+void ProfileCache::setBudget(size_t newBudget) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        budget = newBudget;
+    }
+    trim();
+}
+
+void ProfileCache::load(const std::filesystem::path &path, const JobGroupPtr &group) {
+    // the job is one of the group, its sounds and pictures are jobs of a nested one
+    auto pad = loadSoundPad(path, mixer, JOB_NOW, group);
+    std::unique_lock<std::mutex> guard(lock);
+    loading.erase(std::remove_if(loading.begin(), loading.end(),
+        [&group](const std::pair<std::filesystem::path, JobGroupPtr> &l) { return l.second == group; }), loading.end());
+    if (!pad) {
+        return; // cancelled
+    }
+    for (auto &e : warm) {
+        if (e.path == path) {
+            // cancelled too late, and asked for again meanwhile
+            guard.unlock();
+            delete pad;
+            return;
+        }
+    }
+    auto bytes = pad->memoryUsage();
+    total += bytes;
+    warm.push_front({path, pad, bytes});
+    // textures are made by the main thread, unless the profile is shown or gone by then
+    jobs.onMain([this, pad]() {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto &e : warm) {
+            if (e.pad == pad) {
+                pad->uploadPictures();
+            }
+        }
+    });
+}
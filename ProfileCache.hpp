@@ -0,0 +1,73 @@
+#ifndef PROFILECACHE_HPP
+#define PROFILECACHE_HPP
+
+#include "preface.hpp"
+#include <filesystem>
+#include <functional>
+#include <list>
+#include <mutex>
+#include <vector>
+#include "Jobs.hpp"
+#include "Pad.hpp"
+
+/**
+ * Loaded profiles kept aside: ones being preloaded by jobs and recently
+ * used ones, so switching to them is a pointer swap. Pictures of preloaded
+ * profiles are uploaded by the main thread ahead of the switch. Profiles are
+ * evicted least recently used first once the memory budget is exceeded,
+ * but never while they are still playing.
+ */
+class ProfileCache {
+public:
+    ProfileCache(MIX_Mixer *mixer, size_t budget);
+    ~ProfileCache();
+
+    void start();
+
+    void stop();
+
+    // Starts loading in the background, unless it is warm or on its way already
+    void preload(const std::filesystem::path &path);
+
+    // Gives up loading the profile, e.g. when another one was asked for meanwhile
+    void cancel(const std::filesystem::path &path);
+
+    // Hands a loaded profile over (it leaves the cache), nullptr if it is not ready
+    SoundPad *take(const std::filesystem::path &path);
+
+    bool isWarm(const std::filesystem::path &path);
+
+    // Keeps a profile which is not shown anymore; its loops finish their current round
+    void retire(SoundPad *pad, const std::filesystem::path &path);
+
+    // Drops a profile, loaded or loading, e.g. when it is deleted
+    void forget(const std::filesystem::path &path);
+
+    // UI thread: evicts profiles above the budget
+    void trim();
+
+    size_t bytes();
+
+    // UI thread: walks the warm profiles, most recently used first
+    void forEachWarm(const std::function<void(const std::filesystem::path &, SoundPad &)> &fn);
+
+    void setBudget(size_t budget);
+private:
+    struct Entry {
+        std::filesystem::path path;
+        SoundPad *pad;
+        size_t bytes;
+    };
+
+    MIX_Mixer *mixer;
+    size_t budget;
+    bool running = false;
+    std::mutex lock;
+    std::list<Entry> warm; // most recently used first
+    std::vector<std::pair<std::filesystem::path, JobGroupPtr> > loading;
+    size_t total = 0;
+
+    void load(const std::filesystem::path &path, const JobGroupPtr &group);
+};
+
+#endif // PROFILECACHE_HPP
@@ -0,0 +1,155 @@
+#ifndef QUEUE_HPP
+#define QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+
+/**
+ * Bounded lock-free multi-producer multi-consumer queue
+ * (Dmitry Vyukov's array based design). Never allocates after construction,
+ * push fails when the queue is full.
+ */
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        mask = size - 1;
+        cells.reset(new Cell[size]);
+        for (size_t i = 0; i < size; ++i) {
+            cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        head.store(0, std::memory_order_relaxed);
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    BoundedQueue(const BoundedQueue &) = delete;
+    BoundedQueue &operator=(const BoundedQueue &) = delete;
+
+    bool push(const T &value) {
+        size_t pos = head.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+            if (diff == 0) {
+                if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = head.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = value;
+        cell->seq.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool pop(T &value) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Cell *cell;
+        while (true) {
+            cell = &cells[pos & mask];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+        value = cell->data;
+        cell->seq.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Approximate, for metrics only
+    size_t size() const {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_relaxed);
+        return h > t ? h - t : 0;
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+private:
+    struct Cell {
+        std::atomic<size_t> seq;
+        T data;
+    };
+
+    std::unique_ptr<Cell[]> cells;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;
+    alignas(64) std::atomic<size_t> tail;
+};
+
+/**
+ * Lock-free ring of plain values for exactly one writer and one reader thread.
+ * Both sides copy whole runs with memcpy and never block or allocate after
+ * construction; a write that doesn't fit is refused whole.
+ */
+template <typename T>
+class RingBuffer {
+public:
+    explicit RingBuffer(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size <<= 1;
+        mask = size - 1;
+        data.reset(new T[size]);
+    }
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    // Writer thread: all of it or nothing
+    bool write(const T *values, size_t count) {
+        size_t h = head.load(std::memory_order_relaxed);
+        size_t t = tail.load(std::memory_order_acquire);
+        if (mask + 1 - (h - t) < count) {
+            return false;
+        }
+        size_t at = h & mask;
+        size_t first = std::min(count, mask + 1 - at);
+        std::memcpy(&data[at], values, first * sizeof(T));
+        std::memcpy(&data[0], values + first, (count - first) * sizeof(T));
+        head.store(h + count, std::memory_order_release);
+        return true;
+    }
+
+    // Reader thread: up to count, returns how many
+    size_t read(T *values, size_t count) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t h = head.load(std::memory_order_acquire);
+        count = std::min(count, h - t);
+        size_t at = t & mask;
+        size_t first = std::min(count, mask + 1 - at);
+        std::memcpy(values, &data[at], first * sizeof(T));
+        std::memcpy(values + first, &data[0], (count - first) * sizeof(T));
+        tail.store(t + count, std::memory_order_release);
+        return count;
+    }
+
+    size_t size() const {
+        return head.load(std::memory_order_relaxed) - tail.load(std::memory_order_relaxed);
+    }
+
+    size_t capacity() const {
+        return mask + 1;
+    }
+private:
+    std::unique_ptr<T[]> data;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head = 0;
+    alignas(64) std::atomic<size_t> tail = 0;
+};
+
+#endif // QUEUE_HPP
@@ -0,0 +1,162 @@
+#include "Replay.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <sstream>
+
+bool InputRecorder::open(const std::filesystem::path &path) {
+    out.open(path);
+    if (!out.is_open()) {
+        SDL_Log("Failed to open input record %s", path.u8string().c_str());
+        return false;
+    }
+    start = SDL_GetTicks();
+    return true;
+}
+
+void InputRecorder::close() {
+    if (out.is_open()) {
+        out << (SDL_GetTicks() - start) << " end" << std::endl;
+        out.close();
+    }
+}
+
+void InputRecorder::record(const SDL_Event &event) {
+    if (!out.is_open()) {
+        return;
+    }
+    auto t = SDL_GetTicks() - start;
+    switch (event.type) {
+    case SDL_EVENT_KEY_DOWN:
+    case SDL_EVENT_KEY_UP:
+        out << t << " key " << event.key.down << " " << event.key.scancode << " " << event.key.key
+            << " " << event.key.mod << " " << event.key.repeat << "\n";
+        break;
+    case SDL_EVENT_MOUSE_MOTION:
+        out << t << " motion " << event.motion.x << " " << event.motion.y << "\n";
+        break;
+    case SDL_EVENT_MOUSE_BUTTON_DOWN:
+    case SDL_EVENT_MOUSE_BUTTON_UP:
+        out << t << " button " << event.button.down << " " << (int) event.button.button << " " << (int) event.button.clicks
+            << " " << event.button.x << " " << event.button.y << "\n";
+        break;
+    case SDL_EVENT_MOUSE_WHEEL:
+        out << t << " wheel " << event.wheel.x << " " << event.wheel.y
+            << " " << event.wheel.mouse_x << " " << event.wheel.mouse_y << "\n";
+        break;
+    case SDL_EVENT_WINDOW_RESIZED:
+        out << t << " resize " << event.window.data1 << " " << event.window.data2 << "\n";
+        break;
+    default:
+        break;
+    }
+}
+
+void InputRecorder::recordProfile(const std::string &name) {
+    if (out.is_open()) {
+        out << (SDL_GetTicks() - start) << " profile " << name << "\n";
+    }
+}
+
+bool InputReplayer::open(const std::filesystem::path &path) {
+    std::ifstream in(path);
+    if (!in.is_open()) {
+        SDL_Log("Failed to open input record %s", path.u8string().c_str());
+        return false;
+    }
+    std::string line;
+    unsigned lineNo = 0;
+    while (std::getline(in, line)) {
+        ++lineNo;
+        if (line.empty()) continue;
+        std::stringstream ls(line);
+        ReplayEvent e;
+        std::string kind;
+        if (!(ls >> e.time >> kind)) {
+            SDL_Log("Bad input record line %u", lineNo);
+            continue;
+        }
+        bool ok = true;
+        if (kind == "key") {
+            int down, scancode, repeat;
+            Uint32 key;
+            Uint32 mod;
+            ok = static_cast<bool>(ls >> down >> scancode >> key >> mod >> repeat);
+            e.event.type = down ? SDL_EVENT_KEY_DOWN : SDL_EVENT_KEY_UP;
+            e.event.key.down = down;
+            e.event.key.scancode = (SDL_Scancode) scancode;
+            e.event.key.key = key;
+            e.event.key.mod = (SDL_Keymod) mod;
+            e.event.key.repeat = repeat;
+        } else if (kind == "motion") {
+            e.event.type = SDL_EVENT_MOUSE_MOTION;
+            ok = static_cast<bool>(ls >> e.event.motion.x >> e.event.motion.y);
+        } else if (kind == "button") {
+            int down, button, clicks;
+            ok = static_cast<bool>(ls >> down >> button >> clicks >> e.event.button.x >> e.event.button.y);
+            e.event.type = down ? SDL_EVENT_MOUSE_BUTTON_DOWN : SDL_EVENT_MOUSE_BUTTON_UP;
+            e.event.button.down = down;
+            e.event.button.button = button;
+            e.event.button.clicks = clicks;
+        } else if (kind == "wheel") {
+            e.event.type = SDL_EVENT_MOUSE_WHEEL;
+            ok = static_cast<bool>(ls >> e.event.wheel.x >> e.event.wheel.y >> e.event.wheel.mouse_x >> e.event.wheel.mouse_y);
+        } else if (kind == "resize") {
+            e.event.type = SDL_EVENT_WINDOW_RESIZED;
+            ok = static_cast<bool>(ls >> e.event.window.data1 >> e.event.window.data2);
+        } else if (kind == "profile") {
+            e.isProfile = true;
+            std::getline(ls >> std::ws, e.profile);
+        } else if (kind == "end") {
+            endTime = e.time;
+            continue;
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            SDL_Log("Bad input record line %u: %s", lineNo, line.c_str());
+            continue;
+        }
+        e.event.common.timestamp = e.time * 1000000;
+        events.push_back(e);
+    }
+    if (!events.empty()) {
+        endTime = std::max(endTime, events.back().time);
+    }
+    SDL_Log("Loaded %zu input events, %llu ms", events.size(), (unsigned long long) endTime);
+    return true;
+}
+
+bool InputReplayer::next(Uint64 now, ReplayEvent &event) {
+    if (position >= events.size() || events[position].time > now) {
+        return false;
+    }
+    event = events[position++];
+    return true;
+}
+
+bool InputReplayer::finished(Uint64 now) const {
+    return position >= events.size() && now >= endTime;
+}
+
+void ReplayStats::frame(Uint64 ns, Uint64 voices) {
+    ++frames;
+    frameNS.push_back(ns);
+    totalVoices += voices;
+    maxVoices = std::max(maxVoices, voices);
+}
+
+void ReplayStats::print() const {
+    if (frames == 0) {
+        printf("No frames replayed\n");
+        return;
+    }
+    auto sorted = frameNS;
+    std::sort(sorted.begin(), sorted.end());
+    Uint64 total = 0;
+    for (auto ns : sorted) total += ns;
+    auto pct = [&sorted](double p) { return sorted[std::min(sorted.size() - 1, (size_t) (p * sorted.size()))]; };
+    printf("frames: %llu\n", (unsigned long long) frames);
+    printf("frame time us: avg %.1f, p50 %.1f, p95 %.1f, p99 %.1f, max %.1f\n",
+        total / 1000.0 / frames, pct(0.5) / 1000.0, pct(0.95) / 1000.0, pct(0.99) / 1000.0, sorted.back() / 1000.0);
+    printf("voices: avg %.2f, max %llu\n", (double) totalVoices / frames, (unsigned long long) maxVoices);
+}
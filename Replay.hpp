@@ -0,0 +1,69 @@
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include "preface.hpp"
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+/**
+ * Recorded input, one event per line:
+ *   <ms> key <down> <scancode> <keycode> <mod> <repeat>
+ *   <ms> motion <x> <y>
+ *   <ms> button <down> <button> <clicks> <x> <y>
+ *   <ms> wheel <x> <y> <mouse x> <mouse y>
+ *   <ms> resize <w> <h>
+ *   <ms> profile [<file name>]
+ *   <ms> end
+ * Time is counted from the start of recording.
+ */
+struct ReplayEvent {
+    Uint64 time = 0;
+    bool isProfile = false;
+    std::string profile; // empty means back to the selector
+    SDL_Event event = {};
+};
+
+class InputRecorder {
+public:
+    bool open(const std::filesystem::path &path);
+
+    void close();
+
+    // Records events the app cares about, others are skipped
+    void record(const SDL_Event &event);
+
+    void recordProfile(const std::string &name);
+private:
+    std::ofstream out;
+    Uint64 start = 0;
+};
+
+class InputReplayer {
+public:
+    bool open(const std::filesystem::path &path);
+
+    // Fetches next event due at `now` (ms from start), returns false if there is none yet
+    bool next(Uint64 now, ReplayEvent &event);
+
+    // True when all events are replayed and recorded session time is over
+    bool finished(Uint64 now) const;
+private:
+    std::vector<ReplayEvent> events;
+    size_t position = 0;
+    Uint64 endTime = 0;
+};
+
+struct ReplayStats {
+    Uint64 frames = 0;
+    std::vector<Uint64> frameNS;
+    Uint64 maxVoices = 0;
+    Uint64 totalVoices = 0;
+
+    void frame(Uint64 ns, Uint64 voices);
+
+    void print() const;
+};
+
+#endif // REPLAY_HPP
@@ -0,0 +1,156 @@
+#include "Resample.hpp"
+#include <algorithm>
+
+// Kept on converted sounds, which report the rate they were converted to
+static const char *sourceRateProp = "soundpad.source_rate";
+// Kept on encoded sounds
+static const char *encodedBytesProp = "soundpad.encoded_bytes";
+
+SampleStorage resolveStorage(SampleStorage storage) {
+    if (storage == STORAGE_DEFAULT) {
+        storage = storageOnLoad;
+    }
+    return storage == STORAGE_DEFAULT ? STORAGE_FLOAT : storage;
+}
+
+const char *storageName(SampleStorage storage) {
+    switch (storage) {
+    case STORAGE_FLOAT:
+        return "Float";
+    case STORAGE_COMPACT:
+        return "16-bit";
+    case STORAGE_ENCODED:
+        return "Encoded";
+    default:
+        return "App default";
+    }
+}
+
+// The whole file is read into memory, tracks decode it as they play
+static MIX_Audio *loadEncoded(MIX_Mixer *mixer, SDL_IOStream *io, bool closeio) {
+    auto size = io ? SDL_GetIOSize(io) : -1;
+    auto audio = MIX_LoadAudio_IO(mixer, io, false, closeio);
+    if (audio) {
+        SDL_SetNumberProperty(MIX_GetAudioProperties(audio), encodedBytesProp, std::max<Sint64>(size, 0));
+    }
+    return audio;
+}
+
+MIX_Audio *loadForMixer(MIX_Mixer *mixer, SDL_IOStream *io, bool closeio, SampleStorage storage) {
+    storage = resolveStorage(storage);
+    if (storage == STORAGE_ENCODED) {
+        return loadEncoded(mixer, io, closeio);
+    }
+    SDL_AudioSpec out;
+    bool compact = storage == STORAGE_COMPACT;
+    if ((!resampleOnLoad && !compact) || !io || !MIX_GetMixerFormat(mixer, &out)) {
+        return MIX_LoadAudio_IO(mixer, io, true, closeio);
+    }
+    auto start = SDL_GetTicksNS();
+    auto decoder = MIX_CreateAudioDecoder_IO(io, closeio, 0);
+    SDL_AudioSpec in;
+    if (!decoder || !MIX_GetAudioDecoderFormat(decoder, &in)) {
+        SDL_Log("Failed to create decoder: %s", SDL_GetError());
+        if (decoder) {
+            MIX_DestroyAudioDecoder(decoder);
+        }
+        return nullptr;
+    }
+    SDL_AudioSpec target = { SDL_AUDIO_F32, out.channels, out.freq };
+    if (!resampleOnLoad) {
+        target = in; // compact only
+    }
+    if (compact && !SDL_AUDIO_ISFLOAT(in.format)) {
+        target.format = SDL_AUDIO_S16;
+    }
+    const size_t chunk = 64 * 1024;
+    size_t size = 0, capacity = 4 * chunk;
+    auto data = static_cast<Uint8 *>(SDL_malloc(capacity));
+    int n = 0;
+    while (data) {
+        if (capacity - size < chunk) {
+            capacity *= 2;
+            auto grown = static_cast<Uint8 *>(SDL_realloc(data, capacity));
+            if (!grown) {
+                SDL_free(data);
+                data = nullptr;
+                break;
+            }
+            data = grown;
+        }
+        n = MIX_DecodeAudio(decoder, data + size, (int) chunk, &target);
+        if (n <= 0) {
+            break;
+        }
+        size += n;
+    }
+    MIX_DestroyAudioDecoder(decoder);
+    if (!data || n < 0 || size == 0) {
+        SDL_Log("Failed to decode: %s", SDL_GetError());
+        SDL_free(data);
+        return nullptr;
+    }
+    if (auto fitted = static_cast<Uint8 *>(SDL_realloc(data, size))) {
+        data = fitted; // growth slack back
+    }
+    auto audio = MIX_LoadRawAudioNoCopy(mixer, data, size, &target, true);
+    if (!audio) {
+        SDL_Log("Failed to load converted sound: %s", SDL_GetError());
+        SDL_free(data);
+        return nullptr;
+    }
+    SDL_SetNumberProperty(MIX_GetAudioProperties(audio), sourceRateProp, in.freq);
+    SDL_Log("Converted %d Hz x %d to %d Hz x %d %s in %.1f ms", in.freq, in.channels, target.freq, target.channels,
+        SDL_GetAudioFormatName(target.format), (SDL_GetTicksNS() - start) / 1000000.0);
+    return audio;
+}
+
+MIX_Audio *loadForMixer(MIX_Mixer *mixer, const char *path, SampleStorage storage) {
+    storage = resolveStorage(storage);
+    if (!resampleOnLoad && storage == STORAGE_FLOAT) {
+        return MIX_LoadAudio(mixer, path, true);
+    }
+    auto io = SDL_IOFromFile(path, "rb");
+    if (!io) {
+        SDL_Log("Failed to open %s: %s", path, SDL_GetError());
+        return nullptr;
+    }
+    return loadForMixer(mixer, io, true, storage);
+}
+
+int sourceRate(MIX_Audio *audio) {
+    auto rate = SDL_GetNumberProperty(MIX_GetAudioProperties(audio), sourceRateProp, 0);
+    SDL_AudioSpec spec;
+    if (rate <= 0 && MIX_GetAudioFormat(audio, &spec)) {
+        rate = spec.freq;
+    }
+    return (int) rate;
+}
+
+Sint64 toLoadedFrames(MIX_Audio *audio, Sint64 sourceFrames) {
+    SDL_AudioSpec spec;
+    auto source = sourceRate(audio);
+    if (source <= 0 || !MIX_GetAudioFormat(audio, &spec) || spec.freq == source) {
+        return sourceFrames;
+    }
+    return sourceFrames * spec.freq / source;
+}
+
+size_t decodedBytes(MIX_Audio *audio, bool mapped) {
+    SDL_AudioSpec spec;
+    if (!audio || !MIX_GetAudioFormat(audio, &spec)) {
+        return 0;
+    }
+    auto props = MIX_GetAudioProperties(audio);
+    if (auto encoded = SDL_GetNumberProperty(props, encodedBytesProp, 0)) {
+        return (size_t) encoded;
+    }
+    auto frames = (size_t) std::max<Sint64>(MIX_GetAudioDuration(audio), 0);
+    // converted ones are raw audio in the format they report, plain predecoded ones are kept as floats
+    bool raw = mapped || SDL_HasProperty(props, sourceRateProp);
+    return frames * spec.channels * (raw ? SDL_AUDIO_BYTESIZE(spec.format) : sizeof(float));
+}
+
+bool isEncoded(MIX_Audio *audio) {
+    return audio && SDL_HasProperty(MIX_GetAudioProperties(audio), encodedBytesProp);
+}
@@ -0,0 +1,54 @@
+#ifndef RESAMPLE_HPP
+#define RESAMPLE_HPP
+
+#include "preface.hpp"
+#include <atomic>
+
+// Sounds are converted to the mixer's format when decoded; set from the config
+inline std::atomic<bool> resampleOnLoad = true;
+
+// How a pad keeps its sounds in memory
+enum SampleStorage {
+    STORAGE_DEFAULT, // as storageOnLoad says
+    STORAGE_FLOAT,
+    STORAGE_COMPACT, // 16-bit, unless the source has float samples
+    STORAGE_ENCODED  // the file as it is, decoded as it plays
+};
+
+// Of sounds of pads without a storage of their own; set from the config
+inline std::atomic<SampleStorage> storageOnLoad = STORAGE_FLOAT;
+
+// The storage sounds are loaded with now, never STORAGE_DEFAULT
+SampleStorage resolveStorage(SampleStorage storage);
+
+const char *storageName(SampleStorage storage);
+
+/**
+ * Predecodes the whole stream, converted once to the mixer's output rate,
+ * channels and float samples, so voices mix it as it is instead of resampling
+ * it in the audio callback on every play. Conversion is SDL's band-limited
+ * resampler, run by the decoder on the calling thread; loads are jobs anyway.
+ * Compact storage keeps 16-bit samples instead, half the memory, which the
+ * mixer turns into floats as it reads them with SDL's vectorized converters.
+ * Encoded storage keeps the file's bytes and leaves decoding to the tracks,
+ * each with a decoder of its own, opened when the track is bound to the sound.
+ * Plain MIX_LoadAudio_IO predecoding when turned off or on failure to convert.
+ */
+MIX_Audio *loadForMixer(MIX_Mixer *mixer, SDL_IOStream *io, bool closeio, SampleStorage storage = STORAGE_DEFAULT);
+
+MIX_Audio *loadForMixer(MIX_Mixer *mixer, const char *path, SampleStorage storage = STORAGE_DEFAULT);
+
+// Memory the samples of a loaded sound take; mapped ones are counted as they are stored,
+// encoded ones by the size of the file
+size_t decodedBytes(MIX_Audio *audio, bool mapped);
+
+// Loaded with STORAGE_ENCODED
+bool isEncoded(MIX_Audio *audio);
+
+// Rate of the file the sound was decoded from; frames in profiles count at this rate
+int sourceRate(MIX_Audio *audio);
+
+// Frames at the source rate as frames of the loaded sound
+Sint64 toLoadedFrames(MIX_Audio *audio, Sint64 sourceFrames);
+
+#endif // RESAMPLE_HPP
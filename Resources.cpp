@@ -0,0 +1,168 @@
+#include "Resources.hpp"
+#include "Utils.hpp"
+
+void ResourceReport::add(const std::string &name, SoundPad &pad, bool shown) {
+    ProfileReport profile = {name, shown, pad.loadNS, {}};
+    for (auto &row : pad) {
+        for (auto &p : row) {
+            PadReport r = {p.letter, p.name, p.picturePath, false, p.resources, p.tracksAllocated, p.tracksPlaying};
+            if (p.audio) {
+                r.sharedSound = !seen.insert(p.audio).second;
+                if (!r.sharedSound) {
+                    ++totals.sounds;
+                    (r.res.audioMapped ? totals.mappedBytes : totals.audioBytes) += r.res.audioBytes;
+                    totals.soundLoadNS += r.res.soundLoadNS;
+                }
+            }
+            for (auto &v : p.variants) {
+                if (seen.insert(v.audio).second) {
+                    ++totals.sounds;
+                    (v.mapped ? totals.mappedBytes : totals.audioBytes) += v.bytes;
+                }
+            }
+            if (r.res.pictureBytes > 0) {
+                ++totals.pictures;
+                totals.pictureBytes += r.res.pictureBytes;
+                totals.pictureLoadNS += r.res.pictureLoadNS;
+            }
+            totals.tracksAllocated += r.tracksAllocated;
+            totals.tracksPlaying += r.tracksPlaying;
+            profile.pads.push_back(std::move(r));
+        }
+    }
+    ++totals.profiles;
+    profiles.push_back(std::move(profile));
+}
+
+void ResourceReport::finish() {
+    auto tex = ImGui::GetIO().Fonts->TexData;
+    if (tex) {
+        fontAtlasWidth = tex->Width;
+        fontAtlasHeight = tex->Height;
+        fontAtlasBytes = (size_t) tex->Width * tex->Height * tex->BytesPerPixel;
+    }
+    processKnown = processMemory(process);
+    takenAt = SDL_GetTicksNS();
+}
+
+static std::string ms(Uint64 ns) {
+    char buf[32];
+    SDL_snprintf(buf, sizeof(buf), "%.3f", ns / 1000000.0);
+    return buf;
+}
+
+std::string ResourceReport::json() const {
+    std::string out = "{\n";
+    if (processKnown) {
+        out += "  \"process\": {\"rss\": " + std::to_string(process.rss) + ", \"heap\": " + std::to_string(process.heap) + "},\n";
+    }
+    out += "  \"fontAtlas\": {\"width\": " + std::to_string(fontAtlasWidth) + ", \"height\": " + std::to_string(fontAtlasHeight)
+        + ", \"bytes\": " + std::to_string(fontAtlasBytes) + "},\n";
+    out += "  \"totals\": {\"profiles\": " + std::to_string(totals.profiles)
+        + ", \"sounds\": " + std::to_string(totals.sounds)
+        + ", \"audioBytes\": " + std::to_string(totals.audioBytes)
+        + ", \"mappedBytes\": " + std::to_string(totals.mappedBytes)
+        + ", \"pictures\": " + std::to_string(totals.pictures)
+        + ", \"pictureBytes\": " + std::to_string(totals.pictureBytes)
+        + ", \"tracksAllocated\": " + std::to_string(totals.tracksAllocated)
+        + ", \"tracksPlaying\": " + std::to_string(totals.tracksPlaying)
+        + ", \"soundLoadMs\": " + ms(totals.soundLoadNS)
+        + ", \"pictureLoadMs\": " + ms(totals.pictureLoadNS) + "},\n";
+    out += "  \"profiles\": [";
+    for (size_t i = 0; i < profiles.size(); ++i) {
+        auto &profile = profiles[i];
+        out += i ? ",\n" : "\n";
+        out += "    {\"name\": \"" + jsonEscape(profile.name) + "\", \"shown\": " + (profile.shown ? "true" : "false")
+            + ", \"loadMs\": " + ms(profile.loadNS) + ", \"pads\": [";
+        for (size_t j = 0; j < profile.pads.size(); ++j) {
+            auto &r = profile.pads[j];
+            out += j ? ",\n" : "\n";
+            out += "      {\"letter\": \"" + jsonEscape(std::string(1, r.letter)) + "\"";
+            if (!r.sound.empty()) {
+                out += ", \"sound\": \"" + jsonEscape(r.sound) + "\""
+                    + ", \"frames\": " + std::to_string(r.res.audioFrames)
+                    + ", \"channels\": " + std::to_string(r.res.audioChannels)
+                    + ", \"rate\": " + std::to_string(r.res.audioRate)
+                    + ", \"format\": \"" + SDL_GetAudioFormatName(r.res.audioFormat) + "\""
+                    + ", \"audioBytes\": " + std::to_string(r.res.audioBytes)
+                    + ", \"mapped\": " + (r.res.audioMapped ? "true" : "false")
+                    + ", \"encoded\": " + (r.res.audioEncoded ? "true" : "false")
+                    + ", \"shared\": " + (r.sharedSound ? "true" : "false")
+                    + ", \"variants\": " + std::to_string(r.res.variants)
+                    + ", \"variantBytes\": " + std::to_string(r.res.variantBytes)
+                    + ", \"decodeMs\": " + ms(r.res.soundLoadNS);
+            }
+            out += ", \"tracks\": " + std::to_string(r.tracksAllocated) + ", \"playing\": " + std::to_string(r.tracksPlaying);
+            if (!r.picture.empty()) {
+                out += ", \"picture\": \"" + jsonEscape(r.picture) + "\""
+                    + ", \"width\": " + std::to_string(r.res.pictureWidth)
+                    + ", \"height\": " + std::to_string(r.res.pictureHeight)
+                    + ", \"vramBytes\": " + std::to_string(r.res.pictureBytes)
+                    + ", \"pictureMs\": " + ms(r.res.pictureLoadNS);
+            }
+            out += "}";
+        }
+        out += profile.pads.empty() ? "]}" : "\n    ]}";
+    }
+    out += profiles.empty() ? "]\n}\n" : "\n  ]\n}\n";
+    return out;
+}
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+
+bool processMemory(ProcessMemory &mem) {
+    PROCESS_MEMORY_COUNTERS_EX pmc;
+    // the K32 one lives in kernel32, no psapi.lib needed
+    if (!K32GetProcessMemoryInfo(GetCurrentProcess(), (PROCESS_MEMORY_COUNTERS *) &pmc, sizeof(pmc))) {
+        return false;
+    }
+    mem.rss = pmc.WorkingSetSize;
+    mem.heap = pmc.PrivateUsage;
+    return true;
+}
+
+#elif __APPLE__
+
+#include <mach/mach.h>
+#include <malloc/malloc.h>
+
+bool processMemory(ProcessMemory &mem) {
+    mach_task_basic_info_data_t info;
+    mach_msg_type_number_t count = MACH_TASK_BASIC_INFO_COUNT;
+    if (task_info(mach_task_self(), MACH_TASK_BASIC_INFO, (task_info_t) &info, &count) != KERN_SUCCESS) {
+        return false;
+    }
+    mem.rss = info.resident_size;
+    mem.heap = mstats().bytes_used;
+    return true;
+}
+
+#else // linux
+
+#include <fstream>
+#include <unistd.h>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+bool processMemory(ProcessMemory &mem) {
+    std::ifstream statm("/proc/self/statm");
+    Uint64 size, resident;
+    if (!(statm >> size >> resident)) {
+        return false;
+    }
+    mem.rss = resident * (Uint64) sysconf(_SC_PAGESIZE);
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+    auto mi = mallinfo2();
+    mem.heap = mi.uordblks + mi.hblkhd; // small chunks in use and mmapped big ones
+#else
+    mem.heap = 0;
+#endif
+    return true;
+}
+
+#endif // _WIN32
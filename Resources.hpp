@@ -0,0 +1,74 @@
+#ifndef RESOURCES_HPP
+#define RESOURCES_HPP
+
+#include "preface.hpp"
+#include "Pad.hpp"
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+struct ProcessMemory {
+    Uint64 rss = 0;
+    Uint64 heap = 0; // allocated through malloc, or private commit on Windows
+};
+
+// False where the platform tells nothing
+bool processMemory(ProcessMemory &mem);
+
+struct PadReport {
+    char letter;
+    std::string sound;
+    std::string picture;
+    bool sharedSound; // the decoded sound is counted at another pad already
+    PadResources res;
+    unsigned tracksAllocated;
+    unsigned tracksPlaying;
+};
+
+struct ProfileReport {
+    std::string name;
+    bool shown;
+    Uint64 loadNS;
+    std::vector<PadReport> pads;
+};
+
+struct ResourceTotals {
+    unsigned profiles = 0;
+    unsigned sounds = 0;       // distinct decoded sounds
+    unsigned pictures = 0;
+    size_t audioBytes = 0;     // a shared sound counts once
+    size_t mappedBytes = 0;
+    size_t pictureBytes = 0;
+    unsigned tracksAllocated = 0;
+    unsigned tracksPlaying = 0;
+    Uint64 soundLoadNS = 0;
+    Uint64 pictureLoadNS = 0;
+};
+
+/**
+ * What loaded profiles hold, copied from the counters pads keep on load and
+ * unload; making it scans no audio and no textures.
+ */
+class ResourceReport {
+public:
+    std::vector<ProfileReport> profiles;
+    ResourceTotals totals;
+    int fontAtlasWidth = 0;
+    int fontAtlasHeight = 0;
+    size_t fontAtlasBytes = 0;
+    bool processKnown = false;
+    ProcessMemory process;
+    Uint64 takenAt = 0;
+
+    // The caller keeps the engine off the profile meanwhile
+    void add(const std::string &name, SoundPad &pad, bool shown);
+
+    // Font atlas and process totals
+    void finish();
+
+    std::string json() const;
+private:
+    std::unordered_set<const MIX_Audio *> seen;
+};
+
+#endif // RESOURCES_HPP
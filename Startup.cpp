@@ -0,0 +1,32 @@
+#include "Startup.hpp"
+#include <algorithm>
+#include <cstdio>
+
+void StartupTrace::enable() {
+    on = true;
+    origin = SDL_GetTicksNS();
+    mainThread = SDL_GetCurrentThreadID();
+}
+
+void StartupTrace::phase(const char *name, Uint64 startNS, Uint64 endNS) {
+    std::lock_guard<std::mutex> guard(lock);
+    phases.push_back({name, startNS, endNS, SDL_GetCurrentThreadID() == mainThread});
+}
+
+void StartupTrace::frameReady() {
+    if (!on || reported) {
+        return;
+    }
+    reported = true;
+    auto now = SDL_GetTicksNS();
+    std::lock_guard<std::mutex> guard(lock);
+    std::sort(phases.begin(), phases.end(), [](const Phase &a, const Phase &b) { return a.start < b.start; });
+    printf("Startup trace, ms from start:\n");
+    for (auto &p : phases) {
+        printf("  %-20s %8.1f .. %8.1f  %7.1f  %s\n", p.name,
+            (p.start - origin) / 1000000.0, (p.end - origin) / 1000000.0,
+            (p.end - p.start) / 1000000.0, p.mainThread ? "main" : "worker");
+    }
+    printf("  first frame at %.1f ms\n", (now - origin) / 1000000.0);
+    fflush(stdout);
+}
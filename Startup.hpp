@@ -0,0 +1,59 @@
+#ifndef STARTUP_HPP
+#define STARTUP_HPP
+
+#include "preface.hpp"
+#include <mutex>
+#include <vector>
+
+/**
+ * Wall time of startup phases, printed with --trace-startup once the first
+ * frame is on the screen. Phases may run concurrently on different threads.
+ */
+class StartupTrace {
+public:
+    void enable();
+
+    bool enabled() const {
+        return on;
+    }
+
+    void phase(const char *name, Uint64 startNS, Uint64 endNS);
+
+    // First frame is presented; prints the report once
+    void frameReady();
+private:
+    struct Phase {
+        const char *name;
+        Uint64 start;
+        Uint64 end;
+        bool mainThread;
+    };
+    bool on = false;
+    bool reported = false;
+    Uint64 origin = 0;
+    SDL_ThreadID mainThread = 0;
+    std::mutex lock;
+    std::vector<Phase> phases;
+};
+
+inline StartupTrace startupTrace;
+
+// Records the enclosing scope as a phase
+class StartupPhase {
+public:
+    explicit StartupPhase(const char *name)
+        : name(name)
+        , start(startupTrace.enabled() ? SDL_GetTicksNS() : 0)
+    {
+    }
+    ~StartupPhase() {
+        if (startupTrace.enabled()) {
+            startupTrace.phase(name, start, SDL_GetTicksNS());
+        }
+    }
+private:
+    const char *name;
+    Uint64 start;
+};
+
+#endif // STARTUP_HPP
@@ -0,0 +1,188 @@
+#include "Tiering.hpp"
+#include "AssetStore.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+#include <vector>
+
+// Demoted down to this share of the budget, so playing one pad back doesn't demote another right away
+static const double lowWater = 0.9;
+// Pads nobody asked for are promoted only while they fit under this share
+static const double promoteRoom = 0.8;
+// A promoted pad is kept decoded at least this long
+static const Uint64 keepNS = 30000000000ull;
+static const Uint64 updateNS = 250000000;
+
+static bool isIdle(const Pad &pad) {
+    return pad.state.load() == IDLE;
+}
+
+// What the sound of a demoted pad takes once decoded at its storage
+static size_t decodedEstimate(const Pad &pad) {
+    size_t sample = resolveStorage(pad.storage) == STORAGE_COMPACT ? sizeof(Sint16) : sizeof(float);
+    return (size_t) pad.resources.audioFrames * pad.resources.audioChannels * sample;
+}
+
+static bool canDemote(const Pad &pad) {
+    return pad.audio && !pad.soundKey.empty() && !pad.resources.audioMapped && !pad.resources.audioEncoded
+        && resolveStorage(pad.storage) != STORAGE_ENCODED && isIdle(pad);
+}
+
+void AudioTiering::update(SoundPad *pads, Engine &engine, const Pad *hovered) {
+    if (pads != shown) {
+        shown = pads;
+        seen.clear();
+        wanted.clear();
+        promoted.clear();
+        std::lock_guard<std::mutex> guard(lock);
+        moving.clear();
+    }
+    if (!pads) {
+        return;
+    }
+    auto now = SDL_GetTicksNS();
+    std::lock_guard<std::mutex> padGuard(engine.padLock);
+    if (hovered && hovered->demoted() && !isMoving(hovered)) {
+        // likely to be played next, so it is decoded while the pointer is on its way
+        if (isIdle(*hovered)) {
+            reload(pads, engine, hovered, false, JOB_NOW);
+            wanted.erase(hovered);
+        } else {
+            wanted.insert(hovered);
+        }
+    }
+    if (now - lastUpdate < updateNS) {
+        return;
+    }
+    lastUpdate = now;
+    for (auto it = promoted.begin(); it != promoted.end();) {
+        it = now - it->second > keepNS ? promoted.erase(it) : std::next(it);
+    }
+
+    std::unordered_set<MIX_Audio *> counted; // shared sounds once
+    size_t bytes = 0;
+    unsigned demoted = 0;
+    for (auto &row : *pads) {
+        for (auto &p : row) {
+            auto triggers = p.usage.triggers;
+            auto it = seen.find(&p);
+            if (it != seen.end() && triggers > it->second) {
+                if (p.demoted()) {
+                    counters.misses += triggers - it->second;
+                    wanted.insert(&p);
+                } else {
+                    counters.hits += triggers - it->second;
+                }
+            }
+            seen[&p] = triggers;
+            if (p.audio && !p.resources.audioMapped && counted.insert(p.audio).second) {
+                bytes += p.resources.audioBytes;
+            }
+            bytes += p.resources.variantBytes;
+            demoted += p.demoted() ? 1 : 0;
+        }
+    }
+    counters.bytes = bytes;
+    counters.budget = budget;
+    counters.demoted = demoted;
+
+    // played or hovered ones first, once they are done playing
+    for (auto it = wanted.begin(); it != wanted.end();) {
+        auto pad = *it;
+        if (!pad->demoted()) {
+            it = wanted.erase(it);
+        } else if (isIdle(*pad) && !isMoving(pad)) {
+            reload(pads, engine, pad, false, JOB_NOW);
+            bytes += decodedEstimate(*pad) - std::min(decodedEstimate(*pad), pad->resources.audioBytes);
+            it = wanted.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    std::vector<const Pad *> order;
+    if (budget > 0 && bytes > budget) {
+        for (auto &row : *pads) {
+            for (auto &p : row) {
+                if (canDemote(p) && !promoted.count(&p) && !isMoving(&p)) {
+                    order.push_back(&p);
+                }
+            }
+        }
+        // least recently triggered first, the least played of those
+        std::sort(order.begin(), order.end(), [](const Pad *a, const Pad *b) {
+            if (a->usage.lastTriggered != b->usage.lastTriggered) {
+                return a->usage.lastTriggered < b->usage.lastTriggered;
+            }
+            return a->usage.triggers < b->usage.triggers;
+        });
+        for (auto pad : order) {
+            if (bytes <= budget * lowWater) {
+                break;
+            }
+            auto encoded = (size_t) assetStore.size(pad->soundKey);
+            bytes -= pad->resources.audioBytes - std::min(encoded, pad->resources.audioBytes);
+            reload(pads, engine, pad, true, JOB_BACKGROUND);
+        }
+        return;
+    }
+
+    // the rest while there is room, most played first
+    for (auto &row : *pads) {
+        for (auto &p : row) {
+            if (p.demoted() && isIdle(p) && !isMoving(&p)) {
+                order.push_back(&p);
+            }
+        }
+    }
+    SDL_Time wall = 0;
+    SDL_GetCurrentTime(&wall);
+    wall /= SDL_NS_PER_SECOND;
+    std::sort(order.begin(), order.end(), [wall](const Pad *a, const Pad *b) {
+        return a->usage.score(wall) > b->usage.score(wall);
+    });
+    for (auto pad : order) {
+        auto grown = decodedEstimate(*pad) - std::min(decodedEstimate(*pad), pad->resources.audioBytes);
+        if (budget > 0 && bytes + grown > budget * promoteRoom) {
+            break;
+        }
+        bytes += grown;
+        reload(pads, engine, pad, false, JOB_BACKGROUND);
+    }
+}
+
+void AudioTiering::reload(SoundPad *pads, Engine &engine, const Pad *pad, bool encoded, JobPriority priority) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        moving[pad] = encoded;
+    }
+    if (encoded) {
+        ++counters.demotions;
+    } else {
+        ++counters.promotions;
+        promoted[pad] = SDL_GetTicksNS();
+    }
+    auto storage = encoded ? STORAGE_ENCODED : pad->storage;
+    jobs.run(priority, [this, pads, &engine, pad, mixer = pad->mixer, letter = pad->letter, key = pad->soundKey,
+                        name = pad->name, storage]() {
+        TraceSpan span("io", storage == STORAGE_ENCODED ? "demote" : "promote", letter);
+        auto audio = assetStore.acquireAudio(key, mixer, storage);
+        if (!audio || !engine.assign(pads, letter, audio, key, name)) {
+            SDL_Log("Failed to reload sound on pad %c", letter);
+            std::lock_guard<std::mutex> guard(lock);
+            moving.erase(pad);
+        }
+    });
+}
+
+bool AudioTiering::isMoving(const Pad *pad) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = moving.find(pad);
+    if (it == moving.end()) {
+        return false;
+    }
+    if (pad->resources.audioEncoded == it->second) {
+        moving.erase(it); // applied
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef TIERING_HPP
+#define TIERING_HPP
+
+#include "preface.hpp"
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include "Engine.hpp"
+#include "Jobs.hpp"
+#include "Pad.hpp"
+
+struct TieringStats {
+    Uint64 promotions = 0;
+    Uint64 demotions = 0;
+    Uint64 hits = 0;   // triggers of pads holding their decoded sound
+    Uint64 misses = 0; // triggers of demoted pads, played from the encoded file
+    size_t bytes = 0;  // decoded sound of the shown profile, as of the last update
+    size_t budget = 0; // 0 for none
+    unsigned demoted = 0;
+};
+
+/**
+ * Keeps the decoded sound of the shown profile within a budget. Past it, the
+ * idle pads triggered longest ago are loaded again as encoded files, which
+ * tracks decode as they play, down to a little under the budget. A demoted
+ * pad gets its own storage back once it is triggered or hovered and idle, or
+ * whenever there is room. Sounds are swapped by the engine like any other
+ * assignment, and only pads with stored sounds take part; a sound shared with
+ * other pads is freed once none of them holds it. Warm profiles are left to
+ * the warm cache.
+ */
+class AudioTiering {
+public:
+    // UI thread, 0 for none
+    void setBudget(size_t bytes) {
+        budget = bytes;
+    }
+
+    // UI thread, every frame; does the work a few times a second, the hovered pad right away
+    void update(SoundPad *pads, Engine &engine, const Pad *hovered);
+
+    // UI thread
+    const TieringStats &stats() const {
+        return counters;
+    }
+private:
+    size_t budget = 0;
+    SoundPad *shown = nullptr;
+    Uint64 lastUpdate = 0;
+    TieringStats counters;
+    std::unordered_map<const Pad *, Uint32> seen;    // triggers as of the last update
+    std::unordered_set<const Pad *> wanted;          // demoted, and triggered or hovered since
+    std::unordered_map<const Pad *, Uint64> promoted; // when, they aren't demoted again right away
+
+    std::mutex lock;
+    std::unordered_map<const Pad *, bool> moving; // being loaded again, to encoded or not
+
+    // Caller holds padLock; the engine swaps the sound in, at the pad's storage or encoded
+    void reload(SoundPad *pads, Engine &engine, const Pad *pad, bool encoded, JobPriority priority);
+    // Caller holds padLock; drops moves the engine has applied
+    bool isMoving(const Pad *pad);
+};
+
+#endif // TIERING_HPP
@@ -0,0 +1,201 @@
+#include "Trace.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+
+Tracer::~Tracer() {
+    for (auto r : rings) {
+        delete r;
+    }
+}
+
+Tracer::Ring *Tracer::ownRing() {
+    static thread_local Ring *currentRing = nullptr; // made on the first event of the thread
+    if (!currentRing) {
+        auto r = new Ring();
+        r->thread = "thread " + std::to_string((unsigned long long) SDL_GetCurrentThreadID());
+        std::lock_guard<std::mutex> guard(lock);
+        rings.push_back(r);
+        currentRing = r;
+    }
+    return currentRing;
+}
+
+void Tracer::nameThread(const std::string &name) {
+    auto r = ownRing();
+    std::lock_guard<std::mutex> guard(lock);
+    r->thread = name;
+}
+
+void Tracer::record(const TraceEvent &event) {
+    auto r = ownRing();
+    auto head = r->head.load(std::memory_order_relaxed);
+    r->events[head % capacity] = event;
+    r->head.store(head + 1, std::memory_order_release);
+}
+
+void Tracer::span(const char *category, const char *name, Uint64 startNS, Uint64 endNS, char letter, const char *detail) {
+    if (!enabled()) {
+        return;
+    }
+    TraceEvent e;
+    e.start = startNS;
+    e.dur = endNS > startNS ? endNS - startNS : 0;
+    e.category = category;
+    e.name = name;
+    e.letter = letter;
+    e.detail = detail;
+    record(e);
+}
+
+void Tracer::instant(const char *category, const char *name, char letter, const char *detail) {
+    if (!enabled()) {
+        return;
+    }
+    TraceEvent e;
+    e.start = SDL_GetTicksNS();
+    e.category = category;
+    e.name = name;
+    e.letter = letter;
+    e.detail = detail;
+    e.instant = true;
+    record(e);
+}
+
+void Tracer::started(Uint32 flow, char letter, const char *detail) {
+    if (flow) {
+        playing.push({flow, letter, detail}); // a full queue only loses the arrow
+    }
+}
+
+void Tracer::mixed(int frames, int rate) {
+    if (!enabled()) {
+        return;
+    }
+    TraceEvent block;
+    block.start = SDL_GetTicksNS();
+    block.dur = rate > 0 ? (Uint64) frames * 1000000000 / rate : 0;
+    block.category = "audio";
+    block.name = "block";
+    block.valueName = "frames";
+    block.value = frames;
+    record(block);
+    Started s;
+    while (playing.pop(s)) {
+        // nested in the block, where the arrow from the command ends
+        TraceEvent e;
+        e.start = block.start;
+        e.category = "audio";
+        e.name = "play";
+        e.letter = s.letter;
+        e.detail = s.detail;
+        e.flow = s.flow;
+        e.flowPhase = 'f';
+        record(e);
+    }
+}
+
+void Tracer::setDirectory(const std::filesystem::path &dir) {
+    std::lock_guard<std::mutex> guard(lock);
+    this->dir = dir;
+}
+
+static void appendTime(std::string &out, const char *key, Uint64 ns) {
+    char buf[48];
+    SDL_snprintf(buf, sizeof(buf), ",\"%s\":%llu.%03u", key, (unsigned long long) (ns / 1000), (unsigned) (ns % 1000));
+    out += buf;
+}
+
+std::string Tracer::json() {
+    std::vector<std::pair<std::string, std::vector<TraceEvent> > > threads;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        for (auto r : rings) {
+            auto end = r->head.load(std::memory_order_acquire);
+            auto begin = end > capacity ? end - capacity : 0;
+            std::vector<TraceEvent> events;
+            events.reserve(end - begin);
+            for (auto i = begin; i < end; ++i) {
+                events.push_back(r->events[i % capacity]);
+            }
+            // the owner kept writing meanwhile; the oldest slots may have been overwritten
+            std::atomic_thread_fence(std::memory_order_acquire);
+            auto now = r->head.load(std::memory_order_relaxed);
+            if (now + 1 > begin + capacity) {
+                auto torn = std::min<Uint64>(now + 1 - capacity - begin, events.size());
+                events.erase(events.begin(), events.begin() + torn);
+            }
+            threads.emplace_back(r->thread, std::move(events));
+        }
+    }
+    std::string out = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    out += "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"soundpad\"}}";
+    for (size_t t = 0; t < threads.size(); ++t) {
+        auto tid = std::to_string(t + 1);
+        out += ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + tid
+            + ",\"args\":{\"name\":\"" + jsonEscape(threads[t].first) + "\"}}";
+        for (auto &e : threads[t].second) {
+            out += ",\n{\"name\":\"" + jsonEscape(e.name) + "\",\"cat\":\"" + jsonEscape(e.category) + "\"";
+            out += e.instant ? ",\"ph\":\"i\",\"s\":\"t\"" : ",\"ph\":\"X\"";
+            appendTime(out, "ts", e.start);
+            if (!e.instant) {
+                appendTime(out, "dur", e.dur);
+            }
+            out += ",\"pid\":1,\"tid\":" + tid + ",\"args\":{";
+            const char *sep = "";
+            if (e.letter) {
+                out += "\"pad\":\"" + jsonEscape(std::string(1, e.letter)) + "\"";
+                sep = ",";
+            }
+            if (e.detail) {
+                out += sep + std::string("\"detail\":\"") + jsonEscape(e.detail) + "\"";
+                sep = ",";
+            }
+            if (e.valueName) {
+                out += sep + std::string("\"") + jsonEscape(e.valueName) + "\":" + std::to_string(e.value);
+                sep = ",";
+            }
+            if (e.flow) {
+                out += sep + std::string("\"flow\":") + std::to_string(e.flow);
+            }
+            out += "}}";
+            if (e.flowPhase) {
+                // binds to the event above, which encloses its timestamp
+                out += ",\n{\"name\":\"command\",\"cat\":\"flow\",\"ph\":\"" + std::string(1, e.flowPhase)
+                    + "\",\"bp\":\"e\",\"id\":" + std::to_string(e.flow);
+                appendTime(out, "ts", e.start);
+                out += ",\"pid\":1,\"tid\":" + tid + "}";
+            }
+        }
+    }
+    out += "\n]}\n";
+    return out;
+}
+
+bool Tracer::dump(const std::filesystem::path &path) {
+    auto start = SDL_GetTicksNS();
+    if (!writeFileAtomic(path, json())) {
+        SDL_Log("Failed to write trace %s", path.u8string().c_str());
+        return false;
+    }
+    SDL_Log("Trace written to %s in %.1f ms", path.u8string().c_str(), (SDL_GetTicksNS() - start) / 1000000.0);
+    return true;
+}
+
+std::filesystem::path Tracer::save() {
+    std::filesystem::path target;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        target = dir;
+    }
+    SDL_Time now = 0;
+    SDL_DateTime dt = {};
+    SDL_GetCurrentTime(&now);
+    SDL_TimeToDateTime(now, &dt, true);
+    char name[64];
+    SDL_snprintf(name, sizeof(name), "trace-%04d%02d%02d-%02d%02d%02d-%03d.json", dt.year, dt.month, dt.day,
+        dt.hour, dt.minute, dt.second, dt.nanosecond / 1000000);
+    std::error_code ec;
+    std::filesystem::create_directories(target, ec);
+    target /= name;
+    return dump(target) ? target : std::filesystem::path();
+}
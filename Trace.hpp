@@ -0,0 +1,137 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include "preface.hpp"
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Queue.hpp"
+
+// Strings must outlive the tracer: literals, request or priority names
+struct TraceEvent {
+    Uint64 start = 0;            // SDL_GetTicksNS()
+    Uint64 dur = 0;              // 0 for instants
+    const char *category = nullptr;
+    const char *name = nullptr;
+    const char *detail = nullptr;    // request type, job priority; may be nullptr
+    const char *valueName = nullptr; // what `value` is, nullptr if unused
+    Uint32 value = 0;
+    Uint32 flow = 0;             // id of the command the event belongs to, 0 if none
+    char flowPhase = 0;          // 's'tarts, 't' continues or 'f'inishes the flow
+    char letter = 0;             // pad, 0 if none
+    bool instant = false;
+};
+
+/**
+ * Recorder of what every thread did lately, cheap enough to stay on: each
+ * thread appends to its own ring without locks or allocations, and old events
+ * are overwritten. A dump copies the rings into Chrome trace JSON, which
+ * chrome://tracing and ui.perfetto.dev open.
+ * Commands get a flow id when submitted; it links the key or socket line,
+ * the engine applying it and the mixer block the sound started in.
+ */
+class Tracer {
+public:
+    // Events kept per thread
+    static const unsigned capacity = 4096;
+
+    ~Tracer();
+
+    void enable(bool on) {
+        this->on = on;
+    }
+
+    bool enabled() const {
+        return on.load(std::memory_order_relaxed);
+    }
+
+    // Name of the calling thread in dumps
+    void nameThread(const std::string &name);
+
+    void record(const TraceEvent &event);
+
+    void span(const char *category, const char *name, Uint64 startNS, Uint64 endNS, char letter = 0,
+              const char *detail = nullptr);
+
+    void instant(const char *category, const char *name, char letter = 0, const char *detail = nullptr);
+
+    // Id for a new flow, 0 while disabled
+    Uint32 newFlow() {
+        return enabled() ? ++flows : 0;
+    }
+
+    // A track started playing for the flow; the arrow ends in the next mixed block
+    void started(Uint32 flow, char letter, const char *detail);
+
+    // Mixer thread, once per mixed block
+    void mixed(int frames, int rate);
+
+    // Where save() puts dumps
+    void setDirectory(const std::filesystem::path &dir);
+
+    std::string json();
+
+    bool dump(const std::filesystem::path &path);
+
+    // Dumps into the directory under a timestamped name, returns the path or empty on failure
+    std::filesystem::path save();
+private:
+    struct Ring {
+        std::string thread;
+        std::atomic<Uint64> head = 0; // events ever written
+        TraceEvent events[capacity];
+    };
+
+    struct Started {
+        Uint32 flow;
+        char letter;
+        const char *detail;
+    };
+
+    std::atomic<bool> on = true;
+    std::atomic<Uint32> flows = 0;
+    std::mutex lock;
+    std::vector<Ring *> rings; // outlive their threads, so finished work still shows
+    std::filesystem::path dir;
+    BoundedQueue<Started> playing = BoundedQueue<Started>(256);
+
+    Ring *ownRing();
+};
+
+inline Tracer tracer;
+
+// Records the enclosing scope as a span; fields of `event` may be filled in on the way
+class TraceSpan {
+public:
+    TraceSpan(const char *category, const char *name, char letter = 0, const char *detail = nullptr) {
+        if (tracer.enabled()) {
+            event.start = SDL_GetTicksNS();
+            event.category = category;
+            event.name = name;
+            event.letter = letter;
+            event.detail = detail;
+        }
+    }
+    ~TraceSpan() {
+        if (event.start) {
+            event.dur = SDL_GetTicksNS() - event.start;
+            tracer.record(event);
+        }
+    }
+
+    void flow(Uint32 id, char phase) {
+        event.flow = id;
+        event.flowPhase = id ? phase : 0;
+    }
+
+    void value(const char *name, Uint32 v) {
+        event.valueName = name;
+        event.value = v;
+    }
+
+    TraceEvent event;
+};
+
+#endif // TRACE_HPP
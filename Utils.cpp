@@ -1,4 +1,6 @@
 #include "Utils.hpp"
+#include <cctype>
+#include <fstream>
 
 ImGuiKey ImGuiKeyFromChar(char c) {
     if (c >= 'a' && c <= 'z') {
@@ -9,4 +11,123 @@ ImGuiKey ImGuiKeyFromChar(char c) {
         return (ImGuiKey)(ImGuiKey_0 + (c - '0'));
     }
     return ImGuiKey_None;
-}
\ No newline at end of file
+}
+
+std::string lowercase(const std::string &s) {
+    std::string res(s);
+    for (auto &c : res) {
+        c = tolower((unsigned char) c);
+    }
+    return res;
+}
+
+std::string jsonEscape(const std::string &s) {
+    std::string res;
+    res.reserve(s.size());
+    for (char c : s) {
+        switch (c) {
+        case '"':
+            res += "\\\"";
+            break;
+        case '\\':
+            res += "\\\\";
+            break;
+        case '\n':
+            res += "\\n";
+            break;
+        case '\r':
+            res += "\\r";
+            break;
+        case '\t':
+            res += "\\t";
+            break;
+        default:
+            if ((unsigned char) c < 0x20) {
+                char buf[8];
+                SDL_snprintf(buf, sizeof(buf), "\\u%04x", (unsigned) c);
+                res += buf;
+            } else {
+                res += c; // UTF-8 goes as is
+            }
+        }
+    }
+    return res;
+}
+
+int fuzzyScore(const std::string &key, const std::string &query) {
+    int score = 0;
+    size_t k = 0;
+    size_t prev = std::string::npos;
+    for (auto q : query) {
+        while (k < key.size() && key[k] != q) ++k;
+        if (k == key.size()) {
+            return -1;
+        }
+        if (prev != std::string::npos && k == prev + 1) {
+            score += 5;
+        } else if (k == 0 || !isalnum((unsigned char) key[k - 1])) {
+            score += 3;
+        } else {
+            score += 1;
+        }
+        prev = k++;
+    }
+    return score;
+}
+
+#ifdef _WIN32
+
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+
+bool syncFile(const std::filesystem::path &path) {
+    HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+    bool ok = FlushFileBuffers(file);
+    CloseHandle(file);
+    return ok;
+}
+
+#else // posix
+
+#include <fcntl.h>
+#include <unistd.h>
+
+bool syncFile(const std::filesystem::path &path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = fsync(fd) == 0;
+    close(fd);
+    return ok;
+}
+
+#endif // _WIN32
+
+bool writeFileAtomic(const std::filesystem::path &path, const std::string &data) {
+    auto tmp = path;
+    tmp += ".tmp";
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        SDL_Log("Failed to open %s for writing", tmp.u8string().c_str());
+        return false;
+    }
+    out.write(data.data(), data.size());
+    out.close();
+    std::error_code ec;
+    if (out.fail() || !syncFile(tmp)) {
+        SDL_Log("Failed to write %s", tmp.u8string().c_str());
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    std::filesystem::rename(tmp, path, ec);
+    if (ec) {
+        SDL_Log("Failed to replace %s: %s", path.u8string().c_str(), ec.message().c_str());
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+    return true;
+}
@@ -1,3 +1,21 @@
 #include "preface.hpp"
+#include <filesystem>
+#include <string>
 
-ImGuiKey ImGuiKeyFromChar(char c);
\ No newline at end of file
+ImGuiKey ImGuiKeyFromChar(char c);
+
+std::string lowercase(const std::string &s);
+
+// Contents of a JSON string literal, without the quotes
+std::string jsonEscape(const std::string &s);
+
+// Subsequence match of a lowercase query, -1 if some char is missing;
+// runs and word starts weigh more
+int fuzzyScore(const std::string &key, const std::string &query);
+
+// Flushes file contents to the disk
+bool syncFile(const std::filesystem::path &path);
+
+// Writes to a temporary file, syncs it and renames it over the target,
+// so a crash leaves either the old or the new contents
+bool writeFileAtomic(const std::filesystem::path &path, const std::string &data);
\ No newline at end of file
@@ -0,0 +1,55 @@
+#include "Waveform.hpp"
+#include "Jobs.hpp"
+#include "Resample.hpp"
+#include "Trace.hpp"
+#include <algorithm>
+
+WaveformPtr buildWaveform(MIX_Audio *audio, unsigned columns) {
+    auto wave = std::make_shared<Waveform>();
+    wave->source = audio;
+    SDL_AudioSpec spec;
+    if (!audio || columns == 0 || !MIX_GetAudioFormat(audio, &spec) || (wave->frames = MIX_GetAudioDuration(audio)) <= 0) {
+        wave->frames = 0;
+        wave->ready = true;
+        return wave;
+    }
+    // counted in source frames, as slices are
+    wave->rate = sourceRate(audio);
+    auto loadedFrames = wave->frames;
+    wave->frames = loadedFrames * wave->rate / spec.freq;
+    SDL_AudioSpec f32 = { SDL_AUDIO_F32, spec.channels, spec.freq };
+    auto offline = MIX_CreateMixer(&f32);
+    auto track = offline ? MIX_CreateTrack(offline) : nullptr;
+    if (!track || !MIX_SetTrackAudio(track, audio) || !MIX_PlayTrack(track, 0)) {
+        SDL_Log("Failed to read the waveform: %s", SDL_GetError());
+        if (offline) {
+            MIX_DestroyMixer(offline); // takes its tracks along
+        }
+        wave->frames = 0;
+        wave->ready = true;
+        return wave;
+    }
+    jobs.run(JOB_BACKGROUND, [wave, offline, columns, loadedFrames, channels = spec.channels]() {
+        TraceSpan span("ui", "waveform");
+        wave->low.assign(columns, 0.f);
+        wave->high.assign(columns, 0.f);
+        auto perColumn = std::max<Sint64>((loadedFrames + columns - 1) / columns, 1);
+        std::vector<float> buf(4096 * channels);
+        for (Sint64 done = 0; done < loadedFrames;) {
+            auto frames = (int) std::min<Sint64>(4096, loadedFrames - done);
+            MIX_Generate(offline, buf.data(), frames * channels * (int) sizeof(float));
+            for (int f = 0; f < frames; ++f) {
+                auto c = (size_t) std::min<Sint64>((done + f) / perColumn, columns - 1);
+                for (int ch = 0; ch < channels; ++ch) {
+                    auto v = buf[(size_t) f * channels + ch];
+                    wave->low[c] = std::min(wave->low[c], v);
+                    wave->high[c] = std::max(wave->high[c], v);
+                }
+            }
+            done += frames;
+        }
+        MIX_DestroyMixer(offline);
+        wave->ready = true;
+    });
+    return wave;
+}
@@ -0,0 +1,28 @@
+#ifndef WAVEFORM_HPP
+#define WAVEFORM_HPP
+
+#include "preface.hpp"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+// Lowest and highest sample per column of a sound, for drawing it
+struct Waveform {
+    const MIX_Audio *source = nullptr; // only compared, it may be gone
+    Sint64 frames = 0;
+    int rate = 0;
+    std::vector<float> low;
+    std::vector<float> high;
+    std::atomic<bool> ready = false;   // the rest is written by a job until then
+};
+
+typedef std::shared_ptr<Waveform> WaveformPtr;
+
+/**
+ * Plays the decoded sound through a mixer of its own format without a device,
+ * so the shared samples are read as they are, and nothing is decoded again.
+ * The track is bound here, so the sound may be unloaded while the job runs.
+ */
+WaveformPtr buildWaveform(MIX_Audio *audio, unsigned columns);
+
+#endif // WAVEFORM_HPP
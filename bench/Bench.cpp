@@ -0,0 +1,226 @@
+#include "Bench.hpp"
+#include "Utils.hpp"
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+
+double BenchResult::percentile(double part) const {
+    if (samples.empty()) {
+        return 0;
+    }
+    auto sorted = samples;
+    std::sort(sorted.begin(), sorted.end());
+    auto index = (size_t) std::min(part * (sorted.size() - 1) + 0.5, (double) sorted.size() - 1);
+    return sorted[index];
+}
+
+bool Bench::enabled(const std::string &name) const {
+    return filter.empty() || name.find(filter) != std::string::npos;
+}
+
+BenchResult *Bench::measure(const std::string &name, unsigned opsPerCall, const std::function<void()> &fn,
+                            const std::function<void()> &setup) {
+    if (!enabled(name)) {
+        return nullptr;
+    }
+    BenchResult res;
+    res.name = name;
+    auto timeCalls = [&](unsigned calls) {
+        Uint64 ns = 0;
+        if (setup) {
+            for (unsigned i = 0; i < calls; ++i) {
+                setup();
+                auto start = SDL_GetTicksNS();
+                fn();
+                ns += SDL_GetTicksNS() - start;
+            }
+        } else {
+            auto start = SDL_GetTicksNS();
+            for (unsigned i = 0; i < calls; ++i) {
+                fn();
+            }
+            ns = SDL_GetTicksNS() - start;
+        }
+        return ns;
+    };
+    // the first call warms caches up and tells how big a batch should be
+    unsigned batch = 1;
+    for (auto ns = timeCalls(1); ns < 1000000 && batch < (1u << 20); ns = timeCalls(batch)) {
+        batch *= ns < 100000 ? 8 : 2;
+    }
+    auto start = SDL_GetTicksNS();
+    while ((SDL_GetTicksNS() - start < caseNS || res.samples.size() < 3) && res.samples.size() < 10000) {
+        auto ns = timeCalls(batch);
+        res.samples.push_back((double) ns / ((double) batch * opsPerCall));
+        res.ops += (Uint64) batch * opsPerCall;
+    }
+    return add(std::move(res));
+}
+
+BenchResult *Bench::record(const std::string &name, const std::vector<double> &samplesNS, Uint64 ops) {
+    if (!enabled(name)) {
+        return nullptr;
+    }
+    BenchResult res;
+    res.name = name;
+    res.samples = samplesNS;
+    res.ops = ops;
+    return add(std::move(res));
+}
+
+BenchResult *Bench::values(const std::string &name) {
+    if (!enabled(name)) {
+        return nullptr;
+    }
+    BenchResult res;
+    res.name = name;
+    return add(std::move(res));
+}
+
+// Progress goes to stderr, metrics are only in the JSON
+BenchResult *Bench::add(BenchResult &&result) {
+    results.push_back(std::move(result));
+    auto &r = results.back();
+    if (!r.samples.empty()) {
+        fprintf(stderr, "%-36s %12.1f ns/op  p90 %12.1f  (%llu ops)\n", r.name.c_str(), r.percentile(0.5),
+            r.percentile(0.9), (unsigned long long) r.ops);
+    } else {
+        fprintf(stderr, "%-36s\n", r.name.c_str());
+    }
+    return &r;
+}
+
+static std::string number(double value) {
+    if (!std::isfinite(value)) {
+        return "null";
+    }
+    char buf[32];
+    SDL_snprintf(buf, sizeof(buf), "%.6g", value);
+    return buf;
+}
+
+std::string Bench::json() const {
+#if defined(__clang__)
+    std::string compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+    std::string compiler = "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    std::string compiler = "msvc " + std::to_string(_MSC_VER);
+#else
+    std::string compiler = "unknown";
+#endif
+#ifdef NDEBUG
+    const char *build = "release";
+#else
+    const char *build = "debug";
+#endif
+    std::string out = "{\n";
+    out += "  \"soundpad\": \"" SOUNDPAD_VERSION "\",\n";
+    out += "  \"label\": \"" + jsonEscape(label) + "\",\n";
+    out += "  \"time\": " + std::to_string((long long) std::time(nullptr)) + ",\n";
+    out += "  \"platform\": \"" + jsonEscape(SDL_GetPlatform()) + "\",\n";
+    out += "  \"cpus\": " + std::to_string(SDL_GetNumLogicalCPUCores()) + ",\n";
+    out += "  \"compiler\": \"" + jsonEscape(compiler) + "\",\n";
+    out += "  \"build\": \"" + std::string(build) + "\",\n";
+    out += "  \"results\": [";
+    for (size_t i = 0; i < results.size(); ++i) {
+        auto &r = results[i];
+        out += i ? ",\n" : "\n";
+        out += "    {\"name\": \"" + jsonEscape(r.name) + "\"";
+        if (!r.samples.empty()) {
+            double sum = 0;
+            for (auto s : r.samples) {
+                sum += s;
+            }
+            out += ", \"ops\": " + std::to_string(r.ops) + ", \"samples\": " + std::to_string(r.samples.size())
+                + ", \"nsPerOp\": {\"min\": " + number(r.percentile(0)) + ", \"median\": " + number(r.percentile(0.5))
+                + ", \"mean\": " + number(sum / r.samples.size()) + ", \"p90\": " + number(r.percentile(0.9))
+                + ", \"p99\": " + number(r.percentile(0.99)) + ", \"max\": " + number(r.percentile(1)) + "}";
+        }
+        if (!r.metrics.empty()) {
+            out += ", \"metrics\": {";
+            for (size_t j = 0; j < r.metrics.size(); ++j) {
+                out += (j ? ", \"" : "\"") + jsonEscape(r.metrics[j].first) + "\": " + number(r.metrics[j].second);
+            }
+            out += "}";
+        }
+        out += "}";
+    }
+    out += results.empty() ? "]\n}\n" : "\n  ]\n}\n";
+    return out;
+}
+
+static void put16(std::string &out, Uint16 v) {
+    out += (char) (v & 0xff);
+    out += (char) (v >> 8);
+}
+
+static void put32(std::string &out, Uint32 v) {
+    put16(out, v & 0xffff);
+    put16(out, v >> 16);
+}
+
+std::string makeWav(unsigned frames, int channels, int rate, bool floats) {
+    int sampleBytes = floats ? 4 : 2;
+    Uint32 dataBytes = frames * channels * sampleBytes;
+    std::string out;
+    out.reserve(44 + dataBytes);
+    out += "RIFF";
+    put32(out, 36 + dataBytes);
+    out += "WAVEfmt ";
+    put32(out, 16);
+    put16(out, floats ? 3 : 1); // IEEE float or PCM
+    put16(out, channels);
+    put32(out, rate);
+    put32(out, rate * channels * sampleBytes);
+    put16(out, channels * sampleBytes);
+    put16(out, sampleBytes * 8);
+    out += "data";
+    put32(out, dataBytes);
+    Uint32 noise = 0x12345678;
+    for (unsigned f = 0; f < frames; ++f) {
+        for (int c = 0; c < channels; ++c) {
+            noise = noise * 1664525 + 1013904223;
+            float v = 0.5f * std::sin(6.2831853f * 440.f * (c + 1) * f / rate) + 0.05f * ((noise >> 8) / 16777216.f - 0.5f);
+            if (floats) {
+                Uint32 bits;
+                SDL_memcpy(&bits, &v, 4);
+                put32(out, bits);
+            } else {
+                put16(out, (Uint16) (Sint16) (v * 32767));
+            }
+        }
+    }
+    return out;
+}
+
+std::filesystem::path makeProfile(const std::filesystem::path &dir, const std::string &name,
+                                  const std::vector<std::string> &layout, unsigned soundFrames) {
+    auto path = dir / (name + ".cfg");
+    auto assets = dir / name;
+    std::string text;
+    for (auto &row : layout) {
+        text += row + "\n";
+    }
+    text += "\n";
+    if (soundFrames > 0) {
+        std::filesystem::create_directories(assets);
+    }
+    unsigned n = 0;
+    for (auto &row : layout) {
+        for (char c : row) {
+            std::string sound;
+            if (soundFrames > 0) {
+                sound = std::string("s") + c + ".wav";
+                std::ofstream out(assets / sound, std::ios::binary);
+                auto wav = makeWav(soundFrames + 64 * n++, 2, 48000, false); // contents differ, so nothing is shared
+                out.write(wav.data(), wav.size());
+            }
+            text += std::string(1, c) + " " + sound + "\norlnhnnnopsnnnnn\n1\npic \n\n";
+        }
+    }
+    std::ofstream out(path, std::ios::binary);
+    out << text;
+    return path;
+}
@@ -0,0 +1,86 @@
+#ifndef BENCH_HPP
+#define BENCH_HPP
+
+#include "preface.hpp"
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct BenchResult {
+    std::string name;
+    Uint64 ops = 0;
+    std::vector<double> samples; // ns per op, one per timed batch
+    std::vector<std::pair<std::string, double> > metrics; // named extras: bytes, rates, latencies
+
+    BenchResult &metric(const std::string &key, double value) {
+        metrics.emplace_back(key, value);
+        return *this;
+    }
+
+    // Of the samples, part in 0..1
+    double percentile(double part) const;
+};
+
+/**
+ * Runs cases matching the filter and collects their results. A case is timed
+ * in batches: the batch grows until it takes a millisecond or so, then
+ * batches are repeated until the time per case is spent, so short and long
+ * cases both get enough samples.
+ */
+class Bench {
+public:
+    std::string filter;  // substring of case names, empty runs all
+    Uint64 caseNS = 300000000;
+    std::string label;   // free text, e.g. a commit, to tell runs apart
+
+    bool enabled(const std::string &name) const;
+
+    // fn does `opsPerCall` operations; setup runs before every call, untimed
+    BenchResult *measure(const std::string &name, unsigned opsPerCall, const std::function<void()> &fn,
+        const std::function<void()> &setup = nullptr);
+
+    // For cases which time themselves, e.g. latencies seen by another thread
+    BenchResult *record(const std::string &name, const std::vector<double> &samplesNS, Uint64 ops);
+
+    // Values only, no timing
+    BenchResult *values(const std::string &name);
+
+    std::string json() const;
+private:
+    std::vector<BenchResult> results;
+
+    BenchResult *add(BenchResult &&result);
+};
+
+// What every suite gets
+struct BenchEnv {
+    std::filesystem::path tmp;   // scratch dir, removed at exit
+    std::filesystem::path media; // user given sound files, empty if none
+};
+
+// Fixtures
+
+// RIFF WAVE of a sine with some noise; float32 or int16 samples
+std::string makeWav(unsigned frames, int channels, int rate, bool floats);
+
+// .cfg profile with the layout (rows of pad letters) and a sound file per pad in its sibling dir, if soundFrames > 0
+std::filesystem::path makeProfile(const std::filesystem::path &dir, const std::string &name,
+    const std::vector<std::string> &layout, unsigned soundFrames);
+
+// Suites
+
+void benchProfiles(Bench &bench, const BenchEnv &env);
+
+void benchAudio(Bench &bench, const BenchEnv &env);
+
+void benchEngine(Bench &bench, const BenchEnv &env);
+
+void benchFrame(Bench &bench, const BenchEnv &env);
+
+void benchDsp(Bench &bench, const BenchEnv &env);
+
+void benchLibrary(Bench &bench, const BenchEnv &env);
+
+#endif // BENCH_HPP
@@ -0,0 +1,152 @@
+#include "Bench.hpp"
+#include "Resample.hpp"
+#include <vector>
+#include "Utils.hpp"
+
+// Predecodes from memory, so the disk doesn't count
+static void decodeCase(Bench &bench, const std::string &name, const void *data, size_t size) {
+    if (!bench.enabled(name)) {
+        return;
+    }
+    auto probe = MIX_LoadAudio_IO(mixer, SDL_IOFromConstMem(data, size), true, true);
+    if (!probe) {
+        fprintf(stderr, "%s: can't decode: %s\n", name.c_str(), SDL_GetError());
+        return;
+    }
+    SDL_AudioSpec spec;
+    double seconds = 0;
+    if (MIX_GetAudioFormat(probe, &spec) && spec.freq > 0) {
+        seconds = (double) MIX_GetAudioDuration(probe) / spec.freq;
+    }
+    MIX_DestroyAudio(probe);
+    auto r = bench.measure(name, 1, [&]() {
+        MIX_DestroyAudio(MIX_LoadAudio_IO(mixer, SDL_IOFromConstMem(data, size), true, true));
+    });
+    auto ns = r->percentile(0.5);
+    r->metric("inputBytes", size).metric("audioSeconds", seconds)
+        .metric("inputMBps", size / ns * 1000.0).metric("realtime", seconds / (ns / 1e9));
+}
+
+// What loading costs when the sound is converted to the 48 kHz mixer on the way
+static void convertCase(Bench &bench, const std::string &name, const void *data, size_t size) {
+    if (auto r = bench.measure(name, 1, [&]() {
+        MIX_DestroyAudio(loadForMixer(mixer, SDL_IOFromConstMem(data, size), true));
+    })) {
+        r->metric("inputBytes", size).metric("inputMBps", size / r->percentile(0.5) * 1000.0);
+    }
+}
+
+// 32 looping voices of one sound on the 48 kHz mixer
+static void voicesCase(Bench &bench, const std::string &name, MIX_Audio *audio) {
+    if (!bench.enabled(name)) {
+        return;
+    }
+    const int voices = 32;
+    std::vector<MIX_Track *> tracks;
+    auto loop = SDL_CreateProperties();
+    SDL_SetNumberProperty(loop, MIX_PROP_PLAY_LOOPS_NUMBER, -1);
+    for (int i = 0; i < voices; ++i) {
+        auto t = MIX_CreateTrack(mixer);
+        MIX_SetTrackAudio(t, audio);
+        MIX_PlayTrack(t, loop);
+        tracks.push_back(t);
+    }
+    SDL_DestroyProperties(loop);
+    std::vector<float> out(480 * 2);
+    if (auto r = bench.measure(name, 1, [&]() {
+        MIX_Generate(mixer, out.data(), (int) (out.size() * sizeof(float)));
+    })) {
+        // 480 frames are 10 ms at 48 kHz
+        r->metric("voices", voices).metric("cpuPercent", r->percentile(0.5) / 1e7 * 100)
+            .metric("nsPerVoice", r->percentile(0.5) / voices).metric("audioBytes", decodedBytes(audio, false));
+    }
+    for (auto t : tracks) {
+        MIX_DestroyTrack(t);
+    }
+}
+
+// What a trigger costs the engine and the mixer: playing a track bound ahead, as pads do, and its first 10 ms
+static void triggerCase(Bench &bench, const std::string &name, MIX_Audio *audio) {
+    if (!bench.enabled(name)) {
+        return;
+    }
+    auto t = MIX_CreateTrack(mixer);
+    MIX_SetTrackAudio(t, audio);
+    std::vector<float> out(480 * 2);
+    if (auto r = bench.measure(name, 1, [&]() {
+        MIX_PlayTrack(t, 0);
+        MIX_Generate(mixer, out.data(), (int) (out.size() * sizeof(float)));
+        MIX_StopTrack(t, 0);
+    })) {
+        r->metric("audioBytes", decodedBytes(audio, false));
+    }
+    MIX_DestroyTrack(t);
+}
+
+// Memory (audioBytes), trigger cost and mixing cost of a sound kept as floats, 16-bit samples or encoded
+static void storageCases(Bench &bench, const std::string &label, const void *data, size_t size) {
+    static const char *storageWords[] = {"default", "float", "compact", "encoded"};
+    for (auto storage : {STORAGE_FLOAT, STORAGE_COMPACT, STORAGE_ENCODED}) {
+        auto suffix = storageWords[storage] + label;
+        if (!bench.enabled("trigger." + suffix) && !bench.enabled("mix.voices32." + suffix)) {
+            continue;
+        }
+        auto audio = loadForMixer(mixer, SDL_IOFromConstMem(data, size), true, storage);
+        if (!audio) {
+            fprintf(stderr, "%s: can't load: %s\n", suffix.c_str(), SDL_GetError());
+            continue;
+        }
+        triggerCase(bench, "trigger." + suffix, audio);
+        voicesCase(bench, "mix.voices32." + suffix, audio);
+        MIX_DestroyAudio(audio);
+    }
+}
+
+void benchAudio(Bench &bench, const BenchEnv &env) {
+    const unsigned frames = 48000 * 10;
+    auto s16 = makeWav(frames, 2, 48000, false);
+    auto f32 = makeWav(frames, 2, 48000, true);
+    auto s16cd = makeWav(44100 * 10, 2, 44100, false);
+    decodeCase(bench, "decode.wav_s16", s16.data(), s16.size());
+    decodeCase(bench, "decode.wav_f32", f32.data(), f32.size());
+    decodeCase(bench, "decode.wav_s16_44k", s16cd.data(), s16cd.size());
+    convertCase(bench, "decode.wav_s16_44k_convert", s16cd.data(), s16cd.size());
+    // 44.1 kHz material resampled while mixing, against once on load in each storage
+    if (auto native = MIX_LoadAudio_IO(mixer, SDL_IOFromConstMem(s16cd.data(), s16cd.size()), true, true)) {
+        voicesCase(bench, "mix.voices32.native44k", native);
+        MIX_DestroyAudio(native);
+    }
+    storageCases(bench, std::string(), s16cd.data(), s16cd.size());
+
+    // what .spack bundles with decoded sounds do: no decoding, no copy
+    SDL_AudioSpec spec = { SDL_AUDIO_S16LE, 2, 48000 };
+    const char *pcm = s16.data() + 44;
+    size_t pcmSize = s16.size() - 44;
+    if (auto r = bench.measure("decode.raw_nocopy", 1, [&]() {
+        MIX_DestroyAudio(MIX_LoadRawAudioNoCopy(mixer, pcm, pcmSize, &spec, false));
+    })) {
+        r->metric("inputBytes", pcmSize);
+    }
+
+    // one case per file, named by extension, e.g. decode.ogg.drums
+    if (env.media.empty()) {
+        return;
+    }
+    std::error_code ec;
+    for (auto &e : std::filesystem::directory_iterator(env.media, ec)) {
+        if (!e.is_regular_file(ec)) {
+            continue;
+        }
+        auto ext = lowercase(e.path().extension().u8string());
+        auto name = "decode." + (ext.empty() ? std::string("none") : ext.substr(1)) + "." + e.path().stem().u8string();
+        size_t size;
+        void *data = SDL_LoadFile(e.path().u8string().c_str(), &size);
+        if (!data) {
+            fprintf(stderr, "Can't read %s: %s\n", e.path().u8string().c_str(), SDL_GetError());
+            continue;
+        }
+        decodeCase(bench, name, data, size);
+        storageCases(bench, name.substr(6), data, size); // e.g. trigger.encoded.ogg.drums
+        SDL_free(data);
+    }
+}
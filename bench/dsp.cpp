@@ -0,0 +1,82 @@
+#include "Bench.hpp"
+#include "Dsp.hpp"
+#include <vector>
+
+// A 10 ms stereo block per voice, as the mixer hands it to a track callback at 48 kHz
+static const int voices = 64;
+static const int blockFrames = 480;
+
+static void kernelCases(Bench &bench) {
+    std::vector<Biquad> filters(voices);
+    for (auto &f : filters) {
+        f.set(designFilter(FILTER_LOWPASS, 800.f, 2.f, 48000));
+    }
+    std::vector<float> pcm((size_t) voices * blockFrames * 2);
+    Uint32 noise = 0x12345678;
+    for (auto &v : pcm) {
+        noise = noise * 1664525 + 1013904223;
+        v = (noise >> 8) / 16777216.f - 0.5f;
+    }
+    for (auto &k : biquadKernels()) {
+        auto r = bench.measure(std::string("dsp.biquad.") + k.name, voices, [&]() {
+            for (int i = 0; i < voices; ++i) {
+                k.run(filters[i], pcm.data() + (size_t) i * blockFrames * 2, blockFrames, 2);
+            }
+        });
+        if (r) {
+            // share of one core the filters of 64 voices take in real time
+            r->metric("voices", voices).metric("framesPerVoice", blockFrames)
+                .metric("cpuPercent64", r->percentile(0.5) * voices / 1e7 * 100);
+        }
+    }
+}
+
+// The whole mixer with 64 looping voices, untouched or with rate, pan and a filter each
+static void mixCase(Bench &bench, const std::string &name, bool dsp) {
+    if (!bench.enabled(name)) {
+        return;
+    }
+    auto wav = makeWav(48000, 2, 48000, false);
+    auto audio = MIX_LoadAudio_IO(mixer, SDL_IOFromConstMem(wav.data(), wav.size()), true, true);
+    if (!audio) {
+        fprintf(stderr, "%s: can't decode: %s\n", name.c_str(), SDL_GetError());
+        return;
+    }
+    std::vector<MIX_Track *> tracks;
+    std::vector<TrackFilter> filters(voices);
+    auto loop = SDL_CreateProperties();
+    SDL_SetNumberProperty(loop, MIX_PROP_PLAY_LOOPS_NUMBER, -1);
+    for (int i = 0; i < voices; ++i) {
+        auto t = MIX_CreateTrack(mixer);
+        MIX_SetTrackAudio(t, audio);
+        if (dsp) {
+            MIX_StereoGains gains = {1.f, 0.5f};
+            MIX_SetTrackFrequencyRatio(t, 1.f + i / 128.f);
+            MIX_SetTrackStereo(t, &gains);
+            filters[i].type = FILTER_LOWPASS;
+            filters[i].cutoff = 400.f + 50.f * i;
+            filters[i].resonance = 2.f;
+            MIX_SetTrackCookedCallback(t, filterTrack, &filters[i]);
+        }
+        MIX_PlayTrack(t, loop);
+        tracks.push_back(t);
+    }
+    SDL_DestroyProperties(loop);
+    std::vector<float> out(blockFrames * 2);
+    if (auto r = bench.measure(name, 1, [&]() {
+        MIX_Generate(mixer, out.data(), (int) (out.size() * sizeof(float)));
+    })) {
+        r->metric("voices", voices).metric("framesPerBlock", blockFrames)
+            .metric("cpuPercent", r->percentile(0.5) / 1e7 * 100);
+    }
+    for (auto t : tracks) {
+        MIX_DestroyTrack(t);
+    }
+    MIX_DestroyAudio(audio);
+}
+
+void benchDsp(Bench &bench, const BenchEnv &env) {
+    kernelCases(bench);
+    mixCase(bench, "mix.voices64.neutral", false);
+    mixCase(bench, "mix.voices64.dsp", true);
+}
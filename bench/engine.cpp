@@ -0,0 +1,220 @@
+#include "Bench.hpp"
+#include "Config.hpp"
+#include "Control.hpp"
+#include "Engine.hpp"
+
+// Default layout with the same short sound on every pad
+static SoundPad *makePads(const std::string &wav) {
+    auto pads = createDefault(mixer);
+    for (auto &row : *pads) {
+        for (auto &p : row) {
+            p.loadSound(SDL_IOFromConstMem(wav.data(), wav.size()), "bench.wav");
+        }
+    }
+    return pads;
+}
+
+static void engineMetrics(BenchResult *r, Engine &engine) {
+    auto st = engine.stats();
+    r->metric("engineLatencyP50NS", st.latencyPercentileNS(0.5))
+        .metric("engineLatencyP99NS", st.latencyPercentileNS(0.99))
+        .metric("engineLatencyMaxNS", st.maxLatencyNS)
+        .metric("maxQueueDepth", st.maxQueueDepth)
+        .metric("dropped", st.dropped);
+}
+
+#ifndef _WIN32
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// Blocking line client of the control socket
+class ControlClient {
+public:
+    ~ControlClient() {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    bool connect(const std::filesystem::path &path) {
+        sockaddr_un addr = {};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.u8string().c_str(), sizeof(addr.sun_path) - 1);
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        return fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) == 0;
+    }
+
+    bool send(const std::string &text) {
+        size_t sent = 0;
+        while (sent < text.size()) {
+            auto n = write(fd, text.data() + sent, text.size() - sent);
+            if (n <= 0 && errno != EINTR) {
+                return false;
+            }
+            sent += n > 0 ? n : 0;
+        }
+        return true;
+    }
+
+    bool readLine(std::string &line) {
+        size_t eol;
+        while ((eol = in.find('\n')) == std::string::npos) {
+            char buf[4096];
+            auto n = read(fd, buf, sizeof(buf));
+            if (n <= 0) {
+                return false;
+            }
+            in.append(buf, n);
+        }
+        line = in.substr(0, eol);
+        in.erase(0, eol + 1);
+        return true;
+    }
+private:
+    int fd = -1;
+    std::string in;
+};
+
+// Lines of `perLine` commands, `window` lines in flight; returns ns per line, one sample per window
+static bool controlRun(ControlClient &client, unsigned lines, unsigned window, unsigned perLine, std::vector<double> &samples) {
+    std::string line;
+    for (unsigned i = 0; i < perLine; ++i) {
+        line += i ? ";" : "";
+        line += i % 2 ? "t A s" : "t A l";
+    }
+    line += "\n";
+    std::string burst;
+    for (unsigned i = 0; i < window; ++i) {
+        burst += line;
+    }
+    std::string reply;
+    for (unsigned done = 0; done < lines; done += window) {
+        auto start = SDL_GetTicksNS();
+        if (!client.send(burst)) {
+            return false;
+        }
+        for (unsigned i = 0; i < window; ++i) {
+            if (!client.readLine(reply) || reply.compare(0, 3, "ok ") != 0) {
+                fprintf(stderr, "Control socket replied '%s'\n", reply.c_str());
+                return false;
+            }
+        }
+        samples.push_back((double) (SDL_GetTicksNS() - start) / window);
+    }
+    return true;
+}
+
+static const struct ControlCase {
+    const char *name;
+    unsigned window;
+    unsigned perLine;
+} controlCases[] = {
+    {"control.roundtrip", 1, 1},   // one line at a time: latency
+    {"control.pipelined", 64, 1},  // many lines in flight: throughput
+    {"control.batched", 16, 16},   // many commands per line
+};
+
+// Throughput and latency as a client of the control socket sees them
+static void benchControl(Bench &bench, const BenchEnv &env, const std::string &wav) {
+    bool any = false;
+    for (auto &c : controlCases) {
+        any |= bench.enabled(c.name);
+    }
+    if (!any) {
+        return;
+    }
+    auto pads = makePads(wav);
+    Engine engine;
+    engine.start();
+    engine.attach(pads);
+    ControlServer server(&engine, env.tmp / "bench.sock");
+    ControlClient client;
+    if (!server.start() || !client.connect(env.tmp / "bench.sock")) {
+        fprintf(stderr, "Control socket is not available: %s\n", strerror(errno));
+    } else {
+        for (auto &c : controlCases) {
+            if (!bench.enabled(c.name)) {
+                continue;
+            }
+            std::vector<double> samples;
+            unsigned lines = 4096 / c.perLine;
+            auto start = SDL_GetTicksNS();
+            if (!controlRun(client, lines, c.window, c.perLine, samples)) {
+                break;
+            }
+            double seconds = (SDL_GetTicksNS() - start) / 1e9;
+            auto r = bench.record(c.name, samples, lines);
+            r->metric("linesPerSecond", lines / seconds).metric("commandsPerSecond", lines * c.perLine / seconds);
+            engine.wait();
+            engineMetrics(r, engine);
+        }
+    }
+    server.stop();
+    engine.stop();
+    engine.attach(nullptr);
+    delete pads;
+}
+
+#else
+
+static void benchControl(Bench &bench, const BenchEnv &env, const std::string &wav) {
+    // no control socket on this platform
+}
+
+#endif // _WIN32
+
+void benchEngine(Bench &bench, const BenchEnv &env) {
+    auto wav = makeWav(48000, 2, 48000, false);
+
+    // the state machine alone: shift alternates loop and stop on one track
+    auto pads = makePads(wav);
+    auto pad = pads->find('A');
+    bench.measure("trigger.direct", 1, [pad]() {
+        pad->press(false, true, false);
+        pad->fulfillRequest();
+        pad->resolveState();
+    });
+
+    // through the queue and the engine thread, as keys and remote commands go
+    {
+        Engine engine;
+        engine.start();
+        engine.attach(pads);
+        if (auto r = bench.measure("trigger.engine", 1000, [&engine]() {
+            for (int i = 0; i < 500; ++i) {
+                engine.press('A', false, true, false);
+                engine.release('A');
+            }
+            engine.wait();
+        })) {
+            engineMetrics(r, engine);
+        }
+        engine.stop();
+        engine.attach(nullptr);
+    }
+    delete pads;
+
+    // the engine polls every playing pad, so this is paid per pad every 10 ms
+    for (unsigned tracks : {1, 2, 4, 8, 16, 32, 64}) {
+        auto name = "resolveState.tracks" + std::to_string(tracks);
+        if (!bench.enabled(name)) {
+            continue;
+        }
+        auto pads = makePads(wav);
+        auto pad = pads->find('A');
+        for (unsigned i = 0; i < tracks; ++i) {
+            pad->request = ONE_SHOT; // every shot takes an idle track or makes one
+            pad->fulfillRequest();
+        }
+        if (auto r = bench.measure(name, 1, [pad]() { pad->resolveState(); })) {
+            r->metric("tracks", pad->tracksAllocated).metric("playing", pad->tracksPlaying);
+        }
+        delete pads;
+    }
+
+    benchControl(bench, env, wav);
+}
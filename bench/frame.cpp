@@ -0,0 +1,87 @@
+#include "Bench.hpp"
+#include "soundpad.hpp"
+
+static const char letters[] = "1234567890QWERTYUIOPASDFGHJKLZXCVBNM";
+
+// Rows of twelve pads, every other one with a picture, the rest with a name
+static SoundPad *makeGrid(unsigned count) {
+    auto pads = new SoundPad();
+    for (unsigned i = 0; i < count; ++i) {
+        if (i % 12 == 0) {
+            pads->emplace_back();
+            pads->back().reserve(12);
+        }
+        pads->back().emplace_back(Pad(letters[i % 36], mixer));
+        auto &p = pads->back().back();
+        if (i % 2) {
+            p.pendingPicture = SDL_CreateSurface(256, 256, SDL_PIXELFORMAT_RGBA8888);
+            p.picturePath = "bench.png";
+            p.uploadPicture();
+        } else {
+            p.name = "sound " + std::to_string(i) + ".ogg";
+        }
+    }
+    pads->buildIndex();
+    return pads;
+}
+
+// Whole frames as the app draws them, on the software renderer of an offscreen window
+void benchFrame(Bench &bench, const BenchEnv &env) {
+    const unsigned counts[] = {12, 36, 72, 144};
+    bool any = false;
+    for (auto count : counts) {
+        any |= bench.enabled("frame.pads" + std::to_string(count));
+    }
+    if (!any) {
+        return;
+    }
+    window = SDL_CreateWindow("soundpad_bench", 1280, 800, SDL_WINDOW_HIDDEN);
+    renderer = window ? SDL_CreateRenderer(window, SDL_SOFTWARE_RENDERER) : nullptr;
+    if (!renderer) {
+        fprintf(stderr, "No offscreen software renderer: %s\n", SDL_GetError());
+        if (window) {
+            SDL_DestroyWindow(window);
+            window = nullptr;
+        }
+        return;
+    }
+    ImGui::CreateContext();
+    ImGuiIO &io = ImGui::GetIO();
+    io.IniFilename = nullptr;
+    auto font = io.Fonts->AddFontDefaultBitmap(); // what the app falls back to for letters
+    ImGui_ImplSDL3_InitForSDLRenderer(window, renderer);
+    ImGui_ImplSDLRenderer3_Init(renderer);
+    Engine engine; // not started: pads are only drawn
+
+    for (auto count : counts) {
+        auto name = "frame.pads" + std::to_string(count);
+        if (!bench.enabled(name)) {
+            continue;
+        }
+        auto pads = makeGrid(count);
+        if (auto r = bench.measure(name, 1, [&]() {
+            ImGui_ImplSDLRenderer3_NewFrame();
+            ImGui_ImplSDL3_NewFrame();
+            io.DeltaTime = 1 / 60.f;
+            ImGui::NewFrame();
+            ShowSoundPad(*pads, engine, true, font);
+            ImGui::Render();
+            SDL_RenderClear(renderer);
+            ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer);
+            SDL_RenderPresent(renderer);
+        })) {
+            auto data = ImGui::GetDrawData();
+            r->metric("pads", count).metric("vertices", data ? data->TotalVtxCount : 0)
+                .metric("fps", 1e9 / r->percentile(0.5));
+        }
+        delete pads;
+    }
+
+    ImGui_ImplSDLRenderer3_Shutdown();
+    ImGui_ImplSDL3_Shutdown();
+    ImGui::DestroyContext();
+    SDL_DestroyRenderer(renderer);
+    SDL_DestroyWindow(window);
+    renderer = nullptr;
+    window = nullptr;
+}
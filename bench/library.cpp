@@ -0,0 +1,51 @@
+#include "Bench.hpp"
+#include "Library.hpp"
+#include <fstream>
+
+static const char *kinds[] = {"kick", "snare", "hat", "clap", "vox", "pad", "fx", "riser", "bass", "perc"};
+
+// Sample pack looking tree: 100 dirs of 200 empty files; empty files fail probing at once
+static void makeTree(const std::filesystem::path &root, unsigned dirs, unsigned perDir) {
+    for (unsigned d = 0; d < dirs; ++d) {
+        auto dir = root / ("pack " + std::to_string(d)) / kinds[d % 10];
+        std::filesystem::create_directories(dir);
+        for (unsigned f = 0; f < perDir; ++f) {
+            std::ofstream(dir / (std::string(kinds[(d + f) % 10]) + " " + std::to_string(f) + " 120bpm.wav"));
+        }
+    }
+}
+
+// Search as the library browser runs it every keystroke, against 20000 sounds
+void benchLibrary(Bench &bench, const BenchEnv &env) {
+    if (!bench.enabled("library.search")) {
+        return;
+    }
+    const unsigned dirs = 100, perDir = 200;
+    auto root = env.tmp / "library";
+    makeTree(root, dirs, perDir);
+    Library library(mixer);
+    library.open(root, env.tmp / "library.idx");
+    auto until = SDL_GetTicksNS() + 30000000000ull;
+    while ((library.size() < dirs * perDir || library.scanning()) && SDL_GetTicksNS() < until) {
+        SDL_Delay(10);
+    }
+    // each query differs from the last without extending it, so every call scores the whole index
+    const char *queries[] = {"snare", "kick 12", "vox", "pack 4 hat", "120bpm"};
+    size_t i = 0, matches = 0;
+    if (auto r = bench.measure("library.search", 1, [&]() {
+        matches = library.search(queries[i++ % 5]).size();
+    })) {
+        r->metric("entries", library.size()).metric("lastMatches", matches);
+    }
+    // typing a query out, narrowed from the previous results
+    const char *typed[] = {"s", "sn", "sna", "snar", "snare"};
+    if (auto r = bench.measure("library.search.typing", 5, [&]() {
+        for (auto q : typed) {
+            matches = library.search(q).size();
+        }
+        library.search("");
+    })) {
+        r->metric("entries", library.size());
+    }
+    library.stop();
+}
@@ -0,0 +1,96 @@
+/**
+ * soundpad_bench - timings of the soundpad core, written as JSON so runs of
+ * different builds can be compared.
+ */
+
+#include "Bench.hpp"
+#include "AssetStore.hpp"
+#include "Jobs.hpp"
+#include "Utils.hpp"
+#include <cstring>
+
+int main(int argc, char *argv[]) {
+    Bench bench;
+    BenchEnv env;
+    const char *outPath = "-";
+    bool verbose = false;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
+            printf("Usage: %s [OPTIONS]\n", argv[0]);
+            printf("Options:\n");
+            printf("\t--out <FILE|->     \tWhere results go as JSON, stdout by default\n");
+            printf("\t--filter <TEXT>    \tRun only cases with the text in their names\n");
+            printf("\t--time <MS>        \tTime spent per case, 300 by default\n");
+            printf("\t--media <DIR>      \tAlso decode every sound file in the directory\n");
+            printf("\t--label <TEXT>     \tStored with the results, e.g. a commit\n");
+            printf("\t--verbose          \tKeep the app log\n");
+            return 0;
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            outPath = argv[++i];
+        } else if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            bench.filter = argv[++i];
+        } else if (strcmp(argv[i], "--time") == 0 && i + 1 < argc) {
+            bench.caseNS = (Uint64) SDL_atoi(argv[++i]) * 1000000;
+        } else if (strcmp(argv[i], "--media") == 0 && i + 1 < argc) {
+            env.media = std::filesystem::u8path(argv[++i]);
+        } else if (strcmp(argv[i], "--label") == 0 && i + 1 < argc) {
+            bench.label = argv[++i];
+        } else if (strcmp(argv[i], "--verbose") == 0) {
+            verbose = true;
+        } else {
+            printf("Unknown option %s, see --help\n", argv[i]);
+            return 1;
+        }
+    }
+    if (!verbose) {
+        SDL_SetLogPriority(SDL_LOG_CATEGORY_APPLICATION, SDL_LOG_PRIORITY_WARN);
+    }
+
+    // no display and no sound card needed, the perf box has neither
+    SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+    SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+    if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) || !MIX_Init()) {
+        fprintf(stderr, "Couldn't initialize SDL: %s\n", SDL_GetError());
+        return 1;
+    }
+    // mixed on demand, like replays, so playing sounds cost nothing unless a case generates audio
+    SDL_AudioSpec spec = { SDL_AUDIO_F32, 2, 48000 };
+    mixer = MIX_CreateMixer(&spec);
+    if (!mixer) {
+        fprintf(stderr, "Couldn't create mixer: %s\n", SDL_GetError());
+        return 1;
+    }
+    jobs.start();
+
+    std::error_code ec;
+    env.tmp = std::filesystem::temp_directory_path(ec) / ("soundpad_bench_" + std::to_string(SDL_GetTicksNS()));
+    std::filesystem::create_directories(env.tmp / "profiles", ec);
+    if (ec) {
+        fprintf(stderr, "Couldn't create %s: %s\n", env.tmp.u8string().c_str(), ec.message().c_str());
+        return 1;
+    }
+    assetStore.open(env.tmp / "store", env.tmp / "profiles");
+
+    benchProfiles(bench, env);
+    benchAudio(bench, env);
+    benchEngine(bench, env);
+    benchFrame(bench, env);
+    benchDsp(bench, env);
+    benchLibrary(bench, env);
+
+    jobs.stop();
+    std::filesystem::remove_all(env.tmp, ec);
+    MIX_DestroyMixer(mixer);
+    mixer = nullptr;
+    MIX_Quit();
+    SDL_Quit();
+
+    auto json = bench.json();
+    if (strcmp(outPath, "-") == 0) {
+        fwrite(json.data(), 1, json.size(), stdout);
+    } else if (!writeFileAtomic(std::filesystem::u8path(outPath), json)) {
+        fprintf(stderr, "Couldn't write %s\n", outPath);
+        return 1;
+    }
+    return 0;
+}
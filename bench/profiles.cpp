@@ -0,0 +1,91 @@
+#include "Bench.hpp"
+#include "Config.hpp"
+#include "Resample.hpp"
+#include "Resources.hpp"
+
+static const std::vector<std::string> fullLayout = {"1234567890", "QWERTYUIOP", "ASDFGHJKL", "ZXCVBNM"};
+
+static unsigned padCount(SoundPad *pad) {
+    unsigned n = 0;
+    for (auto &row : *pad) {
+        n += row.size();
+    }
+    return n;
+}
+
+// What loading `copies` of the profile adds to the process, per pad
+static void memoryPerPad(Bench &bench, const std::string &name, const std::filesystem::path &profile, unsigned copies) {
+    if (!bench.enabled(name)) {
+        return;
+    }
+    ProcessMemory before, after;
+    bool known = processMemory(before);
+    std::vector<SoundPad *> loaded;
+    for (unsigned i = 0; i < copies; ++i) {
+        loaded.push_back(loadSoundPad(profile, mixer));
+    }
+    known &= processMemory(after);
+    unsigned pads = 0;
+    size_t counted = 0;
+    for (auto pad : loaded) {
+        pads += padCount(pad);
+        counted += pad->memoryUsage();
+    }
+    auto r = bench.values(name);
+    r->metric("pads", pads).metric("countedBytesPerPad", (double) counted / pads).metric("sizeofPad", sizeof(Pad));
+    if (known) {
+        r->metric("rssBytesPerPad", ((double) after.rss - before.rss) / pads);
+        r->metric("heapBytesPerPad", ((double) after.heap - before.heap) / pads);
+    }
+    for (auto pad : loaded) {
+        delete pad;
+    }
+}
+
+void benchProfiles(Bench &bench, const BenchEnv &env) {
+    auto dir = env.tmp / "profiles";
+    auto empty = makeProfile(dir, "empty", fullLayout, 0);
+    auto full = makeProfile(dir, "full", fullLayout, 24000);
+
+    // text only: layout, tables, volumes, and a track per pad
+    if (auto r = bench.measure("profile.parse", 1, [&]() { delete loadSoundPad(empty, mixer); })) {
+        r->metric("pads", 36);
+    }
+    // plus 36 half-second sounds decoded by the job threads
+    if (auto r = bench.measure("profile.load", 1, [&]() { delete loadSoundPad(full, mixer); })) {
+        r->metric("pads", 36).metric("jobThreads", jobs.threads());
+    }
+
+    auto pad = loadSoundPad(full, mixer);
+    size_t textBytes = 0;
+    if (auto r = bench.measure("profile.serialize", 1, [&]() {
+        auto text = serializeLayout(pad);
+        for (auto &row : *pad) {
+            for (auto &p : row) {
+                text += serializePad(p);
+            }
+        }
+        textBytes = text.size();
+    })) {
+        r->metric("bytes", textBytes);
+    }
+    // atomic replace, so it includes fsync
+    auto saved = dir / "saved.cfg";
+    bench.measure("profile.save", 1, [&]() { saveSoundPad(saved, pad); });
+    delete pad;
+
+    memoryPerPad(bench, "memory.emptyPad", empty, 16);
+    memoryPerPad(bench, "memory.soundPad", full, 8);
+
+    // ten seconds on each of 36 pads, decoded as floats, as 16-bit samples and kept encoded
+    if (bench.enabled("memory.largeProfile.float") || bench.enabled("memory.largeProfile.compact")
+        || bench.enabled("memory.largeProfile.encoded")) {
+        auto large = makeProfile(dir, "large", fullLayout, 48000 * 10);
+        memoryPerPad(bench, "memory.largeProfile.float", large, 1);
+        storageOnLoad = STORAGE_COMPACT;
+        memoryPerPad(bench, "memory.largeProfile.compact", large, 1);
+        storageOnLoad = STORAGE_ENCODED;
+        memoryPerPad(bench, "memory.largeProfile.encoded", large, 1);
+        storageOnLoad = STORAGE_FLOAT;
+    }
+}
@@ -19,9 +19,25 @@
 #include "preface.hpp"
 #include <SDL3/SDL_main.h>
 #include "soundpad.hpp"
+#include "AssetStore.hpp"
+#include "Autosave.hpp"
+#include "Capture.hpp"
 #include "Config.hpp"
+#include "Control.hpp"
+#include "Engine.hpp"
 #include "Font.hpp"
 #include "Help.hpp"
+#include "Library.hpp"
+#include "Osc.hpp"
+#include "Output.hpp"
+#include "ProfileCache.hpp"
+#include "Replay.hpp"
+#include "Resample.hpp"
+#include "Resources.hpp"
+#include "Startup.hpp"
+#include "Tiering.hpp"
+#include "Trace.hpp"
+#include "Waveform.hpp"
 
 static AppConfig *appCfg = nullptr;
 
@@ -79,6 +95,7 @@ const SDL_DialogFileFilter musicFileFilter[] = {
 };
 
 const SDL_DialogFileFilter ttfFileFilter = { "TrueType Font", "ttf" };
+const SDL_DialogFileFilter packFileFilter = { "Soundpad bundle", "spack" };
 const char *defaultFontDir =
 #ifdef _WIN32
                             "C:\\Windows\\Fonts\\"
@@ -107,12 +124,484 @@ struct AppState {
         "HELD",
     };
     const Help *helpWindow = nullptr;
+    Engine *engine = new Engine();
+    Autosaver *saver = new Autosaver();
+    AudioTiering *tiering = new AudioTiering(); // of the shown profile, none in replays
+    ProfileCache *profiles = nullptr;
+    Library *library = nullptr; // of baseRoot, none in replays
+    bool showLibrary = false;
+    bool showResources = false;
+    ResourceReport *resources = nullptr; // last snapshot shown
+    std::string dumpResources; // file, or - for stdout
+    std::string dumpTrace; // file written on exit
+    std::filesystem::path pendingProfile; // being loaded in the background
+    Uint64 pendingSince = 0;
+    bool pendingWarm = false;
+    ControlServer *control = nullptr;
+    OscServer *osc = nullptr;
+    InputRecorder *recorder = nullptr;
+    InputReplayer *replayer = nullptr;
+    ReplayStats replayStats;
+    Uint64 replayClock = 0;
+    bool injecting = false;
+    std::vector<float> replayAudio;
+    bool exportPCM = false;
 #ifdef FPS
     Uint64 fps = 0;
     Uint64 lastFpsReset = 0;
 #endif
 };
 
+// Replaces current soundpad (if any) with a new one, nullptr returns to the selector.
+// The old one is kept warm and plays out.
+static void switchProfile(AppState *state, SoundPad *newPad, const std::filesystem::path &path) {
+    state->saver->attach(newPad, path);
+    state->engine->attach(newPad);
+    auto old = state->selected;
+    auto oldPath = state->currentProfile;
+    state->selected = newPad;
+    state->currentProfile = path;
+    state->selectedPad = nullptr;
+    state->profiles->retire(old, oldPath);
+    if (!state->replayer) {
+        if (!oldPath.empty()) {
+            appCfg->catalog.changed(oldPath); // saved just before
+        }
+        appCfg->catalog.touch(path);
+    }
+    if (state->recorder) {
+        state->recorder->recordProfile(path.filename().u8string());
+    }
+}
+
+// Saves current profile unless it is a replay, which must leave files intact
+static bool saveCurrent(AppState *state) {
+    if (state->replayer || !state->selected) {
+        return false;
+    }
+    return state->saver->flush(true, &state->engine->padLock);
+}
+
+// Loads right away, warm if possible
+static SoundPad *takeOrLoad(AppState *state, const std::filesystem::path &path) {
+    auto pad = state->profiles->take(path);
+    return pad ? pad : loadSoundPad(path, mixer);
+}
+
+// Switches once the profile is loaded in the background; current one keeps playing meanwhile
+static void requestSwitch(AppState *state, const std::filesystem::path &path) {
+    if (state->selected && path == state->currentProfile) {
+        return;
+    }
+    if (!state->pendingProfile.empty() && state->pendingProfile != path) {
+        state->profiles->cancel(state->pendingProfile); // not wanted anymore
+    }
+    state->pendingProfile = path;
+    state->pendingSince = SDL_GetTicksNS();
+    state->pendingWarm = state->profiles->isWarm(path);
+    state->profiles->preload(path);
+}
+
+static void completeSwitch(AppState *state) {
+    if (state->pendingProfile.empty()) {
+        return;
+    }
+    auto pad = state->profiles->take(state->pendingProfile);
+    if (!pad) {
+        return;
+    }
+    auto path = state->pendingProfile;
+    state->pendingProfile.clear();
+    saveCurrent(state);
+    switchProfile(state, pad, path);
+    SDL_Log("Switched to %s in %.1f ms (%s)", path.filename().u8string().c_str(),
+        (SDL_GetTicksNS() - state->pendingSince) / 1000000.0, state->pendingWarm ? "warm" : "cold");
+}
+
+// Autosave: pad settings changed (nullptr if not about a single pad), written once edits settle
+static void markChanged(AppState *state, const Pad *pad) {
+    if (appCfg->autosave && !state->replayer) {
+        state->saver->markDirty(pad);
+    }
+}
+
+// Puts the sound into the asset store and decodes it on the calling thread,
+// the engine swaps it in (or adds it as another take) between triggers
+static bool assignSound(AppState *state, SoundPad *pads, char letter, const std::filesystem::path &path, bool variant = false) {
+    auto storage = STORAGE_DEFAULT;
+    {
+        std::lock_guard<std::mutex> guard(state->engine->padLock);
+        if (auto pad = pads->find(letter)) {
+            storage = pad->storage;
+        }
+    }
+    auto key = assetStore.put(path);
+    auto audio = key.empty() ? nullptr : assetStore.acquireAudio(key, mixer, storage);
+    auto name = path.filename().u8string();
+    if (!audio || !(variant ? state->engine->addVariant(pads, letter, audio, key, name)
+                            : state->engine->assign(pads, letter, audio, key, name))) {
+        SDL_Log("Failed to load sound on pad %c", letter);
+        return false;
+    }
+    SDL_Log("Loaded %s %s on pad %c", variant ? "variant" : "sound", name.c_str(), letter);
+    markChanged(state, pads->find(letter));
+    return true;
+}
+
+// Puts the picture into the asset store and decodes it in a job; the main thread hands it to the pad,
+// unless the profile isn't shown anymore
+static void assignPicture(AppState *state, SoundPad *pads, char letter, const std::filesystem::path &path) {
+    jobs.run(JOB_NOW, [state, pads, letter, path]() {
+        auto start = SDL_GetTicksNS();
+        auto key = assetStore.put(path);
+        auto surface = key.empty() ? nullptr : IMG_Load(assetStore.path(key).u8string().c_str());
+        if (!surface) {
+            SDL_Log("Failed to load picture on pad %c: %s", letter, SDL_GetError());
+            return;
+        }
+        auto loadNS = SDL_GetTicksNS() - start;
+        jobs.onMain([state, pads, letter, key, surface, loadNS, name = path.filename().u8string()]() {
+            Pad *pad = state->selected == pads ? pads->find(letter) : nullptr;
+            if (!pad) {
+                SDL_Log("Pad %c is gone, dropping its picture", letter);
+                SDL_DestroySurface(surface);
+                return;
+            }
+            {
+                std::lock_guard<std::mutex> guard(state->engine->padLock);
+                pad->adoptPicture(surface, key, name, loadNS);
+            }
+            SDL_Log("Loaded picture %s on pad %c", name.c_str(), letter);
+            markChanged(state, pad);
+        });
+    });
+}
+
+// Decodes the pad's stored sound again as its storage now says, the engine swaps it in;
+// takes keep theirs until the profile is loaded again. Caller holds padLock
+static void reloadSound(AppState *state, SoundPad *pads, const Pad *pad) {
+    if (pad->soundKey.empty()) {
+        return;
+    }
+    jobs.run(JOB_NOW, [state, pads, letter = pad->letter, key = pad->soundKey, name = pad->name, storage = pad->storage]() {
+        auto audio = assetStore.acquireAudio(key, mixer, storage);
+        if (!audio || !state->engine->assign(pads, letter, audio, key, name)) {
+            SDL_Log("Failed to reload sound on pad %c", letter);
+        }
+    });
+}
+
+// Trim and cues of the pad over its waveform: left button sets the start, right button the end.
+// Caller holds padLock; the engine reads the slices when it triggers
+static void ShowSliceEditor(AppState *state, Pad *pad) {
+    static WaveformPtr wave;
+    static char cueName[64];
+    if (!wave || wave->source != pad->audio) {
+        wave = buildWaveform(pad->audio, 512);
+    }
+    auto trim = pad->trim;
+    auto cues = pad->cues;
+    bool changed = false;
+    ImVec2 pos = ImGui::GetCursorScreenPos();
+    ImVec2 size(std::max(ImGui::GetContentRegionAvail().x, ImGui::GetFontSize() * 24), ImGui::GetFontSize() * 4);
+    ImVec2 max(pos.x + size.x, pos.y + size.y);
+    ImGui::InvisibleButton("waveform", size);
+    auto draw = ImGui::GetWindowDrawList();
+    draw->AddRectFilled(pos, max, IM_COL32(20, 20, 20, 255));
+    Sint64 frames = wave->ready ? wave->frames : 0;
+    if (!wave->ready) {
+        draw->AddText(ImVec2(pos.x + 4, pos.y + 4), IM_COL32(160, 160, 160, 255), "Reading...");
+    } else if (frames > 0) {
+        auto x = [&](Sint64 f) {
+            return pos.x + size.x * (float) std::min(f, frames) / frames;
+        };
+        auto end = trim.end > 0 ? trim.end : frames;
+        for (auto &c : cues) {
+            draw->AddRectFilled(ImVec2(x(c.start), pos.y), ImVec2(x(c.end > 0 ? c.end : frames), max.y), IM_COL32(60, 60, 160, 80));
+        }
+        auto columns = wave->low.size();
+        float mid = pos.y + size.y / 2;
+        for (size_t i = 0; i < columns; ++i) {
+            float cx = pos.x + size.x * (i + 0.5f) / columns;
+            auto f = (Sint64) ((i + 0.5) * frames / columns);
+            bool inside = f >= trim.start && f < end;
+            draw->AddLine(ImVec2(cx, mid - wave->high[i] * size.y / 2), ImVec2(cx, mid - wave->low[i] * size.y / 2 + 1),
+                inside ? IM_COL32(80, 200, 80, 255) : IM_COL32(90, 90, 90, 255));
+        }
+        draw->AddLine(ImVec2(x(trim.start), pos.y), ImVec2(x(trim.start), max.y), IM_COL32(220, 220, 60, 255));
+        draw->AddLine(ImVec2(x(end), pos.y), ImVec2(x(end), max.y), IM_COL32(220, 120, 60, 255));
+        if (ImGui::IsItemHovered() || ImGui::IsItemActive()) {
+            auto f = (Sint64) ((ImGui::GetMousePos().x - pos.x) / size.x * frames);
+            f = std::clamp<Sint64>(f, 0, frames);
+            if (ImGui::IsItemActive() && ImGui::IsMouseDown(ImGuiMouseButton_Left) && f != trim.start) {
+                trim.start = f;
+                changed = true;
+            } else if (ImGui::IsItemHovered() && ImGui::IsMouseDown(ImGuiMouseButton_Right) && f != trim.end) {
+                trim.end = f == frames ? 0 : f;
+                changed = true;
+            }
+        }
+    }
+    // frames, for sample accurate edits
+    changed |= ImGui::InputScalar("Start frame", ImGuiDataType_S64, &trim.start);
+    changed |= ImGui::InputScalar("End frame", ImGuiDataType_S64, &trim.end);
+    trim.start = std::max<Sint64>(trim.start, 0);
+    trim.end = std::max<Sint64>(trim.end, 0);
+    if (wave->rate > 0) {
+        ImGui::TextDisabled("%.3f s to %.3f s of %.3f s", (double) trim.start / wave->rate,
+            (double) (trim.end > 0 ? trim.end : frames) / wave->rate, (double) frames / wave->rate);
+    }
+    if (!trim.whole() && ImGui::Button("Whole sound")) {
+        trim = PadSlice();
+        changed = true;
+    }
+    for (size_t i = 0; i < cues.size(); ++i) {
+        ImGui::PushID((int) i);
+        if (ImGui::Button("X##Remove cue")) {
+            cues.erase(cues.begin() + i);
+            changed = true;
+            ImGui::PopID();
+            break;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button(">##Play cue")) {
+            Command cmd;
+            cmd.type = CMD_CUE;
+            cmd.letter = pad->letter;
+            cmd.index = (unsigned) i;
+            cmd.issued = SDL_GetTicksNS();
+            state->engine->submit(cmd);
+        }
+        ImGui::SameLine();
+        ImGui::Text("%s: %lld to %lld", cues[i].name.c_str(), (long long) cues[i].start, (long long) cues[i].end);
+        ImGui::PopID();
+    }
+    ImGui::InputTextWithHint("##cue", "cue name", cueName, sizeof(cueName));
+    ImGui::SameLine();
+    if (ImGui::Button("Add cue") && cueName[0]) {
+        PadSlice cue = trim;
+        cue.name = cueName;
+        // names are words in the profile
+        std::replace_if(cue.name.begin(), cue.name.end(), [](char c) { return isspace((unsigned char) c); }, '_');
+        cues.push_back(cue);
+        cueName[0] = 0;
+        changed = true;
+    }
+    if (changed) {
+        pad->setSlices(trim, cues);
+        markChanged(state, pad);
+    }
+}
+
+// Sounds under baseRoot: search, listen and drag onto a pad
+static void ShowLibrary(AppState *state) {
+    auto library = state->library;
+    ImGui::SetNextWindowSize(ImVec2(ImGui::GetFontSize() * 40, ImGui::GetFontSize() * 24), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Library", &state->showLibrary)) {
+        ImGui::End();
+        return;
+    }
+    static char query[256];
+    ImGui::SetNextItemWidth(-FLT_MIN);
+    ImGui::InputTextWithHint("##query", "search sounds", query, sizeof(query));
+    auto &found = library->search(query);
+    if (library->scanning()) {
+        ImGui::TextDisabled("Indexing %s...", library->root().u8string().c_str());
+    } else if (library->unprobed() > 0) {
+        ImGui::TextDisabled("%zu of %zu sounds, probing %zu", found.size(), library->size(), library->unprobed());
+    } else {
+        ImGui::TextDisabled("%zu of %zu sounds", found.size(), library->size());
+    }
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Stop")) {
+        library->stopAudition();
+    }
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Rescan")) {
+        library->rescan();
+    }
+    ImGui::BeginChild("sounds", ImVec2(0, 0), ImGuiChildFlags_Borders);
+    float infoWidth = ImGui::GetFontSize() * 16;
+    ImGuiListClipper clipper;
+    clipper.Begin(found.size());
+    LibraryEntry e;
+    while (clipper.Step()) {
+        for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+            if (!library->entry(found[row], e)) {
+                continue;
+            }
+            ImGui::PushID(row);
+            if (ImGui::SmallButton(">")) {
+                library->audition(library->root() / std::filesystem::u8path(e.path));
+            }
+            ImGui::SameLine();
+            ImGui::Selectable(e.path.c_str(), false, 0, ImVec2(ImGui::GetContentRegionAvail().x - infoWidth, 0));
+            if (ImGui::BeginDragDropSource()) {
+                auto full = (library->root() / std::filesystem::u8path(e.path)).u8string();
+                ImGui::SetDragDropPayload("LIBRARY_SOUND", full.c_str(), full.size() + 1);
+                ImGui::Text("%s", e.path.c_str());
+                ImGui::EndDragDropSource();
+            }
+            ImGui::SameLine();
+            if (e.freq > 0) {
+                ImGui::TextDisabled("%6.1fs %dch %5d Hz %5.1f dB", e.duration, e.channels, e.freq, e.loudness);
+            } else {
+                ImGui::TextDisabled(e.freq < 0 ? "can't decode" : "...");
+            }
+            ImGui::PopID();
+        }
+    }
+    ImGui::EndChild();
+    ImGui::End();
+}
+
+// Shown profile and warm ones, as their counters are now
+static void collectResources(AppState *state, ResourceReport &report) {
+    if (state->selected) {
+        std::lock_guard<std::mutex> padGuard(state->engine->padLock);
+        report.add(state->currentProfile.filename().u8string(), *state->selected, true);
+    }
+    state->profiles->forEachWarm([&report](const std::filesystem::path &path, SoundPad &pad) {
+        report.add(path.filename().u8string(), pad, false);
+    });
+    report.finish();
+}
+
+static bool dumpResources(AppState *state) {
+    ResourceReport report;
+    collectResources(state, report);
+    auto json = report.json();
+    if (state->dumpResources == "-") {
+        fwrite(json.data(), 1, json.size(), stdout);
+        fflush(stdout);
+        return true;
+    }
+    if (!writeFileAtomic(std::filesystem::u8path(state->dumpResources), json)) {
+        SDL_Log("Failed to dump resources to %s", state->dumpResources.c_str());
+        return false;
+    }
+    return true;
+}
+
+static const char *kib(size_t bytes) {
+    static char buf[32];
+    SDL_snprintf(buf, sizeof(buf), "%.1f KiB", bytes / 1024.0);
+    return buf;
+}
+
+// Where the memory goes; refreshed once a second, not every frame
+static void ShowResources(AppState *state) {
+    ImGui::SetNextWindowSize(ImVec2(ImGui::GetFontSize() * 48, ImGui::GetFontSize() * 28), ImGuiCond_FirstUseEver);
+    if (!ImGui::Begin("Resources", &state->showResources)) {
+        ImGui::End();
+        return;
+    }
+    bool refresh = ImGui::SmallButton("Refresh");
+    if (refresh || !state->resources || SDL_GetTicksNS() - state->resources->takenAt > 1000000000) {
+        delete state->resources;
+        state->resources = new ResourceReport();
+        collectResources(state, *state->resources);
+    }
+    auto &report = *state->resources;
+    ImGui::SameLine();
+    if (ImGui::SmallButton("Save JSON")) {
+        auto target = appCfg->appdir / "resources.json";
+        if (writeFileAtomic(target, report.json())) {
+            SDL_Log("Saved resources to %s", target.u8string().c_str());
+        }
+    }
+    auto &t = report.totals;
+    if (report.processKnown) {
+        ImGui::Text("Process: RSS %.1f MiB, heap %.1f MiB", report.process.rss / (1024.0 * 1024.0), report.process.heap / (1024.0 * 1024.0));
+    }
+    ImGui::Text("Font atlas: %dx%d, %s", report.fontAtlasWidth, report.fontAtlasHeight, kib(report.fontAtlasBytes));
+    ImGui::Text("Sounds: %u decoded, %.1f MiB; %.1f MiB mapped; decoding took %.1f ms",
+        t.sounds, t.audioBytes / (1024.0 * 1024.0), t.mappedBytes / (1024.0 * 1024.0), t.soundLoadNS / 1000000.0);
+    ImGui::Text("Pictures: %u, %.1f MiB of textures; loading took %.1f ms",
+        t.pictures, t.pictureBytes / (1024.0 * 1024.0), t.pictureLoadNS / 1000000.0);
+    ImGui::Text("Tracks: %u allocated, %u playing", t.tracksAllocated, t.tracksPlaying);
+    auto &tiers = state->tiering->stats();
+    auto triggers = tiers.hits + tiers.misses;
+    if (tiers.budget > 0) {
+        ImGui::Text("Memory budget: %.1f of %.1f MiB decoded, %u pads encoded", tiers.bytes / (1024.0 * 1024.0),
+            tiers.budget / (1024.0 * 1024.0), tiers.demoted);
+    } else {
+        ImGui::Text("Memory budget: none, %.1f MiB decoded, %u pads still encoded", tiers.bytes / (1024.0 * 1024.0), tiers.demoted);
+    }
+    ImGui::Text("Tiering: %llu demoted, %llu promoted; %llu of %llu triggers decoded (%.1f%%)",
+        (unsigned long long) tiers.demotions, (unsigned long long) tiers.promotions, (unsigned long long) tiers.hits,
+        (unsigned long long) triggers, triggers ? 100.0 * tiers.hits / triggers : 100.0);
+    for (auto &profile : report.profiles) {
+        char header[300];
+        SDL_snprintf(header, sizeof(header), "%s%s, loaded in %.1f ms###%s", profile.name.c_str(),
+            profile.shown ? " (shown)" : " (warm)", profile.loadNS / 1000000.0, profile.name.c_str());
+        if (!ImGui::CollapsingHeader(header, profile.shown ? ImGuiTreeNodeFlags_DefaultOpen : 0)) {
+            continue;
+        }
+        if (!ImGui::BeginTable(profile.name.c_str(), 6, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit)) {
+            continue;
+        }
+        ImGui::TableSetupColumn("Pad");
+        ImGui::TableSetupColumn("Sound", ImGuiTableColumnFlags_WidthStretch);
+        ImGui::TableSetupColumn("Audio");
+        ImGui::TableSetupColumn("Tracks");
+        ImGui::TableSetupColumn("Picture");
+        ImGui::TableSetupColumn("Load");
+        ImGui::TableHeadersRow();
+        for (auto &r : profile.pads) {
+            ImGui::TableNextRow();
+            ImGui::TableNextColumn();
+            ImGui::Text("%c", r.letter);
+            ImGui::TableNextColumn();
+            if (r.res.variants > 0) {
+                ImGui::Text("%s (+%u)", r.sound.c_str(), r.res.variants);
+            } else {
+                ImGui::TextUnformatted(r.sound.c_str());
+            }
+            ImGui::TableNextColumn();
+            if (!r.sound.empty()) {
+                ImGui::Text("%lld x %d x %s, %s%s", (long long) r.res.audioFrames, r.res.audioChannels,
+                    SDL_GetAudioFormatName(r.res.audioFormat), kib(r.res.audioBytes),
+                    r.res.audioMapped ? " mapped" : r.res.audioEncoded ? " encoded" : r.sharedSound ? " shared" : "");
+                if (r.res.variantBytes > 0) {
+                    ImGui::SameLine();
+                    ImGui::Text("+ %s", kib(r.res.variantBytes));
+                }
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%u / %u", r.tracksPlaying, r.tracksAllocated);
+            ImGui::TableNextColumn();
+            if (r.res.pictureBytes > 0) {
+                ImGui::Text("%dx%d, %s", r.res.pictureWidth, r.res.pictureHeight, kib(r.res.pictureBytes));
+            }
+            ImGui::TableNextColumn();
+            ImGui::Text("%.1f + %.1f ms", r.res.soundLoadNS / 1000000.0, r.res.pictureLoadNS / 1000000.0);
+        }
+        ImGui::EndTable();
+    }
+    ImGui::End();
+}
+
+// Mixer thread, every block: where traced commands end up being heard, and the recording
+static void SDLCALL onMixed(void *userdata, MIX_Mixer *mixer, const SDL_AudioSpec *spec, float *pcm, int samples) {
+    static thread_local bool named = false;
+    if (!named) {
+        named = true;
+        if (!SDL_IsMainThread()) { // replays mix on the main thread
+            tracer.nameThread("audio");
+        }
+    }
+    capture.mixed(pcm, samples);
+    tracer.mixed(samples / std::max(spec->channels, 1), spec->freq);
+}
+
+static void onPadStateChanged(void *userdata, const Pad &pad) {
+    auto state = static_cast<AppState *>(userdata);
+    if (state->control) {
+        state->control->notify(pad.letter, pad.state);
+    }
+}
+
 const char *helpContent[] = {
                     "\tTo interact with a pad, click on it (or press its corresponding key). Ctrl, Alt and Shift modifiers can be used.",
                     "\tTo configure a pad, click on it with right mouse button.",
@@ -156,27 +645,64 @@ const Help appAbout = {
 
 /* This function runs once at startup. */
 SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
-    if (argc > 1) {
-        if (strcmp(argv[1], "--help") == 0 || strcmp(argv[1], "-h") == 0) {
+    const char *startProfile = nullptr;
+    const char *recordPath = nullptr;
+    const char *replayPath = nullptr;
+    const char *dumpPath = nullptr;
+    const char *tracePath = nullptr;
+    tracer.nameThread("main");
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--help") == 0 || strcmp(argv[i], "-h") == 0) {
             printf("Usage: %s [OPTIONS]\n", argv[0]);
             printf("Options:\n");
             printf("\t--help, -h         \tShow this help message and exit\n");
             printf("\t--version, -v      \tShow version information and exit\n");
             printf("\t--profile <PROFILE>\tLoad the specified profile on startup\n");
+            printf("\t--record <FILE>    \tRecord input into the file\n");
+            printf("\t--replay <FILE>    \tReplay recorded input offscreen as fast as possible, print stats and exit\n");
+            printf("\t--trace-startup    \tPrint wall time of startup phases once the first frame is shown\n");
+            printf("\t--dump-resources <FILE|->\tWrite memory held by loaded profiles as JSON once the first frame\n"
+                   "\t                   \tis shown (or the replay is over) and exit\n");
+            printf("\t--trace <FILE>     \tWrite recent frame, engine and I/O events as Chrome trace JSON on exit\n");
+            printf("Set controlsocket=<path> in config.ini to enable the control socket,\n");
+            printf("osc=1 (and oschost, oscport) to enable OSC input.\n");
             return SDL_APP_SUCCESS;
-        }
-        if (strcmp(argv[1], "--version") == 0 || strcmp(argv[1], "-v") == 0) {
+        } else if (strcmp(argv[i], "--version") == 0 || strcmp(argv[i], "-v") == 0) {
             printf("Soundpad version " SOUNDPAD_VERSION "\n");
             return SDL_APP_SUCCESS;
+        } else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+            startProfile = argv[++i];
+        } else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--dump-resources") == 0 && i + 1 < argc) {
+            dumpPath = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--trace-startup") == 0) {
+            startupTrace.enable();
+        } else {
+            printf("Unknown option %s, see --help\n", argv[i]);
+            return SDL_APP_FAILURE;
         }
     }
 
+    if (replayPath) {
+        SDL_SetHint(SDL_HINT_VIDEO_DRIVER, "offscreen");
+        SDL_SetHint(SDL_HINT_AUDIO_DRIVER, "dummy");
+    }
+
     SDL_SetAppMetadata("ft's soundpad", SOUNDPAD_VERSION, "name.faerytea.soundpad");
 
-    if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
-        SDL_Log("Couldn't initialize SDL: %s", SDL_GetError());
-        return SDL_APP_FAILURE;
+    {
+        StartupPhase phase("sdl init");
+        if (!SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO)) {
+            SDL_Log("Couldn't initialize SDL: %s", SDL_GetError());
+            return SDL_APP_FAILURE;
+        }
     }
+    auto windowStart = SDL_GetTicksNS();
 
     float main_scale = SDL_GetDisplayContentScale(SDL_GetPrimaryDisplay());
     SDL_WindowFlags window_flags = SDL_WINDOW_RESIZABLE | SDL_WINDOW_HIDDEN | SDL_WINDOW_HIGH_PIXEL_DENSITY;
@@ -195,6 +721,9 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
     }
     SDL_SetWindowPosition(window, SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
     SDL_ShowWindow(window);
+    if (startupTrace.enabled()) {
+        startupTrace.phase("window", windowStart, SDL_GetTicksNS());
+    }
 
 #ifdef APP_ICON
     const auto exePath = std::filesystem::u8path(SDL_GetBasePath());
@@ -214,6 +743,7 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
     }
 #endif
 
+    auto imguiStart = SDL_GetTicksNS();
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -232,43 +762,109 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
     // Setup Platform/Renderer backends
     ImGui_ImplSDL3_InitForSDLRenderer(window, renderer);
     ImGui_ImplSDLRenderer3_Init(renderer);
-
-    if (!MIX_Init()) {
-        SDL_Log("Couldn't initialize SDL_mixer: %s", SDL_GetError());
-        return SDL_APP_FAILURE;
+    if (startupTrace.enabled()) {
+        startupTrace.phase("imgui", imguiStart, SDL_GetTicksNS());
     }
 
-    mixer = MIX_CreateMixerDevice(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, nullptr);
-    if (mixer == nullptr) {
-        SDL_Log("Couldn't create mixer device: %s", SDL_GetError());
-        return SDL_APP_FAILURE;
+    {
+        StartupPhase phase("mixer init");
+        if (!MIX_Init()) {
+            SDL_Log("Couldn't initialize SDL_mixer: %s", SDL_GetError());
+            return SDL_APP_FAILURE;
+        }
     }
 
-    SDL_Log("SDL init success");
+    // opening the device takes a while, config and fonts are loaded meanwhile
+    std::thread mixerOpen([replayPath]() {
+        StartupPhase phase("mixer device");
+        if (replayPath) {
+            // replay mixes on the fake clock, so audio progresses with frames, not wall time
+            SDL_AudioSpec spec = { SDL_AUDIO_F32, 2, 48000 };
+            mixer = MIX_CreateMixer(&spec);
+        } else {
+            mixer = audioOutput.createMixer(); // the device is opened once the config names it
+        }
+        if (mixer == nullptr) {
+            SDL_Log("Couldn't create mixer device: %s", SDL_GetError()); // errors are per thread
+        }
+    });
 
-    appCfg = loadAppConfig();
-    if (!appCfg) {
+    {
+        StartupPhase phase("config");
+        appCfg = loadAppConfig();
+    }
+    mixerOpen.join();
+    if (mixer == nullptr || !appCfg) {
         return SDL_APP_FAILURE;
     }
+    tracer.enable(appCfg->trace || tracePath);
+    tracer.setDirectory(appCfg->appdir / "traces");
+    if (!MIX_SetPostMixCallback(mixer, onMixed, nullptr)) {
+        SDL_Log("Mixed blocks won't be traced: %s", SDL_GetError());
+    }
+    if (!replayPath) {
+        audioOutput.select(appCfg->outputDevice);
+    }
+
+    SDL_Log("SDL init success");
 
     auto state = new AppState();
 
     SDL_Log("Appdir: %s", appCfg->appdir.u8string().c_str());
 
-    if (argc > 2 && strcmp(argv[1], "--profile") == 0) {
-        const std::string_view profile = argv[2];
-        for (const auto &p : appCfg->profiles) {
-            if (p.filename().u8string() == profile) {
-                SoundPad *newPad = loadSoundPad(p, mixer);
-                state->selected = newPad;
-                state->currentProfile = p;
-            }
+    if (replayPath) {
+        state->replayer = new InputReplayer();
+        if (!state->replayer->open(std::filesystem::u8path(replayPath))) {
+            return SDL_APP_FAILURE;
+        }
+        appCfg->autosave = false;
+    } else if (recordPath) {
+        state->recorder = new InputRecorder();
+        if (!state->recorder->open(std::filesystem::u8path(recordPath))) {
+            delete state->recorder;
+            state->recorder = nullptr;
+        }
+    }
+
+    state->engine->start();
+    state->saver->start();
+    state->profiles = new ProfileCache(mixer, appCfg->warmCacheMB * 1024 * 1024);
+    state->profiles->start();
+    if (!replayPath) {
+        state->library = new Library(mixer);
+    }
+    Pad::setStateListener(onPadStateChanged, state);
+    if (!appCfg->controlSocket.empty()) {
+        state->control = new ControlServer(state->engine, std::filesystem::u8path(appCfg->controlSocket));
+        if (!state->control->start()) {
+            delete state->control;
+            state->control = nullptr;
+        }
+    }
+    if (appCfg->osc) {
+        state->osc = new OscServer(state->engine, appCfg->oscHost, appCfg->oscPort);
+        if (!state->osc->start()) {
+            delete state->osc;
+            state->osc = nullptr;
+        }
+    }
+
+    if (startProfile) {
+        StartupPhase phase("profile load");
+        if (auto entry = appCfg->catalog.find(startProfile)) {
+            switchProfile(state, takeOrLoad(state, entry->path), entry->path);
         }
         if (state->selected == nullptr) {
-            SDL_Log("Profile %s not found, loading selector", profile.data());
+            SDL_Log("Profile %s not found, loading selector", startProfile);
         }
     }
 
+    if (dumpPath) {
+        state->dumpResources = dumpPath;
+    }
+    if (tracePath) {
+        state->dumpTrace = tracePath;
+    }
     *appstate = state;
 
     // SDL_SetRenderLogicalPresentation(renderer, 1280 * main_scale, 800 * main_scale, SDL_LOGICAL_PRESENTATION_LETTERBOX);
@@ -278,6 +874,41 @@ SDL_AppResult SDL_AppInit(void **appstate, int argc, char *argv[]) {
 
 /* This function runs when a new event (mouse input, keypresses, etc) occurs. */
 SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event) {
+    auto state = static_cast<AppState *>(appstate);
+    if (state->replayer && !state->injecting && event->type != SDL_EVENT_QUIT) {
+        return SDL_APP_CONTINUE; // only recorded input counts
+    }
+    if (state->recorder) {
+        state->recorder->record(*event);
+    }
+    if (event->type == SDL_EVENT_KEY_DOWN && event->key.key == SDLK_F12 && !event->key.repeat && !state->injecting) {
+        tracer.save();
+    }
+    if ((event->type == SDL_EVENT_KEY_DOWN || event->type == SDL_EVENT_KEY_UP) && !event->key.repeat
+        && state->selected && !state->selectedPad && !ImGui::GetIO().WantTextInput) {
+        // pads are looked up per key event instead of polling every pad every frame
+        if (event->key.key == SDLK_SPACE) {
+            if (event->key.down) {
+                Command cmd;
+                cmd.type = CMD_STOP_ALL;
+                cmd.issued = SDL_GetTicksNS();
+                state->engine->submit(cmd);
+            }
+        } else if (Pad *pad = state->selected->findKey(event->key.key)) {
+            // from the OS to here: a slow frame shows up as a long one
+            tracer.span("input", event->key.down ? "key down" : "key up",
+                state->injecting ? SDL_GetTicksNS() : event->key.timestamp, SDL_GetTicksNS(), pad->letter);
+            if (event->key.down) {
+                auto mod = event->key.mod;
+                state->engine->press(pad->letter, mod & SDL_KMOD_CTRL, mod & SDL_KMOD_SHIFT, mod & SDL_KMOD_ALT);
+            } else {
+                state->engine->release(pad->letter);
+            }
+        }
+    }
+    if (event->type == SDL_EVENT_AUDIO_DEVICE_ADDED || event->type == SDL_EVENT_AUDIO_DEVICE_REMOVED) {
+        audioOutput.handleEvent(*event);
+    }
     if (ImGui_ImplSDL3_ProcessEvent(event)) return SDL_APP_CONTINUE;
     if (event->type == SDL_EVENT_QUIT) {
         return SDL_APP_SUCCESS;  /* end the program, reporting success to the OS. */
@@ -288,7 +919,10 @@ SDL_AppResult SDL_AppEvent(void *appstate, SDL_Event *event) {
 /* This function runs once per frame, and is the heart of the program. */
 SDL_AppResult SDL_AppIterate(void *appstate) {
     auto state = static_cast<AppState *>(appstate);
-    auto now = SDL_GetTicks();
+    if (state->replayer) {
+        state->replayClock += 16;
+    }
+    auto now = state->replayer ? state->replayClock : SDL_GetTicks();
     auto lastAI = state->lastFrame;
     if (now - lastAI < 16) {
         SDL_Delay(16 - now + lastAI);
@@ -299,6 +933,46 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
         return SDL_APP_CONTINUE;
     }
     state->lastFrame = now;
+    auto frameStart = SDL_GetTicksNS();
+    TraceSpan frameSpan("frame", "frame");
+    if (state->replayer) {
+        ReplayEvent re;
+        while (state->replayer->next(now, re)) {
+            if (re.isProfile) {
+                if (re.profile.empty()) {
+                    switchProfile(state, nullptr, std::filesystem::path());
+                }
+                if (auto entry = appCfg->catalog.find(re.profile)) {
+                    // synchronously, so replays stay deterministic
+                    switchProfile(state, takeOrLoad(state, entry->path), entry->path);
+                }
+                continue;
+            }
+            if (re.event.type == SDL_EVENT_WINDOW_RESIZED) {
+                SDL_SetWindowSize(window, re.event.window.data1, re.event.window.data2);
+            }
+            re.event.window.windowID = SDL_GetWindowID(window); // windowID has the same offset in all recorded events
+            state->injecting = true;
+            SDL_AppEvent(appstate, &re.event);
+            state->injecting = false;
+        }
+        state->engine->wait(); // replays must not depend on thread timing
+    }
+    auto remoteProfile = state->engine->takeProfileRequest();
+    if (!remoteProfile.empty()) {
+        if (auto entry = appCfg->catalog.find(remoteProfile)) {
+            requestSwitch(state, entry->path);
+        } else {
+            SDL_Log("Requested profile %s not found", remoteProfile.c_str());
+        }
+    }
+    completeSwitch(state);
+    jobs.drainMain(2000000); // textures of preloaded profiles
+    appCfg->catalog.update();
+    // indexing starts once the library is first shown, and follows baseRoot changes
+    if (state->showLibrary && !appCfg->baseRoot.empty() && state->library->root() != appCfg->baseRoot) {
+        state->library->open(appCfg->baseRoot, appCfg->appdir / "library.idx");
+    }
 #ifdef FPS
     ++(state->fps);
     auto nowNs = SDL_GetTicksNS();
@@ -313,6 +987,9 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
     ImGuiIO& io = ImGui::GetIO();
     ImGui_ImplSDLRenderer3_NewFrame();
     ImGui_ImplSDL3_NewFrame();
+    if (state->replayer) {
+        io.DeltaTime = 16 / 1000.f;
+    }
     ImGui::NewFrame();
     // ImGui::ShowDemoWindow();
     auto sp = state->selected;
@@ -320,23 +997,99 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
         ImGui::SetNextWindowPos(ImGui::GetMainViewport()->GetWorkCenter(), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
         ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiCond_Always);
         ImGui::Begin("Select profile", nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize | ImGuiWindowFlags_NoMove);
-        for (auto pi = appCfg->profiles.begin(); pi != appCfg->profiles.end();) {
-            auto &p = *pi;
-            auto tp = p.filename().stem().u8string();
-            if (ImGui::Button((std::string("X##") + tp).c_str())) {
-                std::filesystem::remove(p);
-                std::filesystem::remove_all(std::filesystem::u8path(tp) / "");
-                appCfg->profiles.erase(pi);
-            } else {
-                ++pi;
-            }
-            ImGui::SameLine();
-            if (ImGui::Button(p.filename().u8string().c_str(), ImVec2(-1, 0))) {
-                SoundPad *newPad = loadSoundPad(p, mixer);
-                state->selected = newPad;
-                state->currentProfile = p;
+        static char profileQuery[128];
+        bool open = ImGui::InputTextWithHint("##search", "search by name or tag, Enter opens the first", profileQuery, sizeof(profileQuery), ImGuiInputTextFlags_EnterReturnsTrue);
+        auto &catalog = appCfg->catalog;
+        auto &found = catalog.search(profileQuery);
+        if (open && !found.empty()) {
+            requestSwitch(state, catalog.entries()[found[0]].path);
+        }
+        // only visible rows are laid out, so thousands of profiles cost as much as a screenful
+        ImGui::BeginChild("profiles", ImVec2(ImGui::GetFontSize() * 36, ImGui::GetTextLineHeightWithSpacing() * 16), ImGuiChildFlags_Borders);
+        ImGuiListClipper clipper;
+        clipper.Begin(found.size());
+        while (clipper.Step()) {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row) {
+                auto index = found[row];
+                auto &e = catalog.entries()[index];
+                ImGui::PushID((int) index);
+                if (ImGui::Button("X")) {
+                    state->profiles->forget(e.path);
+                    std::filesystem::remove(e.path);
+                    std::filesystem::remove_all(e.path.parent_path() / e.path.stem());
+                    assetStore.dropRefs(e.path.filename().u8string());
+                    catalog.changed(e.path); // gone from the list next frame
+                }
+                ImGui::SameLine();
+                if (ImGui::Button("Export")) {
+                    SDL_ShowSaveFileDialog(
+                        [](void *userdata, const char * const *filelist, int filter) {
+                            auto p = static_cast<std::pair<std::filesystem::path, bool> *>(userdata);
+                            if (filelist && filelist[0]) {
+                                auto target = std::filesystem::u8path(filelist[0]);
+                                if (target.extension() != ".spack") {
+                                    target += ".spack";
+                                }
+                                if (!exportSoundPad(p->first, target, p->second, mixer)) {
+                                    SDL_Log("Failed to export %s", p->first.u8string().c_str());
+                                }
+                            }
+                            delete p;
+                        },
+                        new std::pair<std::filesystem::path, bool>(e.path, state->exportPCM),
+                        window,
+                        &packFileFilter,
+                        1,
+                        (appCfg->baseRoot / e.path.stem()).concat(".spack").u8string().c_str()
+                    );
+                }
+                ImGui::SameLine();
+                float infoX = ImGui::GetFontSize() * 20;
+                if (ImGui::Selectable(e.name.c_str(), e.path == state->pendingProfile, 0, ImVec2(infoX - ImGui::GetCursorPosX(), 0))) {
+                    requestSwitch(state, e.path);
+                }
+                if (ImGui::BeginPopupContextItem("tags")) {
+                    static char tags[128];
+                    if (ImGui::IsWindowAppearing()) {
+                        SDL_strlcpy(tags, e.tags.c_str(), sizeof(tags));
+                    }
+                    ImGui::Text("Tags of %s", e.name.c_str());
+                    if (ImGui::InputText("##tags", tags, sizeof(tags), ImGuiInputTextFlags_EnterReturnsTrue)) {
+                        catalog.setTags(index, tags);
+                        ImGui::CloseCurrentPopup();
+                    }
+                    ImGui::EndPopup();
+                }
+                ImGui::SameLine(infoX + ImGui::GetStyle().ItemSpacing.x);
+                ImGui::TextDisabled("%s", e.info.c_str());
+                ImGui::PopID();
             }
         }
+        ImGui::EndChild();
+        ImGui::TextDisabled("%zu of %zu profiles, right-click one to tag it", found.size(), catalog.entries().size());
+        if (!state->pendingProfile.empty()) {
+            ImGui::Text("Loading %s...", state->pendingProfile.filename().u8string().c_str());
+        }
+        ImGui::Checkbox("Export sounds decoded (bigger, opens faster)", &state->exportPCM);
+        if (ImGui::Button("Import bundle...", ImVec2(-1, 0))) {
+            SDL_ShowOpenFileDialog(
+                [](void *userdata, const char * const *filelist, int filter) {
+                    if (filelist && filelist[0]) {
+                        auto cfg = static_cast<AppConfig *>(userdata);
+                        auto imported = importSoundPad(std::filesystem::u8path(filelist[0]), cfg->appdir / "profiles");
+                        if (!imported.empty()) {
+                            cfg->catalog.changed(imported);
+                        }
+                    }
+                },
+                appCfg,
+                window,
+                &packFileFilter,
+                1,
+                appCfg->baseRoot.u8string().c_str(),
+                false
+            );
+        }
         ImGui::Text("...or create a new one:");
         static char newProfileName[254];
         ImGui::InputTextWithHint("##new profile", "new profile", newProfileName, sizeof(newProfileName) - 4);
@@ -358,11 +1111,11 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
                     std::filesystem::create_directories(newPath.parent_path());
                     SoundPad *newPad = createDefault(mixer);
                     if (newPad) {
-                        static_cast<AppState *>(appstate)->selected = newPad;
                         SDL_Log("Created new profile %s", newPath.u8string().c_str());
                         saveSoundPad(newPath, newPad);
-                        appCfg->profiles.push_back(newPath);
-                        state->currentProfile = newPath;
+                        appCfg->catalog.changed(newPath);
+                        appCfg->catalog.update();
+                        switchProfile(state, newPad, newPath);
                     } else {
                         SDL_Log("Failed to create new profile %s", newPath.u8string().c_str());
                     }
@@ -374,17 +1127,54 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
     } else {
         ImGui::BeginMainMenuBar();
         if (ImGui::MenuItem("Change profile")) {
-            saveSoundPad(state->currentProfile, state->selected);
-            state->currentProfile = std::filesystem::path();
-            delete state->selected;
-            state->selected = nullptr;
-            state->selectedPad = nullptr;
+            saveCurrent(state);
+            switchProfile(state, nullptr, std::filesystem::path());
+        }
+        if (ImGui::BeginMenu("Switch to")) {
+            // most recently used ones, the selector has everything else
+            auto &recent = appCfg->catalog.search("");
+            for (size_t i = 0; i < recent.size() && i < 20; ++i) {
+                auto &p = appCfg->catalog.entries()[recent[i]].path;
+                if (p == state->currentProfile) {
+                    continue;
+                }
+                bool warm = state->profiles->isWarm(p);
+                if (ImGui::MenuItem(p.filename().u8string().c_str(), warm ? "warm" : nullptr, p == state->pendingProfile)) {
+                    requestSwitch(state, p);
+                }
+            }
+            ImGui::EndMenu();
+        }
+        ImGui::MenuItem("Resources", nullptr, &state->showResources);
+        char recorded[64] = "";
+        if (capture.recording()) {
+            SDL_snprintf(recorded, sizeof(recorded), "%.0f s, %llu dropped",
+                (double) capture.writtenFrames() / std::max(capture.rate(), 1), (unsigned long long) capture.droppedBlocks());
+        }
+        if (ImGui::MenuItem("Record show", recorded, capture.recording())) {
+            if (capture.recording()) {
+                capture.stop();
+            } else {
+                CaptureSettings cs;
+                cs.dir = appCfg->appdir / "recordings";
+                cs.floats = appCfg->recordFloats;
+                cs.splitBytes = (Uint64) appCfg->recordSplitMB * 1024 * 1024;
+                cs.splitSeconds = (Uint64) appCfg->recordSplitMinutes * 60;
+                capture.start(mixer, cs);
+            }
+        }
+        if (ImGui::MenuItem("Save trace", "F12", false, tracer.enabled())) {
+            tracer.save();
+        }
+        if (state->library && ImGui::MenuItem("Library", nullptr, &state->showLibrary)
+            && state->showLibrary && state->library->root() == appCfg->baseRoot) {
+            state->library->rescan();
         }
         if (appCfg->autosave) {
             ImGui::Text("Autosave enabled");
         } else {
             if (ImGui::MenuItem(("Save " + state->currentProfile.filename().u8string()).c_str())) {
-                if (saveSoundPad(state->currentProfile, state->selected)) {
+                if (saveCurrent(state)) {
                     SDL_Log("Saved profile %s", state->currentProfile.u8string().c_str());
                 } else {
                     SDL_Log("Failed to save profile %s", state->currentProfile.u8string().c_str());
@@ -393,6 +1183,58 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
         }
         if (ImGui::BeginMenu("Settings")) {
             ImGui::MenuItem("Autosave", nullptr, &(appCfg->autosave));
+            if (ImGui::MenuItem("Trace events", nullptr, &(appCfg->trace))) {
+                tracer.enable(appCfg->trace);
+            }
+            if (ImGui::MenuItem("Resample on load", nullptr, &(appCfg->resampleOnLoad))) {
+                resampleOnLoad = appCfg->resampleOnLoad; // sounds loaded from now on
+            }
+            if (ImGui::BeginMenu("Sample storage")) {
+                for (int i = STORAGE_FLOAT; i <= STORAGE_ENCODED; ++i) {
+                    auto storage = static_cast<SampleStorage>(i);
+                    if (ImGui::MenuItem(storageName(storage), nullptr, appCfg->sampleStorage == storage)) {
+                        appCfg->sampleStorage = storage;
+                        storageOnLoad = storage; // likewise
+                    }
+                }
+                ImGui::EndMenu();
+            }
+            ImGui::SetNextItemWidth(100);
+            ImGui::InputScalar("Memory budget MB (0 for none)", ImGuiDataType_U32, &appCfg->memoryBudgetMB);
+            if (ImGui::BeginMenu("Recording")) {
+                if (ImGui::MenuItem("16-bit WAV", nullptr, !appCfg->recordFloats)) {
+                    appCfg->recordFloats = false;
+                }
+                if (ImGui::MenuItem("32-bit float WAV", nullptr, appCfg->recordFloats)) {
+                    appCfg->recordFloats = true;
+                }
+                ImGui::SetNextItemWidth(100);
+                ImGui::InputScalar("Split at MB (0 for none)", ImGuiDataType_U32, &appCfg->recordSplitMB);
+                ImGui::SetNextItemWidth(100);
+                ImGui::InputScalar("Split after minutes (0 for none)", ImGuiDataType_U32, &appCfg->recordSplitMinutes);
+                ImGui::TextDisabled("Applies to the next recording");
+                ImGui::EndMenu();
+            }
+            if (ImGui::BeginMenu("Output device", !state->replayer)) {
+                if (ImGui::MenuItem("System default", nullptr, appCfg->outputDevice.empty())) {
+                    appCfg->outputDevice.clear();
+                    audioOutput.select(appCfg->outputDevice);
+                }
+                for (auto &d : AudioOutput::devices()) {
+                    if (ImGui::MenuItem(d.c_str(), nullptr, d == appCfg->outputDevice)) {
+                        appCfg->outputDevice = d;
+                        audioOutput.select(appCfg->outputDevice);
+                    }
+                }
+                ImGui::Separator();
+                auto playing = audioOutput.current();
+                ImGui::TextDisabled("Playing on %s", playing.empty() ? "nothing yet" : playing.c_str());
+                if (audioOutput.lastGapNS() > 0) {
+                    ImGui::TextDisabled("Silent for %.1f ms at the last switch, %.1f ms at most",
+                        audioOutput.lastGapNS() / 1000000.0, audioOutput.worstGapNS() / 1000000.0);
+                }
+                ImGui::EndMenu();
+            }
             if (ImGui::MenuItem("Base sound dir")) {
                 SDL_ShowOpenFolderDialog(
                     [](void *userdata, const char * const *filelist, int filter) {
@@ -498,26 +1340,39 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
         ImGui::Text("FPS: %lu", realFPS);
 #endif
         ImGui::EndMainMenuBar();
+        Pad *hoveredPad = nullptr;
         if (state->selected) {
-            Pad *selectedPad = ShowSoundPad(*sp, state->selectedPad == nullptr, appCfg->fontMono);
+            Pad *dropTarget = nullptr;
+            std::string dropped;
+            Pad *selectedPad = ShowSoundPad(*sp, *state->engine, state->selectedPad == nullptr, appCfg->fontMono, &dropTarget, &dropped,
+                &hoveredPad);
             if (state->selectedPad == nullptr) {
                 state->selectedPad = selectedPad;
             }
+            if (dropTarget) {
+                assignSound(state, sp, dropTarget->letter, std::filesystem::u8path(dropped));
+            }
+            if (state->showLibrary) {
+                ShowLibrary(state);
+            }
         }
+        state->tiering->setBudget((size_t) appCfg->memoryBudgetMB * 1024 * 1024);
+        state->tiering->update(state->replayer ? nullptr : state->selected, *state->engine, hoveredPad);
         static bool cfgAlt, cfgCtrl, cfgShift;
         if (ImGui::IsKeyPressed(ImGuiKey_Escape)) {
             state->selectedPad = nullptr;
         }
+        bool saveNow = false; // once the pad is unlocked
         if (state->selectedPad != nullptr) {
+            // the engine thread applies commands to the same pad
+            std::lock_guard<std::mutex> padGuard(state->engine->padLock);
             ImGui::SetNextWindowPos(ImGui::GetMainViewport()->GetWorkCenter(), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
             ImGui::SetNextWindowSize(ImVec2(0, 0), ImGuiCond_Always);
             char name[2] = {state->selectedPad->letter, 0};
             ImGui::Begin(name, nullptr, ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoCollapse | ImGuiWindowFlags_NoResize);
             if (ImGui::Button("X", ImVec2(0, 0))) {
-                state->selectedPad->unloadSound();
-                if (appCfg->autosave) {
-                    saveSoundPad(state->currentProfile, state->selected);
-                }
+                state->engine->assign(sp, state->selectedPad->letter, nullptr, std::string(), std::string());
+                markChanged(state, state->selectedPad);
             }
             ImGui::SameLine();
             auto &sName = state->selectedPad->name;
@@ -525,30 +1380,12 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
                 SDL_ShowOpenFileDialog(
                     [](void *userdata, const char * const *filelist, int filter) {
                         if (filelist && filelist[0]) {
-                            auto p = static_cast<std::tuple<Pad *, AppConfig *, AppState *> *>(userdata);
-                            auto pad = std::get<0>(*p);
-                            auto appCfg = std::get<1>(*p);
-                            auto state = std::get<2>(*p);
-                            auto appDir = appCfg->appdir;
-                            auto path = std::filesystem::u8path(filelist[0]);
-                            if (pad->loadSound(path.u8string())) {
-                                SDL_Log("Loaded sound %s on pad %c", pad->name.c_str(), pad->letter);
-                                auto base = appDir / "profiles" / state->currentProfile.stem();
-                                std::filesystem::create_directories(base);
-                                std::filesystem::copy_file(
-                                    path, 
-                                    base / std::filesystem::u8path(pad->name), 
-                                    std::filesystem::copy_options::create_hard_links | std::filesystem::copy_options::skip_existing
-                                );
-                                if (appCfg->autosave) {
-                                    saveSoundPad(state->currentProfile, state->selected);
-                                }
-                            } else {
-                                SDL_Log("Failed to load sound on pad %c", pad->letter);
-                            }
+                            // decoding here keeps the UI and the engine going
+                            auto p = static_cast<std::tuple<SoundPad *, char, AppState *> *>(userdata);
+                            assignSound(std::get<2>(*p), std::get<0>(*p), std::get<1>(*p), std::filesystem::u8path(filelist[0]));
                         }
                     },
-                    new std::tuple<Pad *, AppConfig *, AppState *>(state->selectedPad, appCfg, state), // will be deleted by the dialog
+                    new std::tuple<SoundPad *, char, AppState *>(sp, state->selectedPad->letter, state), // will be deleted by the dialog
                     window,
                     musicFileFilter,
                     sizeof(musicFileFilter) / sizeof(musicFileFilter[0]),
@@ -572,58 +1409,97 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
                         if (ImGui::Button("Confirm", ImVec2(-1, 0))) {
                             std::string oldName = sName;
                             sName = newName;
-                            auto appDir = appCfg->appdir;
-                            auto base = appDir / "profiles" / state->currentProfile.stem();
-                            std::filesystem::rename(
-                                base / std::filesystem::u8path(oldName), 
-                                base / std::filesystem::u8path(sName)
-                            );
-                            if (appCfg->autosave) {
-                                saveSoundPad(state->currentProfile, state->selected);
+                            if (state->selectedPad->soundKey.empty()) { // stored sounds are found by key
+                                auto appDir = appCfg->appdir;
+                                auto base = appDir / "profiles" / state->currentProfile.stem();
+                                std::filesystem::rename(
+                                    base / std::filesystem::u8path(oldName), 
+                                    base / std::filesystem::u8path(sName)
+                                );
                             }
+                            markChanged(state, state->selectedPad);
                             renameWindowOpen = false;
                         }
                     }
                     ImGui::End();
                 }
+                auto &variants = state->selectedPad->variants;
+                for (size_t i = 0; i < variants.size(); ++i) {
+                    ImGui::PushID((int) i);
+                    if (ImGui::Button("X##Remove variant", ImVec2(0, 0))) {
+                        Command cmd;
+                        cmd.type = CMD_VARIANT;
+                        cmd.letter = state->selectedPad->letter;
+                        cmd.index = (unsigned) i;
+                        cmd.issued = SDL_GetTicksNS();
+                        state->engine->submit(cmd);
+                        markChanged(state, state->selectedPad);
+                    }
+                    ImGui::SameLine();
+                    ImGui::Text("+ %s", variants[i].name.c_str());
+                    ImGui::PopID();
+                }
+                if (ImGui::Button("Add variant...", ImVec2(-1, 0))) {
+                    SDL_ShowOpenFileDialog(
+                        [](void *userdata, const char * const *filelist, int filter) {
+                            if (filelist && filelist[0]) {
+                                auto p = static_cast<std::tuple<SoundPad *, char, AppState *> *>(userdata);
+                                assignSound(std::get<2>(*p), std::get<0>(*p), std::get<1>(*p), std::filesystem::u8path(filelist[0]), true);
+                            }
+                        },
+                        new std::tuple<SoundPad *, char, AppState *>(sp, state->selectedPad->letter, state), // will be deleted by the dialog
+                        window,
+                        musicFileFilter,
+                        sizeof(musicFileFilter) / sizeof(musicFileFilter[0]),
+                        appCfg->baseRoot.u8string().c_str(),
+                        false
+                    );
+                }
+                if (!variants.empty() && ImGui::BeginCombo("Pick", pickName(state->selectedPad->pick))) {
+                    for (int i = PICK_ROUND_ROBIN; i <= PICK_NO_REPEAT; ++i) {
+                        bool isSelected = state->selectedPad->pick == i;
+                        if (ImGui::Selectable(pickName(static_cast<VariantPick>(i)), isSelected)) {
+                            state->selectedPad->pick = static_cast<VariantPick>(i); // read by the engine under padLock
+                            markChanged(state, state->selectedPad);
+                        }
+                        if (isSelected) {
+                            ImGui::SetItemDefaultFocus();
+                        }
+                    }
+                    ImGui::EndCombo();
+                }
+                if (ImGui::BeginCombo("Storage", storageName(state->selectedPad->storage))) {
+                    for (int i = STORAGE_DEFAULT; i <= STORAGE_ENCODED; ++i) {
+                        bool isSelected = state->selectedPad->storage == i;
+                        if (ImGui::Selectable(storageName(static_cast<SampleStorage>(i)), isSelected) && !isSelected) {
+                            state->selectedPad->storage = static_cast<SampleStorage>(i);
+                            reloadSound(state, sp, state->selectedPad);
+                            markChanged(state, state->selectedPad);
+                        }
+                        if (isSelected) {
+                            ImGui::SetItemDefaultFocus();
+                        }
+                    }
+                    ImGui::EndCombo();
+                }
                 auto picture = state->selectedPad->picturePath;
                 if (!picture.empty()) {
                     if (ImGui::Button("X##Clear picture", ImVec2(0, 0))) {
                         state->selectedPad->unloadPicture();
-                        if (appCfg->autosave) {
-                            saveSoundPad(state->currentProfile, state->selected);
-                        }
+                        markChanged(state, state->selectedPad);
                     }
                     ImGui::SameLine();
                 }
                 if (ImGui::Button(picture.empty() ? "Set picture" : picture.c_str(), ImVec2(-1, 0))) {
                     SDL_ShowOpenFileDialog(
                         [](void *userdata, const char * const *filelist, int filter) {
+                            auto p = static_cast<std::tuple<SoundPad *, char, AppState *> *>(userdata);
                             if (filelist && filelist[0]) {
-                                auto p = static_cast<std::tuple<Pad *, AppConfig *, AppState *> *>(userdata);
-                                auto pad = std::get<0>(*p);
-                                auto appCfg = std::get<1>(*p);
-                                auto state = std::get<2>(*p);
-                                auto appDir = appCfg->appdir;
-                                auto path = std::filesystem::u8path(filelist[0]);
-                                if (pad->loadPicture(path.u8string())) {
-                                    SDL_Log("Loaded picture %s on pad %c", pad->picturePath.c_str(), pad->letter);
-                                    auto base = appDir / "profiles" / state->currentProfile.stem();
-                                    std::filesystem::create_directories(base);
-                                    std::filesystem::copy_file(
-                                        path, 
-                                        base / std::filesystem::u8path(pad->picturePath), 
-                                        std::filesystem::copy_options::create_hard_links | std::filesystem::copy_options::skip_existing
-                                    );
-                                    if (appCfg->autosave) {
-                                        saveSoundPad(state->currentProfile, state->selected);
-                                    }
-                                } else {
-                                    SDL_Log("Failed to load picture on pad %c", pad->letter);
-                                }
+                                assignPicture(std::get<2>(*p), std::get<0>(*p), std::get<1>(*p), std::filesystem::u8path(filelist[0]));
                             }
+                            delete p;
                         },
-                        new std::tuple<Pad *, AppConfig *, AppState *>(state->selectedPad, appCfg, state), // will be deleted by the dialog
+                        new std::tuple<SoundPad *, char, AppState *>(sp, state->selectedPad->letter, state),
                         window,
                         imgFileFilter,
                         sizeof(imgFileFilter) / sizeof(imgFileFilter[0]),
@@ -633,9 +1509,7 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
                 }
                 if (!picture.empty()) {
                     if (ImGui::SliderInt("Picture opacity", &state->selectedPad->pictureOpacity, 0, 255)) {
-                        if (appCfg->autosave) {
-                            saveSoundPad(state->currentProfile, state->selected);
-                        }
+                        markChanged(state, state->selectedPad);
                     }
                 }
             }
@@ -670,12 +1544,10 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
                         bool isSelected = (state->selectedPad->table[cfgCtrl ? 1 : 0][cfgShift ? 1 : 0][cfgAlt ? 1 : 0][0] == i);
                         if (ImGui::Selectable(state->requestStrings[i], isSelected)) {
                             state->selectedPad->table[cfgCtrl ? 1 : 0][cfgShift ? 1 : 0][cfgAlt ? 1 : 0][0] = static_cast<PadStateRequest>(i);
+                            markChanged(state, state->selectedPad);
                         }
                         if (isSelected) {
                             ImGui::SetItemDefaultFocus();
-                            if (appCfg->autosave) {
-                                saveSoundPad(state->currentProfile, state->selected);
-                            }
                         }
                     }
                     ImGui::EndCombo();
@@ -687,12 +1559,10 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
                         bool isSelected = (state->selectedPad->table[cfgCtrl ? 1 : 0][cfgShift ? 1 : 0][cfgAlt ? 1 : 0][1] == i);
                         if (ImGui::Selectable(state->requestStrings[i], isSelected)) {
                             state->selectedPad->table[cfgCtrl ? 1 : 0][cfgShift ? 1 : 0][cfgAlt ? 1 : 0][1] = static_cast<PadStateRequest>(i);
+                            markChanged(state, state->selectedPad);
                         }
                         if (isSelected) {
                             ImGui::SetItemDefaultFocus();
-                            if (appCfg->autosave) {
-                                saveSoundPad(state->currentProfile, state->selected);
-                            }
                         }
                     }
                     ImGui::EndCombo();
@@ -704,17 +1574,54 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
             float prevVolume = volume;
             ImGui::SliderFloat("Volume", &volume, 0.f, 2.f);
             if (prevVolume != volume) {
-                state->selectedPad->volume(volume);
-                if (appCfg->autosave) {
-                    saveSoundPad(state->currentProfile, state->selected);
+                Command cmd;
+                cmd.type = CMD_VOLUME;
+                cmd.letter = state->selectedPad->letter;
+                cmd.value = volume;
+                cmd.issued = SDL_GetTicksNS();
+                state->engine->submit(cmd);
+                markChanged(state, state->selectedPad);
+            }
+            PadDsp dsp = state->selectedPad->dsp;
+            ImGui::SliderFloat("Rate", &dsp.rate, 0.25f, 4.f, "%.2fx", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Pan", &dsp.pan, -1.f, 1.f, "%.2f");
+            if (ImGui::BeginCombo("Filter", filterName(dsp.filter))) {
+                for (int i = FILTER_OFF; i <= FILTER_HIGHPASS; ++i) {
+                    bool isSelected = dsp.filter == i;
+                    if (ImGui::Selectable(filterName(static_cast<FilterType>(i)), isSelected)) {
+                        dsp.filter = static_cast<FilterType>(i);
+                    }
+                    if (isSelected) {
+                        ImGui::SetItemDefaultFocus();
+                    }
                 }
+                ImGui::EndCombo();
+            }
+            if (dsp.filter != FILTER_OFF) {
+                ImGui::SliderFloat("Cutoff", &dsp.cutoff, 20.f, 20000.f, "%.0f Hz", ImGuiSliderFlags_Logarithmic);
+                ImGui::SliderFloat("Resonance", &dsp.resonance, 0.5f, 10.f, "%.2f", ImGuiSliderFlags_Logarithmic);
+            }
+            if (!dsp.neutral() && ImGui::Button("Reset rate, pan and filter")) {
+                dsp = PadDsp();
+            }
+            if (dsp != state->selectedPad->dsp) {
+                Command cmd;
+                cmd.type = CMD_DSP;
+                cmd.letter = state->selectedPad->letter;
+                cmd.dsp = dsp;
+                cmd.issued = SDL_GetTicksNS();
+                state->engine->submit(cmd);
+                markChanged(state, state->selectedPad);
+            }
+            if (state->selectedPad->audio && ImGui::CollapsingHeader("Trim and cues")) {
+                ShowSliceEditor(state, state->selectedPad);
             }
             if (ImGui::Button("Close", ImVec2(-1, 0))) {
                 state->selectedPad = nullptr;
             }
             if (!appCfg->autosave) {
                 if (ImGui::Button("Save", ImVec2(-1, 0))) {
-                    saveSoundPad(state->currentProfile, state->selected);
+                    saveNow = true;
                 }
             }
             ImGui::End();
@@ -723,6 +1630,13 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
             cfgCtrl = false;
             cfgShift = false;
         }
+        if (saveNow) {
+            saveCurrent(state);
+        }
+        {
+            std::lock_guard<std::mutex> padGuard(state->engine->padLock);
+            state->saver->update();
+        }
         bool showHelp = state->helpWindow != nullptr;
         if (showHelp) {
             ImGui::SetNextWindowPos(ImGui::GetMainViewport()->GetWorkCenter(), ImGuiCond_Always, ImVec2(0.5f, 0.5f));
@@ -739,12 +1653,50 @@ SDL_AppResult SDL_AppIterate(void *appstate) {
         }
     }
 
-    ImGui::Render();
-    SDL_SetRenderScale(renderer, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
-    SDL_SetRenderDrawColorFloat(renderer, .5, 0, .5, 1);
-    SDL_RenderClear(renderer);
-    ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer);
-    SDL_RenderPresent(renderer);
+    if (state->showResources) {
+        ShowResources(state);
+    }
+
+    {
+        TraceSpan span("frame", "render"); // present waits for vsync
+        ImGui::Render();
+        SDL_SetRenderScale(renderer, io.DisplayFramebufferScale.x, io.DisplayFramebufferScale.y);
+        SDL_SetRenderDrawColorFloat(renderer, .5, 0, .5, 1);
+        SDL_RenderClear(renderer);
+        ImGui_ImplSDLRenderer3_RenderDrawData(ImGui::GetDrawData(), renderer);
+        SDL_RenderPresent(renderer);
+    }
+    startupTrace.frameReady();
+    // pictures are uploaded by now, unless a profile is still on its way
+    if (!state->dumpResources.empty() && !state->replayer && state->pendingProfile.empty()) {
+        return dumpResources(state) ? SDL_APP_SUCCESS : SDL_APP_FAILURE;
+    }
+
+    if (state->replayer) {
+        // 16 ms of audio per frame
+        SDL_AudioSpec spec;
+        MIX_GetMixerFormat(mixer, &spec);
+        state->replayAudio.resize(spec.freq * 16 / 1000 * spec.channels);
+        state->engine->wait(); // mouse presses of this frame
+        MIX_Generate(mixer, state->replayAudio.data(), state->replayAudio.size() * sizeof(float));
+        state->engine->refresh();
+        Uint64 voices = 0;
+        if (state->selected) {
+            std::lock_guard<std::mutex> padGuard(state->engine->padLock);
+            for (auto &row : *state->selected) {
+                for (auto &p : row) {
+                    voices += p.playingTracks();
+                }
+            }
+        }
+        state->replayStats.frame(SDL_GetTicksNS() - frameStart, voices);
+        if (state->replayer->finished(now)) {
+            if (!state->dumpResources.empty() && !dumpResources(state)) {
+                return SDL_APP_FAILURE;
+            }
+            return SDL_APP_SUCCESS;
+        }
+    }
 
     auto regularName = std::string_view(appCfg->fontRegular->GetDebugName());
     auto monoName = std::string_view(appCfg->fontMono->GetDebugName());
@@ -778,19 +1730,77 @@ void SDL_AppQuit(void *appstate, SDL_AppResult result) {
     ImGui::DestroyContext();
     auto state = static_cast<AppState *>(appstate);
     auto cp = state->currentProfile;
-    // if (state->selected) {
-    //     if (saveSoundPad(cp, state->selected)) {
-    //         SDL_Log("Saved profile %s", cp.c_str());
-    //     } else {
-    //         SDL_Log("Failed to save profile %s", cp.c_str());
-    //     }
-    // }
+    bool replayed = state->replayer != nullptr;
+    if (replayed) {
+        printf("Replay finished at %llu ms\n", (unsigned long long) state->replayClock);
+        state->replayStats.print();
+        if (state->selected) {
+            printf("profile: %s\n", cp.filename().u8string().c_str());
+            for (auto &row : *state->selected) {
+                for (auto &p : row) {
+                    printf("%c %s\n", p.letter, stateName(p.state));
+                }
+            }
+        }
+        delete state->replayer;
+    }
+    if (state->recorder) {
+        state->recorder->close();
+        delete state->recorder;
+    }
+    delete state->control;
+    delete state->osc;
+    if (!state->dumpTrace.empty()) {
+        tracer.dump(std::filesystem::u8path(state->dumpTrace));
+    }
+    auto engineStats = state->engine->stats();
+    SDL_Log("Engine: %llu commands, latency avg %llu µs, p99 %llu µs, max %llu µs; queue depth peaked at %zu, %llu dropped",
+        (unsigned long long) engineStats.commands,
+        (unsigned long long) (engineStats.commands ? engineStats.totalLatencyNS / engineStats.commands / 1000 : 0),
+        (unsigned long long) engineStats.latencyPercentileNS(0.99) / 1000,
+        (unsigned long long) engineStats.maxLatencyNS / 1000,
+        engineStats.maxQueueDepth, (unsigned long long) engineStats.dropped);
+    state->engine->stop();
+    state->engine->attach(nullptr);
+    Pad::setStateListener(nullptr, nullptr);
+    // edits still waiting for the quiet period
+    if (!replayed) {
+        auto &tiers = state->tiering->stats();
+        bool triggered = tiers.hits + tiers.misses > 0;
+        if (appCfg->autosave) {
+            if (triggered) {
+                markChanged(state, nullptr); // trigger counts go with the profile
+            }
+            state->saver->flush();
+        } else if (triggered && state->selected && !state->currentProfile.empty()) {
+            // edits the user didn't save are left out, the counts are kept anyway
+            saveUsage(state->currentProfile, state->selected);
+        }
+        if (!cp.empty()) {
+            appCfg->catalog.changed(cp);
+        }
+        appCfg->catalog.update();
+        appCfg->catalog.flush();
+    }
+    delete state->saver;
+    delete state->resources;
+    delete state->profiles;
+    delete state->library;
+    jobs.logStats();
+    jobs.stop(); // nobody waits for jobs anymore
+    assetStore.logStats();
     delete[] state->requestStrings;
     delete state->selected;
+    delete state->engine;
+    delete state->tiering;
     delete state;
-    saveAppConfig(appCfg);
+    if (!replayed) {
+        saveAppConfig(appCfg);
+    }
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
+    capture.stop();
+    audioOutput.close();
     MIX_DestroyMixer(mixer);
     MIX_Quit();
     SDL_Quit();
@@ -1,20 +1,17 @@
 #include "preface.hpp"
 #include <string>
 #include <vector>
+#include "Engine.hpp"
 #include "Pad.hpp"
 
-Pad *ShowSoundPad(SoundPad &pads, bool interactive, ImFont *letterFont) {
+// Keyboard is handled in SDL_AppEvent, mouse is hit tested here once per frame;
+// both only send commands to the engine.
+// A sound dragged from the library onto a pad is reported through dropTarget and dropped,
+// the pad under the mouse through hoveredPad.
+Pad *ShowSoundPad(SoundPad &pads, Engine &engine, bool interactive, ImFont *letterFont, Pad **dropTarget = nullptr, std::string *dropped = nullptr,
+                  Pad **hoveredPad = nullptr) {
     static ImGuiWindowFlags flags = ImGuiWindowFlags_NoDecoration | ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoSavedSettings;
 
-    // Stop everything on spacebar
-    if (ImGui::IsKeyPressed(ImGuiKey_Space)) {
-        for (auto &row : pads) {
-            for (auto &pad : row) {
-                pad.request = PadStateRequest::STOP;
-            }
-        }
-    }
-
     const ImGuiViewport* viewport = ImGui::GetMainViewport();
     ImGui::SetNextWindowPos(viewport->WorkPos);
     ImGui::SetNextWindowSize(viewport->WorkSize);
@@ -29,14 +26,46 @@ Pad *ShowSoundPad(SoundPad &pads, bool interactive, ImFont *letterFont) {
             ImGui::PushStyleVar(ImGuiStyleVar_ItemSpacing, ImVec2(0, 0));
             unsigned padSize = std::min(viewport->WorkSize.y / h, viewport->WorkSize.x / w);
             auto size = ImVec2(padSize, padSize);
+            pads.origin = ImGui::GetCursorScreenPos();
+            pads.padSize = padSize;
+
+            ImGuiIO &io = ImGui::GetIO();
+            Pad *hovered = interactive && ImGui::IsWindowHovered() ? pads.hitTest(io.MousePos) : nullptr;
+            Pad *held = interactive && ImGui::IsMouseDown(0) ? hovered : nullptr;
+            if (held != pads.mousePad) {
+                // sliding over pads with the button down plays them in turn
+                if (pads.mousePad) {
+                    engine.release(pads.mousePad->letter);
+                }
+                if (held) {
+                    engine.press(held->letter, io.KeyCtrl, io.KeyShift, io.KeyAlt);
+                }
+                pads.mousePad = held;
+            }
+            if (hovered && ImGui::IsMouseClicked(1)) {
+                options = hovered;
+            }
+            if (hoveredPad) {
+                *hoveredPad = hovered;
+            }
+
             auto baked = letterFont->GetFontBaked(size.y);
             auto hGlyph = baked->FindGlyph('H');
             auto charHeight = hGlyph->Y1 - hGlyph->Y0;
             //SDL_Log("Font size: %f, Y0 %f, Y1 %f, diff %f", size.y, hGlyph->Y0, hGlyph->Y1, charHeight);
             for (auto &row : pads) {
                 for (auto &pad : row) {
-                    if (pad.render(size, interactive, letterFont, (7.0/8.0) * size.y * (size.y / charHeight))) {
-                        options = &pad;
+                    {
+                        // only for the name, which the engine may replace
+                        std::lock_guard<std::mutex> guard(engine.padLock);
+                        pad.render(size, &pad == hovered, letterFont, (7.0/8.0) * size.y * (size.y / charHeight));
+                    }
+                    if (dropTarget && ImGui::BeginDragDropTarget()) {
+                        if (auto payload = ImGui::AcceptDragDropPayload("LIBRARY_SOUND")) {
+                            *dropTarget = &pad;
+                            dropped->assign(static_cast<const char *>(payload->Data), payload->DataSize - 1);
+                        }
+                        ImGui::EndDragDropTarget();
                     }
                     ImGui::SameLine();
                 }